@@ -3,13 +3,23 @@
 #include <print>
 
 #include "system.hpp"
+#include "host_allocator.hpp"
 
 int main(int argc, char** argv)
 {
     try
     {
-        app::System program{800, 600};
-        program.run();
+        auto options{app::parse_options({argv, static_cast<std::size_t>(argc)})};
+        {
+            app::System program{options};
+            program.run();
+        }
+
+        // Reported once every object is gone, so anything still live was leaked by the driver or by us.
+        if(options.hostAllocationReport)
+        {
+            app::write_host_allocation_report(std::cout);
+        }
     }
     catch(const std::exception& e)
     {
@@ -0,0 +1,47 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <print>
+#include <stdexcept>
+
+#include "system.hpp"
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        app::Options defaults{};
+        defaults.fixedTimestep = 1.0 / 60.0;
+        defaults.warmupFrames = 60;
+        defaults.frameCount = 1000;
+
+        auto options{app::parse_options({argv, static_cast<std::size_t>(argc)}, defaults)};
+        if(options.duration > 0.0)
+        {
+            options.frameCount = 0;
+        }
+
+        app::System program{options};
+        program.run();
+
+        if(options.reportPath.empty())
+        {
+            program.write_report(std::cout);
+        }
+        else
+        {
+            std::ofstream out{options.reportPath};
+            if(!out.is_open())
+            {
+                throw std::runtime_error{"Error: failed to open benchmark report."};
+            }
+            program.write_report(out);
+        }
+    }
+    catch(const std::exception& e)
+    {
+        std::println(std::cerr, "{}", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
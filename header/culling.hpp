@@ -0,0 +1,79 @@
+#ifndef CULLING_HPP
+#define CULLING_HPP
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "utils.hpp"
+#include "meshlet.hpp"
+#include "thread_pool.hpp"
+
+namespace app
+{
+    struct BoundingSphere
+    {
+        glm::vec3 center;
+        float radius;
+    };
+
+    // One instance of a mesh. Its clusters occupy draw slots firstDraw to firstDraw + clusterCount - 1.
+    struct ObjectData
+    {
+        glm::mat4 model;
+        glm::vec4 boundingSphere;
+        std::uint32_t firstCluster;
+        std::uint32_t clusterCount;
+        std::uint32_t firstDraw;
+        std::uint32_t material;
+    };
+    static_assert(sizeof(ObjectData) == 96, "ObjectData must match the std430 layout in the shaders.");
+
+    struct ClusterData
+    {
+        glm::vec4 boundingSphere;
+        glm::vec4 cone;
+        std::uint32_t firstIndex;
+        std::uint32_t indexCount;
+        std::int32_t vertexOffset;
+        std::uint32_t padding;
+    };
+    static_assert(sizeof(ClusterData) == 48, "ClusterData must match the std430 layout in the shaders.");
+
+    struct CullConstants
+    {
+        std::uint32_t objectCount;
+        std::uint32_t drawCapacity;
+        std::uint32_t compact;
+        std::uint32_t phase;
+        float hiZWidth;
+        float hiZHeight;
+        float hiZLevels;
+    };
+
+    struct CullStatistics
+    {
+        std::uint32_t earlyDrawCount;
+        std::uint32_t lateDrawCount;
+        std::uint32_t frustumCulledCount;
+        std::uint32_t occludedCount;
+    };
+
+    BoundingSphere compute_bounding_sphere(std::span<const Vertex> vertices);
+    std::vector<glm::vec3> layout_object_grid(std::uint32_t count, const BoundingSphere& bounds);
+    std::vector<ClusterData> build_clusters(const MeshletSet& set, std::span<const Vertex> vertices);
+    ClusterData whole_mesh_cluster(std::span<const Vertex> vertices, std::uint32_t indexCount);
+
+    std::array<glm::vec4, 6> extract_frustum_planes(const glm::mat4& viewProjection);
+    bool sphere_in_frustum(const std::array<glm::vec4, 6>& planes, const glm::vec3& center, float radius);
+    float max_scale(const glm::mat4& transform);
+
+    // CPU counterpart of cull.comp without the occlusion test. With a pool, objects are culled in parallel chunks and
+    // the draws still come out in object order. Only the tests and job_benchmark call this; the renderer culls on the
+    // GPU and does no per-frame work on the job system.
+    std::vector<VkDrawIndexedIndirectCommand> cull_clusters(std::span<const ObjectData> objects, std::span<const ClusterData> clusters, 
+                                                            const UniformBufferObject& ubo, ThreadPool* pool = nullptr);
+}
+
+#endif
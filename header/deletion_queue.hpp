@@ -0,0 +1,30 @@
+#ifndef DELETION_QUEUE_HPP
+#define DELETION_QUEUE_HPP
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <utility>
+
+namespace app
+{
+    class DeletionQueue final
+    {
+    public:
+        void push(std::uint64_t value, std::move_only_function<void()> deleter);
+
+        template<typename... Resources>
+        void retire(std::uint64_t value, Resources&&... resources)
+        {
+            push(value, [...retired = std::move(resources)]() mutable {});
+        }
+
+        void flush(std::uint64_t completedValue);
+        void flush();
+        std::size_t size() const;
+    private:
+        std::deque<std::pair<std::uint64_t, std::move_only_function<void()>>> deleters;
+    };
+}
+
+#endif
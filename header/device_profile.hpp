@@ -0,0 +1,87 @@
+#ifndef DEVICE_PROFILE_HPP
+#define DEVICE_PROFILE_HPP
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "utils.hpp"
+
+namespace app
+{
+    // What device ranking looks at, gathered from the physical device queries.
+    struct DeviceTraits
+    {
+        VkPhysicalDeviceType type;
+        VkDeviceSize localMemoryBytes;
+        bool multiDrawIndirect;
+        bool drawIndirectCount;
+        bool timelineSemaphore;
+    };
+
+    // Higher is better. The device type dominates, then video memory, then the features behind the faster paths.
+    std::uint64_t score_device(const DeviceTraits& traits);
+
+    struct DeviceProfileKey
+    {
+        std::array<std::uint8_t, VK_UUID_SIZE> deviceUuid;
+        std::uint32_t driverVersion;
+
+        bool operator==(const DeviceProfileKey&) const = default;
+    };
+
+    // Settings tuned for one device and driver. stagingBytes bounds how much texture data is uploaded per frame.
+    struct DeviceProfile
+    {
+        VkSampleCountFlagBits samples;
+        VkPresentModeKHR presentMode;
+        VkDeviceSize stagingBytes;
+    };
+
+    struct SampleCost
+    {
+        VkSampleCountFlagBits samples;
+        double milliseconds;
+    };
+
+    // Results of the startup micro-benchmark: the per-frame cost of each candidate sample count at the window size and
+    // the host to device copy rate.
+    struct TuningMeasurements
+    {
+        std::vector<SampleCost> sampleCosts;
+        double uploadBytesPerMillisecond;
+    };
+
+    // Most samples whose cost fits a share of the frame budget, the staging size that uploads in a share of it, and
+    // the present mode that suits the headroom left over. presentModes is empty when there is no surface.
+    DeviceProfile choose_device_profile(const TuningMeasurements& measurements, std::span<const VkPresentModeKHR> presentModes,
+                                        double frameBudgetMilliseconds);
+
+    // Tuned profiles on disk, one line per device and driver version. The file is only a cache: unreadable lines are
+    // dropped and a profile is measured again.
+    class DeviceProfileCache final
+    {
+    public:
+        explicit DeviceProfileCache(std::filesystem::path path);
+
+        std::optional<DeviceProfile> find(const DeviceProfileKey& key) const;
+        void store(const DeviceProfileKey& key, const DeviceProfile& profile);
+    private:
+        struct Entry
+        {
+            DeviceProfileKey key;
+            DeviceProfile profile;
+        };
+
+        void load();
+        void save() const;
+
+        std::filesystem::path path;
+        std::vector<Entry> entries;
+    };
+}
+
+#endif
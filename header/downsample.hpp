@@ -0,0 +1,36 @@
+#ifndef DOWNSAMPLE_HPP
+#define DOWNSAMPLE_HPP
+
+#include <cstdint>
+
+#include "utils.hpp"
+
+namespace app
+{
+    // Limits of downsample.comp, which builds the min/max depth pyramid: one dispatch writes at most twelve levels below a
+    // source of at most 4096 texels a side. Each level holds the nearest depth in x and the farthest in y. It is the
+    // only GPU downsampler: material mip chains come from build_mip_chain on the CPU, averaged in linear space with odd
+    // edges folded in, because the texture streamer keeps every level in host memory.
+    constexpr std::uint32_t maxDownsampleLevels{12};
+    constexpr std::uint32_t downsampleTileSize{64};
+    constexpr std::uint32_t downsampleDestinationCount{maxDownsampleLevels + 1};
+
+    struct DownsampleConstants
+    {
+        std::uint32_t sourceWidth;
+        std::uint32_t sourceHeight;
+        std::uint32_t levelCount;
+        std::uint32_t includeSource;
+        std::uint32_t workgroupCount;
+    };
+
+    // levelCount counts the generated levels below the source. With includeSource the source is also copied into
+    // destination 0 and level n goes to destination n, otherwise level n goes to destination n - 1.
+    DownsampleConstants downsample_constants(VkExtent2D source, std::uint32_t levelCount, bool includeSource);
+
+    // Bytes of the scratch buffer bound next to the destinations: a completion counter, level six for the last
+    // workgroup, and the last two rows and columns of every level until they are folded together.
+    VkDeviceSize downsample_scratch_bytes(VkExtent2D source, std::uint32_t levelCount);
+}
+
+#endif
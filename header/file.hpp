@@ -1,12 +1,15 @@
 #ifndef FILE_HPP
 #define FILE_HPP
 
+#include <cstdint>
 #include <vector>
 #include <filesystem>
 
 namespace file
 {
     std::vector<char> read_file(const std::filesystem::path& filename); 
+    void write_png(const std::filesystem::path& filename, std::uint32_t width, std::uint32_t height, const void* pixels);
+    void write_raw(const std::filesystem::path& filename, const void* data, std::size_t size);
 }
 
 #endif
\ No newline at end of file
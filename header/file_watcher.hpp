@@ -0,0 +1,35 @@
+#ifndef FILE_WATCHER_HPP
+#define FILE_WATCHER_HPP
+
+#include <chrono>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+namespace app
+{
+    // Reports files written in a set of directories. Linux uses inotify and never blocks; elsewhere the directories are
+    // rescanned for newer write times at most twice a second.
+    class FileWatcher final
+    {
+    public:
+        explicit FileWatcher(std::vector<std::filesystem::path> directories);
+        FileWatcher(const FileWatcher&) = delete;
+        FileWatcher& operator=(const FileWatcher&) = delete;
+        ~FileWatcher();
+
+        // Files that finished changing since the previous call, each listed once.
+        std::vector<std::filesystem::path> poll();
+    private:
+        std::vector<std::filesystem::path> directories;
+        #if defined(__linux__)
+            int descriptor{-1};
+            std::unordered_map<int, std::filesystem::path> watches;
+        #else
+            std::unordered_map<std::filesystem::path, std::filesystem::file_time_type> writeTimes;
+            std::chrono::steady_clock::time_point lastScan{};
+        #endif
+    };
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef FRAME_ARENA_HPP
+#define FRAME_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace app
+{
+    // Heap allocations made by operator new on the calling thread since it started.
+    std::uint64_t thread_heap_allocations();
+
+    // Bump allocator for data that lives until the frame slot's fence signals. Deallocation is a no-op and reset()
+    // rewinds the whole block. A frame that outgrows the block borrows from the heap and the block grows on the next
+    // reset, so after a few frames the hot path stops touching the heap.
+    class FrameArena final : public std::pmr::memory_resource
+    {
+    public:
+        explicit FrameArena(std::size_t capacity = 64 * 1024);
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator=(const FrameArena&) = delete;
+        ~FrameArena() override;
+
+        void reset();
+        std::size_t used() const;
+        std::size_t capacity() const;
+    private:
+        struct Overflow
+        {
+            void* pointer;
+            std::size_t bytes;
+            std::size_t alignment;
+        };
+
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+        void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+        void release_overflow();
+
+        std::vector<std::byte> block;
+        std::size_t offset{0};
+        std::size_t overflowBytes{0};
+        std::vector<Overflow> overflow;
+    };
+}
+
+#endif
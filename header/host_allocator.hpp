@@ -0,0 +1,40 @@
+#ifndef HOST_ALLOCATOR_HPP
+#define HOST_ALLOCATOR_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "utils.hpp"
+#include "profiler.hpp"
+
+namespace app
+{
+    struct HostAllocationTotals
+    {
+        std::uint64_t bytes;
+        std::uint64_t peakBytes;
+        std::uint64_t internalBytes;
+        std::uint64_t allocations;
+        std::uint64_t pooledAllocations;
+    };
+
+    // Routes driver and loader host allocations for the rest of the process through tracked callbacks. It has to run
+    // before the first Vulkan object is created, since an object must be destroyed with callbacks compatible with the
+    // ones it was created with, and it cannot be turned off again. Command-scope allocations only live for the call
+    // that made them, so with poolCommandScope the small ones are recycled through per-thread free lists instead of
+    // going back to the heap.
+    void enable_host_allocation_tracking(bool poolCommandScope);
+    bool host_allocation_tracking_enabled();
+
+    // Callbacks that charge allocations to objectType, or nullptr while tracking is off so the driver keeps its own
+    // allocator. Pass the same object type when creating and destroying an object.
+    const VkAllocationCallbacks* host_allocator(VkObjectType objectType);
+
+    // Live and peak bytes per object type and allocation scope, skipping pairs that never allocated.
+    std::vector<HostAllocationUsage> host_allocation_usage();
+    HostAllocationTotals host_allocation_totals();
+    void write_host_allocation_report(std::ostream& out);
+}
+
+#endif
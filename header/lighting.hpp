@@ -0,0 +1,62 @@
+#ifndef LIGHTING_HPP
+#define LIGHTING_HPP
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "utils.hpp"
+#include "culling.hpp"
+
+namespace app
+{
+    // Position and radius in the same space as the meshes, so ubo.model moves the lights along with them. The light's
+    // influence ends at the radius.
+    struct PointLight
+    {
+        glm::vec4 positionRadius;
+        glm::vec4 color;
+    };
+    static_assert(sizeof(PointLight) == 32, "PointLight must match the std430 layout in the shaders.");
+
+    // Clustered shading splits the view frustum into screen tiles and exponentially spaced depth slices, so each slice
+    // is about as deep as it is wide. Mirrored by light_cull.comp and shader.frag.
+    constexpr std::uint32_t lightClusterCountX{16};
+    constexpr std::uint32_t lightClusterCountY{9};
+    constexpr std::uint32_t lightClusterCountZ{24};
+    constexpr std::uint32_t lightClusterCount{lightClusterCountX * lightClusterCountY * lightClusterCountZ};
+    // A cluster keeps at most this many of the lights touching it; the index list holds an average of a quarter of that.
+    constexpr std::uint32_t maxClusterLights{256};
+    constexpr std::uint32_t lightIndexCapacity{lightClusterCount * 64};
+
+    struct LightClusterBounds
+    {
+        glm::vec3 minimum;
+        glm::vec3 maximum;
+    };
+
+    // Per cluster offset and count into indices, the same data light_cull.comp writes to the light grid. Lights past a
+    // cluster's limit or the index capacity are counted as dropped.
+    struct LightAssignment
+    {
+        std::vector<glm::uvec2> ranges;
+        std::vector<std::uint32_t> indices;
+        std::uint32_t droppedLights;
+    };
+
+    // Slice holding a point at the given distance in front of the camera.
+    std::uint32_t light_cluster_slice(float viewDepth, float nearPlane, float farPlane);
+    // View space box around one cluster, from the inverse of the projection it was rendered with.
+    LightClusterBounds light_cluster_bounds(std::uint32_t cluster, const glm::mat4& inverseProjection, float nearPlane, float farPlane);
+    bool sphere_touches_box(const glm::vec3& center, float radius, const LightClusterBounds& bounds);
+
+    // Random lights inside bounds, repeatable for a seed.
+    std::vector<PointLight> generate_lights(std::uint32_t count, const BoundingSphere& bounds, std::uint32_t seed);
+
+    // CPU counterpart of light_cull.comp, reading the same uniforms: lights are taken to view space by view * model and
+    // the clusters come from inverseProjection and the planes in clusterViewport. Clusters are filled in order, so when
+    // the index list runs out it is the far clusters that lose lights rather than arbitrary ones.
+    LightAssignment assign_lights(std::span<const PointLight> lights, const UniformBufferObject& ubo);
+}
+
+#endif
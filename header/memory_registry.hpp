@@ -0,0 +1,90 @@
+#ifndef MEMORY_REGISTRY_HPP
+#define MEMORY_REGISTRY_HPP
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "utils.hpp"
+
+namespace app
+{
+    enum class MemoryCategory : std::uint8_t
+    {
+        vertex,
+        index,
+        uniform,
+        storage,
+        indirect,
+        texture,
+        depth,
+        color,
+        staging,
+        readback,
+        count
+    };
+
+    std::string_view to_string(MemoryCategory category);
+
+    // Book of every live device memory allocation with the category and debug name it was made for. Totals are kept
+    // per heap and per category along with their peaks. Whatever is still registered when the registry goes away
+    // was leaked and is reported on stderr.
+    class MemoryRegistry final
+    {
+    public:
+        using Id = std::uint64_t;
+
+        MemoryRegistry() = default;
+        MemoryRegistry(const MemoryRegistry&) = delete;
+        MemoryRegistry& operator=(const MemoryRegistry&) = delete;
+        ~MemoryRegistry();
+
+        void set_heaps(std::span<const VkMemoryHeap> memoryHeaps);
+        // Also writes the JSON dump to path when the registry is destroyed, after the leak check.
+        void set_exit_report(std::filesystem::path path);
+
+        Id add(MemoryCategory category, std::string name, std::uint32_t heap, VkDeviceSize size);
+        void remove(Id id);
+
+        VkDeviceSize bytes(MemoryCategory category) const;
+        VkDeviceSize peak_bytes(MemoryCategory category) const;
+        void write_json(std::ostream& out) const;
+    private:
+        struct Record
+        {
+            MemoryCategory category;
+            std::string name;
+            std::uint32_t heap;
+            VkDeviceSize size;
+        };
+
+        struct Total
+        {
+            VkDeviceSize bytes{0};
+            VkDeviceSize peakBytes{0};
+            std::uint64_t allocations{0};
+
+            void add(VkDeviceSize size);
+        };
+
+        constexpr static std::size_t categoryCount{static_cast<std::size_t>(MemoryCategory::count)};
+
+        mutable std::mutex mutex;
+        Id nextId{1};
+        std::unordered_map<Id, Record> records;
+        std::vector<VkMemoryHeap> heaps;
+        std::vector<Total> heapTotals;
+        std::array<Total, categoryCount> categoryTotals{};
+        Total total{};
+        std::filesystem::path exitReportPath{};
+    };
+}
+
+#endif
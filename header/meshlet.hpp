@@ -0,0 +1,44 @@
+#ifndef MESHLET_HPP
+#define MESHLET_HPP
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "utils.hpp"
+
+namespace app
+{
+    constexpr std::size_t maxMeshletVertices{64};
+    constexpr std::size_t maxMeshletTriangles{124};
+
+    struct Meshlet
+    {
+        std::uint32_t vertexOffset;
+        std::uint32_t vertexCount;
+        std::uint32_t triangleOffset;
+        std::uint32_t triangleCount;
+    };
+
+    struct MeshletBounds
+    {
+        glm::vec3 center;
+        float radius;
+        glm::vec3 coneAxis;
+        float coneCutoff;
+    };
+
+    struct MeshletSet
+    {
+        std::vector<Meshlet> meshlets;
+        std::vector<std::uint32_t> vertices;
+        std::vector<std::uint8_t> triangles;
+    };
+
+    MeshletSet build_meshlets(std::span<const std::uint32_t> indices, std::size_t vertexCount, 
+                              std::size_t maxVertices = maxMeshletVertices, std::size_t maxTriangles = maxMeshletTriangles);
+    MeshletBounds compute_meshlet_bounds(const MeshletSet& set, const Meshlet& meshlet, std::span<const Vertex> vertices);
+    std::vector<std::uint32_t> meshlet_indices(const MeshletSet& set);
+}
+
+#endif
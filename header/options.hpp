@@ -0,0 +1,51 @@
+#ifndef OPTIONS_HPP
+#define OPTIONS_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+#include "shader_variant.hpp"
+
+namespace app
+{
+    enum class CaptureFormat : std::uint8_t
+    {
+        png,
+        raw
+    };
+
+    struct Options
+    {
+        std::uint32_t width{800};
+        std::uint32_t height{600};
+        bool headless{false};
+        std::uint32_t frameCount{0};
+        std::filesystem::path outputDirectory{};
+        CaptureFormat captureFormat{CaptureFormat::png};
+        double fixedTimestep{0.0};
+        std::uint32_t warmupFrames{0};
+        double duration{0.0};
+        std::filesystem::path reportPath{};
+        std::uint32_t objectCount{1};
+        std::uint32_t lightCount{0};
+        std::filesystem::path scenePath{};
+        bool meshlets{false};
+        double gpuBudgetMilliseconds{0.0};
+        float minimumRenderScale{0.5f};
+        std::uint32_t textureBudgetMegabytes{256};
+        std::uint32_t workerThreads{0};
+        bool pinThreads{false};
+        bool hotReload{false};
+        bool hostAllocationReport{false};
+        bool poolCommandAllocations{false};
+        std::filesystem::path memoryReportPath{};
+        std::filesystem::path profileCachePath{"device_profiles.txt"};
+        bool retune{false};
+        ShaderVariantKey shaderVariant{ShaderFeature::textured, ShaderFeature::instanced};
+    };
+
+    Options parse_options(std::span<char*> arguments, Options defaults = {});
+}
+
+#endif
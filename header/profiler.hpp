@@ -0,0 +1,125 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <cstdint>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace app
+{
+    struct Statistics
+    {
+        double mean;
+        double p50;
+        double p95;
+        double p99;
+        double max;
+    };
+
+    struct FrameSample
+    {
+        double frameMilliseconds;
+        double cpuMilliseconds;
+        double gpuMilliseconds;
+        double drawnClusters;
+        double frustumCulledClusters;
+        double occludedClusters;
+        double renderScale;
+        double msaaSamples;
+        double textureResidentBytes;
+        double heapAllocations;
+        double frameArenaBytes;
+    };
+
+    struct CullingSample
+    {
+        std::uint32_t drawnClusters;
+        std::uint32_t frustumCulledClusters;
+        std::uint32_t occludedClusters;
+    };
+
+    struct PhaseSample
+    {
+        std::string name;
+        double startMilliseconds;
+        double milliseconds;
+    };
+
+    struct MemoryUsage
+    {
+        std::uint64_t deviceBytes;
+        std::uint64_t peakDeviceBytes;
+        std::uint64_t lazilyAllocatedBytes;
+        std::uint64_t peakResidentBytes;
+        std::uint64_t hostBytes;
+        std::uint64_t peakHostBytes;
+    };
+
+    struct HostAllocationUsage
+    {
+        std::string_view objectType;
+        std::string_view scope;
+        std::uint64_t bytes;
+        std::uint64_t peakBytes;
+        std::uint64_t allocations;
+    };
+
+    struct CacheUsage
+    {
+        std::string_view name;
+        std::uint64_t lookups;
+        std::uint64_t hits;
+        std::uint64_t bytesSaved;
+        std::size_t entries;
+    };
+
+    Statistics compute_statistics(std::vector<double> values);
+    std::uint64_t peak_resident_memory();
+
+    class Profiler final
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        template<typename Function>
+        void measure_phase(std::string_view name, Function&& function)
+        {
+            auto start{Clock::now()};
+            function();
+            record_phase(name, start, Clock::now());
+        }
+
+        void record_phase(std::string_view name, Clock::time_point start, Clock::time_point end);
+        void record_first_frame(Clock::time_point time);
+        void record_frame(std::uint64_t frame, const FrameSample& sample);
+        void record_gpu_time(std::uint64_t frame, double milliseconds);
+        void record_culling(std::uint64_t frame, const CullingSample& sample);
+        void set_warmup_frames(std::uint64_t frames);
+        void reserve_frames(std::uint64_t frames);
+        std::uint64_t measured_frames() const;
+        Statistics gpu_statistics() const;
+        const std::vector<PhaseSample>& phases() const;
+        double startup_milliseconds() const;
+        void write_startup_report(std::ostream& out) const;
+        void write_json(std::ostream& out, const MemoryUsage& memory, std::span<const CacheUsage> caches, 
+                        std::span<const HostAllocationUsage> hostAllocations) const;
+    private:
+        FrameSample* frame_sample(std::uint64_t frame);
+
+        Clock::time_point origin{Clock::now()};
+        mutable std::mutex mutex;
+        std::vector<PhaseSample> phaseSamples;
+        std::optional<double> firstFrameMilliseconds;
+        std::vector<FrameSample> frameSamples;
+        std::uint64_t warmupFrames{0};
+    };
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef RESOLUTION_HPP
+#define RESOLUTION_HPP
+
+#include <cstdint>
+
+#include "utils.hpp"
+
+namespace app
+{
+    struct ResolutionSettings
+    {
+        double gpuBudgetMilliseconds;
+        float minimumScale;
+        VkSampleCountFlagBits maximumSamples;
+    };
+
+    // Picks the render scale and MSAA sample count for the next frame from measured GPU time.
+    // Scale reacts every frame; the sample count only moves after sustained pressure or headroom.
+    class ResolutionController final
+    {
+    public:
+        ResolutionController() = default;
+        explicit ResolutionController(const ResolutionSettings& settings);
+
+        // Returns true when the sample count changed and the multisampled targets must be rebuilt.
+        bool update(double gpuMilliseconds);
+        bool enabled() const;
+        float scale() const;
+        VkSampleCountFlagBits samples() const;
+        VkExtent2D render_extent(VkExtent2D targetExtent) const;
+    private:
+        ResolutionSettings settings{0.0, 1.0f, VK_SAMPLE_COUNT_1_BIT};
+        float currentScale{1.0f};
+        VkSampleCountFlagBits currentSamples{VK_SAMPLE_COUNT_1_BIT};
+        std::uint32_t pressureFrames{0};
+        std::uint32_t headroomFrames{0};
+
+        constexpr static float damping{0.25f};
+        constexpr static float deadband{0.1f};
+        constexpr static float headroom{0.6f};
+        constexpr static std::uint32_t pressureFrameLimit{30};
+        constexpr static std::uint32_t headroomFrameLimit{240};
+    };
+}
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef RESOURCE_HPP
+#define RESOURCE_HPP
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "utils.hpp"
+#include "host_allocator.hpp"
+#include "memory_registry.hpp"
+
+namespace app
+{
+    template<typename Owner, typename Handle, auto destroy, VkObjectType objectType>
+    class UniqueHandle final
+    {
+    public:
+        UniqueHandle() = default;
+
+        UniqueHandle(Owner owner, Handle handle)
+            : owner{owner}, handle{handle}
+        {
+        }
+
+        UniqueHandle(const UniqueHandle&) = delete;
+        UniqueHandle& operator=(const UniqueHandle&) = delete;
+
+        UniqueHandle(UniqueHandle&& that) noexcept
+            : owner{std::exchange(that.owner, VK_NULL_HANDLE)}
+            , handle{std::exchange(that.handle, VK_NULL_HANDLE)}
+        {
+        }
+
+        UniqueHandle& operator=(UniqueHandle&& that) noexcept
+        {
+            if(this != &that)
+            {
+                reset();
+                owner = std::exchange(that.owner, VK_NULL_HANDLE);
+                handle = std::exchange(that.handle, VK_NULL_HANDLE);
+            }
+            return *this;
+        }
+
+        ~UniqueHandle()
+        {
+            reset();
+        }
+
+        void reset()
+        {
+            if(handle != VK_NULL_HANDLE)
+            {
+                destroy(owner, handle, host_allocator(objectType));
+                handle = VK_NULL_HANDLE;
+            }
+        }
+
+        Handle get() const
+        {
+            return handle;
+        }
+
+        const Handle* address() const
+        {
+            return &handle;
+        }
+
+        operator Handle() const
+        {
+            return handle;
+        }
+
+        explicit operator bool() const
+        {
+            return handle != VK_NULL_HANDLE;
+        }
+    private:
+        Owner owner{VK_NULL_HANDLE};
+        Handle handle{VK_NULL_HANDLE};
+    };
+
+    template<typename Handle, auto destroy, VkObjectType objectType>
+    using DeviceHandle = UniqueHandle<VkDevice, Handle, destroy, objectType>;
+
+    template<typename Handle, auto destroy, VkObjectType objectType>
+    using InstanceHandle = UniqueHandle<VkInstance, Handle, destroy, objectType>;
+
+    using Buffer = DeviceHandle<VkBuffer, &vkDestroyBuffer, VK_OBJECT_TYPE_BUFFER>;
+    using Image = DeviceHandle<VkImage, &vkDestroyImage, VK_OBJECT_TYPE_IMAGE>;
+    using ImageView = DeviceHandle<VkImageView, &vkDestroyImageView, VK_OBJECT_TYPE_IMAGE_VIEW>;
+    using Framebuffer = DeviceHandle<VkFramebuffer, &vkDestroyFramebuffer, VK_OBJECT_TYPE_FRAMEBUFFER>;
+    using Sampler = DeviceHandle<VkSampler, &vkDestroySampler, VK_OBJECT_TYPE_SAMPLER>;
+    using Surface = InstanceHandle<VkSurfaceKHR, &vkDestroySurfaceKHR, VK_OBJECT_TYPE_SURFACE_KHR>;
+    using DebugMessenger = InstanceHandle<VkDebugUtilsMessengerEXT, &destroy_debug_utils_messenger_ext, VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT>;
+
+    class MemoryCounter final
+    {
+    public:
+        void add(VkDeviceSize size);
+        void remove(VkDeviceSize size);
+        VkDeviceSize bytes() const;
+        VkDeviceSize peak_bytes() const;
+    private:
+        std::atomic<VkDeviceSize> currentBytes{0};
+        std::atomic<VkDeviceSize> peakBytes{0};
+    };
+
+    class Allocation final
+    {
+    public:
+        Allocation() = default;
+        Allocation(VkDevice device, VkDeviceMemory memory, VkDeviceSize size, MemoryCounter* counter, bool lazilyAllocated = false, 
+                   MemoryRegistry* registry = nullptr, MemoryRegistry::Id registration = 0);
+        Allocation(const Allocation&) = delete;
+        Allocation& operator=(const Allocation&) = delete;
+        Allocation(Allocation&& that) noexcept;
+        Allocation& operator=(Allocation&& that) noexcept;
+        ~Allocation();
+
+        void reset();
+        VkDeviceMemory get() const;
+        VkDeviceSize size() const;
+        bool lazily_allocated() const;
+        operator VkDeviceMemory() const;
+    private:
+        VkDevice device{VK_NULL_HANDLE};
+        VkDeviceMemory memory{VK_NULL_HANDLE};
+        VkDeviceSize allocationSize{0};
+        MemoryCounter* counter{nullptr};
+        bool lazy{false};
+        MemoryRegistry* registry{nullptr};
+        MemoryRegistry::Id registration{0};
+    };
+
+    class Instance final
+    {
+    public:
+        Instance() = default;
+        explicit Instance(VkInstance instance);
+        Instance(const Instance&) = delete;
+        Instance& operator=(const Instance&) = delete;
+        Instance(Instance&& that) noexcept;
+        Instance& operator=(Instance&& that) noexcept;
+        ~Instance();
+
+        VkInstance get() const;
+        operator VkInstance() const;
+    private:
+        VkInstance instance{VK_NULL_HANDLE};
+    };
+
+    class Device final
+    {
+    public:
+        Device() = default;
+        explicit Device(VkDevice device);
+        Device(const Device&) = delete;
+        Device& operator=(const Device&) = delete;
+        Device(Device&& that) noexcept;
+        Device& operator=(Device&& that) noexcept;
+        ~Device();
+
+        VkDevice get() const;
+        operator VkDevice() const;
+    private:
+        VkDevice device{VK_NULL_HANDLE};
+    };
+
+    struct WindowDeleter
+    {
+        void operator()(GLFWwindow* window) const;
+    };
+
+    using Window = std::unique_ptr<GLFWwindow, WindowDeleter>;
+}
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef RESOURCE_CACHE_HPP
+#define RESOURCE_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+
+#include "utils.hpp"
+#include "profiler.hpp"
+
+namespace app
+{
+    std::uint64_t hash_bytes(std::span<const std::byte> bytes);
+    // A second hash built differently from hash_bytes, so contents only compare equal when both agree.
+    std::uint64_t check_bytes(std::span<const std::byte> bytes);
+
+    // Textures are matched by content without keeping a copy of the pixels, so the key carries two independent hashes
+    // and the byte count; a collision in hash_bytes alone can no longer merge two different images.
+    struct TextureKey
+    {
+        std::uint64_t contentHash;
+        std::uint64_t contentCheck;
+        std::uint64_t byteCount;
+        std::uint32_t width;
+        std::uint32_t height;
+        VkFormat format;
+
+        bool operator==(const TextureKey&) const = default;
+    };
+
+    // Every field of the create info except sType and pNext, which callers leave empty.
+    struct SamplerKey
+    {
+        VkSamplerCreateInfo info;
+
+        bool operator==(const SamplerKey& that) const;
+    };
+}
+
+namespace std
+{
+    template<> struct hash<app::TextureKey>
+    {
+        size_t operator()(const app::TextureKey& key) const;
+    };
+
+    template<> struct hash<app::SamplerKey>
+    {
+        size_t operator()(const app::SamplerKey& key) const;
+    };
+}
+
+namespace app
+{
+    // Map from a resource description to the object created for it. Entries live as long as the cache: the renderer
+    // loads its materials once and never tears them down. Creation runs under the lock, so two threads asking for the
+    // same key never build it twice.
+    template<typename Key, typename Value>
+    class ResourceCache final
+    {
+    public:
+        template<typename Create>
+        const Value& acquire(const Key& key, std::uint64_t bytes, Create&& create)
+        {
+            std::lock_guard lock{mutex};
+            ++lookups;
+            if(auto found{entries.find(key)}; found != std::end(entries))
+            {
+                ++hits;
+                bytesSaved += found->second.bytes;
+                return found->second.value;
+            }
+            return entries.emplace(key, Entry{std::invoke(std::forward<Create>(create)), bytes}).first->second.value;
+        }
+
+        CacheUsage usage(std::string_view name) const
+        {
+            std::lock_guard lock{mutex};
+            return {name, lookups, hits, bytesSaved, std::size(entries)};
+        }
+    private:
+        struct Entry
+        {
+            Value value;
+            std::uint64_t bytes;
+        };
+
+        mutable std::mutex mutex;
+        std::unordered_map<Key, Entry> entries;
+        std::uint64_t lookups{0};
+        std::uint64_t hits{0};
+        std::uint64_t bytesSaved{0};
+    };
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include "utils.hpp"
+#include "culling.hpp"
+#include "lighting.hpp"
+#include "transform.hpp"
+
+namespace app
+{
+    struct SceneMaterial
+    {
+        std::filesystem::path texturePath;
+    };
+
+    struct SceneMesh
+    {
+        std::filesystem::path modelPath;
+        std::uint32_t material;
+    };
+
+    struct SceneInstance
+    {
+        std::uint32_t mesh;
+        Transform transform;
+    };
+
+    struct SceneDescription
+    {
+        std::vector<SceneMaterial> materials;
+        std::vector<SceneMesh> meshes;
+        std::vector<SceneInstance> instances;
+        std::vector<PointLight> lights;
+    };
+
+    struct MeshData
+    {
+        std::vector<Vertex> vertices;
+        std::vector<std::uint32_t> indices;
+    };
+
+    // Where one mesh lives inside the merged vertex and index buffers.
+    struct MeshRange
+    {
+        std::uint32_t firstIndex;
+        std::uint32_t indexCount;
+        std::int32_t vertexOffset;
+        std::uint32_t vertexCount;
+        std::uint32_t material;
+        std::uint32_t firstCluster;
+        std::uint32_t clusterCount;
+        BoundingSphere bounds;
+    };
+
+    struct DrawItem
+    {
+        std::uint32_t firstIndex;
+        std::uint32_t indexCount;
+        std::int32_t vertexOffset;
+        std::uint32_t material;
+        std::uint32_t mesh;
+        Transform transform;
+    };
+
+    // Line based text format; '#' starts a comment and paths are relative to the scene file.
+    //   material <name> <texture>
+    //   mesh <name> <model.obj> <material>
+    //   instance <mesh> <x> <y> <z> [<scale>]
+    //   light <x> <y> <z> <radius> <r> <g> <b>
+    SceneDescription load_scene(const std::filesystem::path& path);
+    SceneDescription single_model_scene(const std::filesystem::path& modelPath, const std::filesystem::path& texturePath);
+    MeshData load_obj(const std::filesystem::path& path);
+
+    // Packs every mesh into one vertex and one index buffer so a whole scene draws from a single binding.
+    class SceneGeometry final
+    {
+    public:
+        std::uint32_t add_mesh(const MeshData& mesh, std::uint32_t material);
+
+        std::vector<Vertex> vertices;
+        std::vector<std::uint32_t> indices;
+        std::vector<MeshRange> meshes;
+    };
+
+    std::vector<DrawItem> build_draw_list(std::span<const MeshRange> meshes, std::span<const SceneInstance> instances);
+}
+
+#endif
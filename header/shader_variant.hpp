@@ -0,0 +1,96 @@
+#ifndef SHADER_VARIANT_HPP
+#define SHADER_VARIANT_HPP
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+
+#include "utils.hpp"
+
+namespace app
+{
+    // Bit positions double as specialization constant ids in shader.vert and shader.frag.
+    enum class ShaderFeature : std::uint32_t
+    {
+        textured,
+        vertexColor,
+        quantized,
+        instanced,
+        lit,
+        count
+    };
+
+    class ShaderVariantKey final
+    {
+    public:
+        constexpr ShaderVariantKey() = default;
+        constexpr ShaderVariantKey(std::initializer_list<ShaderFeature> features)
+        {
+            for(const auto feature : features)
+            {
+                bits |= 1u << static_cast<std::uint32_t>(feature);
+            }
+        }
+
+        constexpr bool has(ShaderFeature feature) const
+        {
+            return bits & (1u << static_cast<std::uint32_t>(feature));
+        }
+
+        constexpr ShaderVariantKey with(ShaderFeature feature) const
+        {
+            ShaderVariantKey key{*this};
+            key.bits |= 1u << static_cast<std::uint32_t>(feature);
+            return key;
+        }
+
+        constexpr ShaderVariantKey only(ShaderVariantKey mask) const
+        {
+            ShaderVariantKey key{};
+            key.bits = bits & mask.bits;
+            return key;
+        }
+
+        constexpr std::uint32_t value() const
+        {
+            return bits;
+        }
+
+        std::string name() const;
+        bool operator==(const ShaderVariantKey&) const = default;
+    private:
+        std::uint32_t bits{0};
+    };
+
+    // Parses a comma separated feature list such as "textured,vertex-color".
+    ShaderVariantKey parse_shader_variant(std::string_view features);
+
+    // Specialization data shared by every stage of a variant; ids a stage does not declare are ignored.
+    class ShaderSpecialization final
+    {
+    public:
+        explicit ShaderSpecialization(ShaderVariantKey key);
+        ShaderSpecialization(const ShaderSpecialization&) = delete;
+        ShaderSpecialization& operator=(const ShaderSpecialization&) = delete;
+
+        const VkSpecializationInfo* info() const;
+    private:
+        constexpr static std::size_t featureCount{static_cast<std::size_t>(ShaderFeature::count)};
+
+        std::array<VkBool32, featureCount> values;
+        std::array<VkSpecializationMapEntry, featureCount> entries;
+        VkSpecializationInfo specializationInfo;
+    };
+}
+
+namespace std
+{
+    template<> struct hash<app::ShaderVariantKey>
+    {
+        size_t operator()(const app::ShaderVariantKey& key) const;
+    };
+}
+
+#endif
@@ -1,23 +1,62 @@
 #ifndef TRIANGLE_APP_HPP
 #define TRIANGLE_APP_HPP
 
+#include <algorithm>
+#include <bit>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <ostream>
 #include <string_view>
+#include <unordered_map>
 
 #include "utils.hpp"
+#include "options.hpp"
+#include "profiler.hpp"
+#include "deletion_queue.hpp"
+#include "resource.hpp"
+#include "culling.hpp"
+#include "resolution.hpp"
+#include "device_profile.hpp"
+#include "shader_variant.hpp"
+#include "texture_streaming.hpp"
+#include "texture_atlas.hpp"
+#include "downsample.hpp"
+#include "lighting.hpp"
+#include "resource_cache.hpp"
+#include "scene.hpp"
+#include "thread_pool.hpp"
+#include "frame_arena.hpp"
+#include "transform.hpp"
+#include "file_watcher.hpp"
+#include "memory_registry.hpp"
 
 namespace app
 {
     class System final
     {
+        // Pipelines built off the render thread from freshly read SPIR-V, waiting to replace the live ones.
+        struct ShaderRebuild
+        {
+            std::vector<char> vertexCode;
+            std::vector<char> fragmentCode;
+            std::unordered_map<ShaderVariantKey, VkPipeline> graphicsPipelines;
+            VkPipeline depthPrePassPipeline;
+        };
     public:
-        System(const std::uint32_t width, const std::uint32_t height);
+        System(const Options& options);
         ~System();
         void run();
+        MemoryUsage memory_usage() const;
+        Statistics gpu_frame_statistics() const;
+        void write_report(std::ostream& out) const;
+        void write_memory_report(std::ostream& out) const;
     private:
         void create_instance();
         void create_window(const std::uint32_t width, const std::uint32_t height, const std::string_view name);
         static void framebuffer_resize_callback(GLFWwindow* window, std::int32_t width, std::int32_t height);
+        static void key_callback(GLFWwindow* window, std::int32_t key, std::int32_t scancode, std::int32_t action, std::int32_t mods);
         void show_extensions_support() const;
         bool check_validation_layer_support() const;
         std::vector<const char*> required_extensions() const;
@@ -28,6 +67,15 @@ namespace app
         void setup_debug_messages();
         void populate_debug_messenger_create_info(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
         void pick_physical_device();
+        DeviceTraits device_traits(VkPhysicalDevice device);
+        void query_device_features();
+        DeviceProfileKey device_profile_key();
+        void tune_device_profile();
+        TuningMeasurements measure_device();
+        void record_sample_cost(VkCommandBuffer commandBuffer, VkImage colorImage, VkImage depthImage, VkFormat depthFormat, 
+                                VkImage resolveImage, VkSampleCountFlagBits samples);
+        double time_commands(const std::function<void(VkCommandBuffer)>& record);
+        std::vector<const char*> required_device_extensions() const;
         bool check_device_extension_support(VkPhysicalDevice device);
         bool is_device_suitable(VkPhysicalDevice device);
         SwapChainSupportDetails query_swap_chain_support(VkPhysicalDevice device);
@@ -38,99 +86,289 @@ namespace app
         VkPresentModeKHR choose_swap_present_mode(const std::vector<VkPresentModeKHR>& availablePresentModes) const; 
         VkExtent2D choose_swap_extent(const VkSurfaceCapabilitiesKHR& capabilities) const;
         void create_swap_chain();
+        void create_offscreen_targets();
         void cleanup_swap_chain();
+        void retire_render_targets();
         void recreate_swap_chain();
-        void create_image_views();
+        void recreate_render_targets();
+        std::uint64_t completed_frames() const;
+        void name_object(VkObjectType objectType, std::uint64_t handle, std::string_view objectName);
         void create_descriptor_set_layout();
+        void read_shaders();
+        void create_pipeline_layout();
+        VkPipeline create_mesh_pipeline(VkRenderPass targetRenderPass, VkSampleCountFlagBits samples, bool depthOnly, ShaderVariantKey variant);
+        VkPipeline create_mesh_pipeline(VkRenderPass targetRenderPass, VkSampleCountFlagBits samples, bool depthOnly, ShaderVariantKey variant,
+                                        const std::vector<char>& vertexCode, const std::vector<char>& fragmentCode);
+        VkPipeline graphics_pipeline(ShaderVariantKey variant);
         void create_graphics_pipeline();
+        void create_depth_pre_pass_pipeline();
+        void create_shader_watcher();
+        void poll_shader_reload();
+        void compile_shader(const std::filesystem::path& source);
+        void start_shader_rebuild();
+        void finish_shader_rebuild();
+        void wait_shader_rebuild();
+        void destroy_shader_rebuild(const ShaderRebuild& rebuild);
+        void create_cull_pipeline();
+        void create_hi_z_pipeline();
+        void create_light_cull_pipeline();
+        void create_depth_pre_pass();
+        VkFormat find_occlusion_depth_format();
+        void create_occlusion_resources();
+        void create_hi_z_descriptor_sets();
         VkShaderModule create_shader_module(const std::vector<char>& code);
         void create_render_pass();
-        void create_frame_buffers();
+        void create_frame_buffer();
         void create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, 
-                           VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+                           Buffer& buffer, Allocation& bufferMemory, MemoryCategory category, std::string_view objectName);
         void create_vertex_buffer();
         void create_index_buffer();
-        std::uint32_t find_memory_type(std::uint32_t typeFilter, VkMemoryPropertyFlags properties);
+        void create_device_buffer(const void* source, VkDeviceSize size, VkBufferUsageFlags usage, Buffer& buffer, Allocation& bufferMemory, 
+                                  MemoryCategory category, std::string_view objectName);
+        void create_clusters();
+        void create_object_buffers();
+        void create_cluster_buffer();
+        std::uint32_t max_draw_count() const;
+        void create_draw_buffers();
+        void create_light_buffers();
+        std::optional<std::uint32_t> find_memory_type(std::uint32_t typeFilter, VkMemoryPropertyFlags properties);
+        Allocation allocate_memory(const VkMemoryRequirements& memoryRequirements, VkMemoryPropertyFlags properties, 
+                                   MemoryCategory category, std::string_view objectName);
         void copy_buffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
         void create_uniform_buffers();
         void create_descriptor_pool();
         void create_descriptor_sets();
         void create_image(std::uint32_t width, std::uint32_t height, std::uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, 
-                          VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+                          VkMemoryPropertyFlags properties, Image& image, Allocation& imageMemory, MemoryCategory category, std::string_view objectName, 
+                          std::uint32_t arrayLayers = 1);
         VkFormat find_supported_format(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
         VkFormat find_depth_format();
         bool has_stencil_component(VkFormat format);
         void create_depth_resources();
+        void decode_textures();
         void create_texture_image();
-        VkImageView create_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, std::uint32_t mipLevels);
+        ImageView create_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, std::uint32_t mipLevels, 
+                                    std::uint32_t baseMipLevel = 0, VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D, 
+                                    std::uint32_t layerCount = 1);
         void create_texture_image_view();
         void create_texture_sampler();
+        std::size_t acquire_texture(TextureData texture);
+        void create_material_buffer();
+        VkSampler acquire_sampler(const VkSamplerCreateInfo& samplerInfo);
+        void update_texture_streaming();
+        void record_texture_streaming(VkCommandBuffer commandBuffer);
+        void record_texture_residency(VkCommandBuffer commandBuffer, std::uint32_t firstLevel);
+        void update_texture_descriptor(std::uint32_t frame);
         VkCommandBuffer begin_single_time_commands();
         void end_single_time_commands(VkCommandBuffer commandBuffer);
-        void transition_image_layout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, std::uint32_t mipLevels);
-        void copy_buffer_to_image(VkBuffer buffer, VkImage image, std::uint32_t width, std::uint32_t height);
         void create_command_pool();
         void create_command_buffers();
         void record_command_buffer(VkCommandBuffer commandBuffer, std::uint32_t imageIndex);
+        void record_culling(VkCommandBuffer commandBuffer, std::uint32_t phase);
+        void record_depth_pre_pass(VkCommandBuffer commandBuffer);
+        void record_hi_z(VkCommandBuffer commandBuffer);
+        void record_light_culling(VkCommandBuffer commandBuffer);
+        void record_indirect_draws(VkCommandBuffer commandBuffer, std::uint32_t phase);
+        void record_cull_statistics(VkCommandBuffer commandBuffer);
+        void record_upscale(VkCommandBuffer commandBuffer, std::uint32_t imageIndex);
+        void read_cull_statistics(std::uint32_t frame);
         void create_sync_objects();
         void draw_frame();
         void update_uniform_buffer(std::uint32_t currentImage);
-        void load_model();
-        void generate_mipmaps(VkImage image, VkFormat imageFormat, std::uint32_t width, std::uint32_t height, std::uint32_t mipLevels);
+        void load_scene_description();
+        void load_scene();
         void create_color_resources();
-        VkSampleCountFlagBits max_usable_sample_count();
+        void report_transient_attachments();
+        bool capturing() const;
+        void create_readback_buffers();
+        void create_readback_buffer(std::size_t slot);
+        void record_readback(VkCommandBuffer commandBuffer, std::uint32_t imageIndex);
+        void collect_readbacks(std::uint64_t completedFrames);
+        void drain_readbacks();
+        void create_timestamp_queries();
+        std::optional<double> read_gpu_time(std::uint32_t frame);
+        bool finished() const;
 
-        GLFWwindow* window;
-        VkInstance instance;
-        VkDebugUtilsMessengerEXT debugMessenger;
-        VkSurfaceKHR surface;
+        Options options;
+        Profiler profiler;
+        ThreadPool jobs;
+        MemoryCounter memoryCounter;
+        MemoryCounter lazyMemoryCounter;
+        MemoryRegistry memoryRegistry;
+
+        Window window;
+        Instance instance;
+        DebugMessenger debugMessenger;
+        Surface surface;
         VkPhysicalDevice physicalDevice;
-        VkDevice device;
+        VkPhysicalDeviceFeatures supportedFeatures;
+        VkPhysicalDeviceVulkan12Features supportedVulkan12Features;
+        Device device;
+        PFN_vkSetDebugUtilsObjectNameEXT setDebugUtilsObjectName;
+        ResourceCache<TextureKey, std::size_t> textureCache;
+        ResourceCache<SamplerKey, Sampler> samplerCache;
+        DeletionQueue deletionQueue;
         VkQueue graphicsQueue;
         VkQueue presentQueue;
         VkSwapchainKHR swapChain;
         std::vector<VkImage> swapChainImages;
         VkFormat swapChainImageFormat;
         VkExtent2D swapChainExtent;
-        std::vector<VkImageView> swapChainImageViews;
+        std::vector<Image> offscreenImages;
+        std::vector<Allocation> offscreenImagesMemory;
         VkRenderPass renderPass;
         VkDescriptorSetLayout descriptorSetLayout;
         VkPipelineLayout pipelineLayout;
-        VkPipeline graphicsPipeline;
-        std::vector<VkFramebuffer> swapChainFrameBuffers;
+        std::unordered_map<ShaderVariantKey, VkPipeline> graphicsPipelines;
+        VkPipelineLayout cullPipelineLayout;
+        VkPipeline cullPipeline;
+        VkDescriptorSetLayout hiZDescriptorSetLayout;
+        VkPipelineLayout hiZPipelineLayout;
+        VkPipeline hiZPipeline;
+        VkPipelineLayout lightCullPipelineLayout;
+        VkPipeline lightCullPipeline;
+        VkRenderPass depthPrePass;
+        VkPipeline depthPrePassPipeline;
+        Framebuffer sceneFrameBuffer;
+        SceneDescription scene;
         std::vector<Vertex> vertices;
         std::vector<std::uint32_t> indices;
-        VkBuffer vertexBuffer;
-        VkDeviceMemory vertexBufferMemory;
-        VkBuffer indexBuffer;
-        VkDeviceMemory indexBufferMemory;
-        std::vector<VkBuffer> uniformBuffers;
-        std::vector<VkDeviceMemory> uniformBuffersMemory;
+        std::vector<MeshRange> meshes;
+        std::vector<DrawItem> drawList;
+        std::vector<std::size_t> materialTextures;
+        std::vector<TextureData> atlasTextures;
+        std::vector<AtlasPlacement> materialPlacements;
+        std::vector<char> vertexShaderCode;
+        std::vector<char> fragmentShaderCode;
+        std::vector<char> cullShaderCode;
+        std::vector<char> downsampleShaderCode;
+        std::vector<char> lightCullShaderCode;
+        std::optional<FileWatcher> shaderWatcher;
+        JobCounter shaderCompileJobs;
+        JobCounter shaderRebuildJob;
+        std::optional<ShaderRebuild> shaderRebuild;
+        bool shaderRebuildRunning;
+        bool shaderRebuildQueued;
+        glm::vec4 positionScale;
+        glm::vec4 positionOffset;
+        Buffer vertexBuffer;
+        Allocation vertexBufferMemory;
+        Buffer indexBuffer;
+        Allocation indexBufferMemory;
+        std::vector<ClusterData> clusters;
+        std::vector<ObjectData> objects;
+        std::uint32_t drawCapacity;
+        TransformSystem transforms;
+        std::vector<Buffer> objectBuffers;
+        std::vector<Allocation> objectBuffersMemory;
+        std::vector<void*> objectBuffersMapped;
+        Buffer clusterBuffer;
+        Allocation clusterBufferMemory;
+        Buffer materialBuffer;
+        Allocation materialBufferMemory;
+        std::vector<PointLight> lights;
+        Buffer lightBuffer;
+        Allocation lightBufferMemory;
+        std::vector<Buffer> lightGridBuffers;
+        std::vector<Allocation> lightGridBuffersMemory;
+        std::vector<Buffer> lightIndexBuffers;
+        std::vector<Allocation> lightIndexBuffersMemory;
+        std::vector<Buffer> drawCommandBuffers;
+        std::vector<Allocation> drawCommandBuffersMemory;
+        std::vector<Buffer> drawCountBuffers;
+        std::vector<Allocation> drawCountBuffersMemory;
+        std::vector<Buffer> uniformBuffers;
+        std::vector<Allocation> uniformBuffersMemory;
         std::vector<void*> uniformBuffersMapped;
+        UniformBufferObject frameUniforms;
         VkDescriptorPool descriptorPool;
         std::vector<VkDescriptorSet> descriptorSets;
         VkCommandPool commandPool;
         std::vector<VkCommandBuffer> commandBuffers;
-        VkImage depthImage;
-        VkDeviceMemory depthImageMemory;
-        VkImageView depthImageView;
+        Image depthImage;
+        Allocation depthImageMemory;
+        ImageView depthImageView;
         std::uint32_t mipLevels;
-        VkImage textureImage;
-        VkDeviceMemory textureImageMemory;
-        VkImageView textureImageView;
+        TextureStreamer textureStreamer;
+        std::size_t streamedTexture;
+        std::uint32_t textureFirstLevel;
+        std::optional<std::uint32_t> pendingTextureLevel;
+        std::uint64_t textureVersion;
+        std::vector<std::uint64_t> textureDescriptorVersions;
+        Image textureImage;
+        Allocation textureImageMemory;
+        ImageView textureImageView;
         VkSampler textureSampler;
         VkSampleCountFlagBits msaaSamples;
-        VkImage colorImage;
-        VkDeviceMemory colorImageMemory;
-        VkImageView colorImageView;
+        Image colorImage;
+        Allocation colorImageMemory;
+        ImageView colorImageView;
+        Image sceneColorImage;
+        Allocation sceneColorImageMemory;
+        ImageView sceneColorImageView;
+        VkFilter upscaleFilter;
+        ResolutionController resolution;
+        DeviceProfile deviceProfile;
+        VkExtent2D renderExtent;
+        Image occlusionDepthImage;
+        Allocation occlusionDepthImageMemory;
+        ImageView occlusionDepthImageView;
+        Framebuffer depthPrePassFrameBuffer;
+        Image hiZImage;
+        Allocation hiZImageMemory;
+        ImageView hiZImageView;
+        std::vector<ImageView> hiZMipViews;
+        VkSampler hiZSampler;
+        Buffer hiZScratchBuffer;
+        Allocation hiZScratchBufferMemory;
+        VkDescriptorSet hiZDescriptorSet;
+        Buffer visibilityBuffer;
+        Allocation visibilityBufferMemory;
+        std::vector<Buffer> cullStatisticsBuffers;
+        std::vector<Allocation> cullStatisticsBuffersMemory;
+        std::vector<void*> cullStatisticsBuffersMapped;
+        std::vector<std::optional<std::uint64_t>> cullStatisticsFrames;
         std::vector<VkSemaphore> imageAvailableSemaphores;
         std::vector<VkSemaphore> renderFinishedSemaphores;
         std::vector<VkFence> inFlightFences;
+        VkSemaphore frameTimeline;
+        std::vector<FrameArena> frameArenas;
+        std::vector<Buffer> readbackBuffers;
+        std::vector<Allocation> readbackBuffersMemory;
+        std::vector<void*> readbackBuffersMapped;
+        std::vector<VkExtent2D> readbackExtents;
+        std::vector<std::optional<std::uint64_t>> readbackFrames;
+        std::deque<JobCounter> readbackJobs;
+        std::uint64_t capturedFrames;
+        std::uint64_t captureStalls;
         std::uint32_t currentFrame;
+        std::uint64_t frameNumber;
         bool framebufferResized;
+        bool memoryReportRequested;
+        VkQueryPool timestampQueryPool;
+        double timestampPeriod;
+        std::uint64_t timestampMask;
+        std::vector<std::optional<std::uint64_t>> timestampFrames;
+        Profiler::Clock::time_point startTime;
+        Profiler::Clock::time_point measurementStart;
+        Profiler::Clock::time_point previousFrameStart;
 
         constexpr static std::string_view name{"Vulkan Triangle"};
         constexpr static std::int32_t maxFramesInFlight{2};
+        constexpr static VkExtent2D occlusionExtent{512, 256};
+        constexpr static std::uint32_t hiZLevels{static_cast<std::uint32_t>(std::bit_width(std::max(occlusionExtent.width, occlusionExtent.height)))};
+        constexpr static std::uint32_t streamingTailExtent{64};
+        constexpr static float nearPlane{1.0f};
+        constexpr static float farPlane{10.0f};
+        constexpr static std::uint32_t lightSeed{1};
+        constexpr static double tuningFrameBudgetMilliseconds{1000.0 / 60.0};
+        constexpr static std::uint32_t tuningIterations{8};
+        constexpr static VkDeviceSize tuningUploadBytes{16 << 20};
+        constexpr static VkFormat tuningColorFormat{VK_FORMAT_B8G8R8A8_SRGB};
+        constexpr static std::size_t readbackRingSize{maxFramesInFlight + 2};
+        constexpr static std::string_view shaderDirectory{SHADER_DIRECTORY};
+        constexpr static std::string_view shaderSourceDirectory{SHADER_SOURCE_DIRECTORY};
+        constexpr static std::string_view shaderCompiler{GLSLC_EXECUTABLE};
         constexpr static std::string_view modelPath{"../model/viking_room.obj"};
         constexpr static std::string_view texturePath{"../texture/viking_room.png"};
 
@@ -0,0 +1,58 @@
+#ifndef TASK_GRAPH_HPP
+#define TASK_GRAPH_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "profiler.hpp"
+#include "thread_pool.hpp"
+
+namespace app
+{
+    // Startup work as tasks that run once their dependencies are done. A task that throws skips its dependents and
+    // theirs in turn; unrelated tasks still run, and run rethrows the first error once nothing is left in flight.
+    class TaskGraph final
+    {
+    public:
+        using TaskId = std::size_t;
+
+        enum class Affinity
+        {
+            any,
+            main
+        };
+
+        TaskId add(std::string name, std::vector<TaskId> dependencies, std::move_only_function<void()> work, 
+                   Affinity affinity = Affinity::any);
+        void run(ThreadPool& pool, Profiler& profiler);
+    private:
+        struct Task
+        {
+            std::string name;
+            std::move_only_function<void()> work;
+            std::vector<TaskId> dependents;
+            std::size_t remainingDependencies;
+            Affinity affinity;
+            bool skipped{false};
+        };
+
+        void schedule(TaskId id);
+        void execute(TaskId id);
+
+        std::vector<Task> tasks;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<TaskId> mainThreadTasks;
+        std::size_t pendingTasks{0};
+        std::exception_ptr error;
+        ThreadPool* pool{nullptr};
+        Profiler* profiler{nullptr};
+    };
+}
+
+#endif
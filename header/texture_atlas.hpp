@@ -0,0 +1,67 @@
+#ifndef TEXTURE_ATLAS_HPP
+#define TEXTURE_ATLAS_HPP
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "utils.hpp"
+#include "texture_streaming.hpp"
+#include "thread_pool.hpp"
+
+namespace app
+{
+    // Where a texture ended up: uv * uvTransform.xy + uvTransform.zw inside array layer `layer`. maxFootprint is the
+    // widest texel, in layer uv, the entry may be sampled at before coarser levels blend in its neighbours. One entry
+    // per material in the material buffer, so the layout matches MaterialData in shader.frag.
+    struct AtlasPlacement
+    {
+        glm::vec4 uvTransform;
+        std::uint32_t layer;
+        float maxFootprint;
+        std::array<std::uint32_t, 2> unused;
+    };
+    static_assert(sizeof(AtlasPlacement) == 32, "AtlasPlacement must match the std430 layout in the shaders.");
+
+    // Square layers of one 2D array image with a full mip chain. Textures spanning more than half a layer get a layer
+    // of their own; smaller ones share layers.
+    struct TextureAtlas
+    {
+        std::uint32_t extent;
+        std::vector<TextureData> layers;
+        std::vector<AtlasPlacement> placements;
+    };
+
+    // Bottom-left skyline packer over a fixed rectangle.
+    class SkylinePacker final
+    {
+    public:
+        SkylinePacker(std::uint32_t width, std::uint32_t height);
+
+        // Top-left corner of a free width x height rectangle, or nothing once the area is full.
+        std::optional<glm::uvec2> insert(std::uint32_t width, std::uint32_t height);
+    private:
+        struct Segment
+        {
+            std::uint32_t x;
+            std::uint32_t y;
+            std::uint32_t width;
+        };
+
+        std::vector<Segment> skyline;
+        std::uint32_t width;
+        std::uint32_t height;
+    };
+
+    // Shared textures are surrounded by padding texels copied from their edges and start on a multiple of padding, so
+    // the first log2(padding) + 1 mip levels never filter across into a neighbour; their maxFootprint stops sampling
+    // there. A texture with a layer of its own has its edges repeated to the end of the layer and uses every level.
+    TextureAtlas pack_texture_atlas(std::span<const TextureData> textures, std::uint32_t padding = 8);
+
+    // One MipLevel per atlas level holding every layer back to back, as a buffer to array image copy expects them.
+    std::vector<MipLevel> build_atlas_mip_chain(const TextureAtlas& atlas, ThreadPool* pool = nullptr);
+}
+
+#endif
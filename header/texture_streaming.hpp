@@ -0,0 +1,83 @@
+#ifndef TEXTURE_STREAMING_HPP
+#define TEXTURE_STREAMING_HPP
+
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "utils.hpp"
+#include "thread_pool.hpp"
+
+namespace app
+{
+    struct MipLevel
+    {
+        std::uint32_t width;
+        std::uint32_t height;
+        std::vector<std::uint8_t> pixels;
+        // Array layers stored back to back in pixels, each width x height.
+        std::uint32_t layers{1};
+    };
+
+    struct StreamingChange
+    {
+        std::size_t texture;
+        std::uint32_t firstLevel;
+    };
+
+    // Box filtered RGBA8 sRGB chain down to 1x1. Colour is averaged in linear space, as a blit from an sRGB image would.
+    // Rows of the larger levels are spread over the pool when one is given.
+    std::vector<MipLevel> build_mip_chain(const TextureData& texture, ThreadPool* pool = nullptr);
+    VkDeviceSize mip_chain_bytes(std::uint32_t width, std::uint32_t height);
+
+    // Height in pixels covered by a bounding sphere given in object space.
+    float projected_diameter(const glm::mat4& world, const glm::vec4& boundingSphere, const glm::mat4& view,
+                             const glm::mat4& projection, float viewportHeight);
+
+    // Finest level worth keeping when the whole texture spans projectedPixels on screen.
+    std::uint32_t wanted_mip_level(std::uint32_t textureExtent, float projectedPixels, std::uint32_t levelCount);
+
+    // Decides which mip levels of each texture live in video memory. A coarse tail is always resident, finer levels are
+    // brought in one per update on request and the least recently requested ones are evicted when the budget runs out.
+    // A texture never evicts its own levels to make room for itself, so with a single texture the budget only limits how
+    // fine it is streamed.
+    class TextureStreamer final
+    {
+    public:
+        TextureStreamer() = default;
+        explicit TextureStreamer(VkDeviceSize budgetBytes);
+
+        std::size_t add(std::vector<MipLevel> levels, std::uint32_t tailExtent);
+        // Bytes one update may bring in. The first level of an update is always allowed so large levels still arrive.
+        void set_upload_budget(VkDeviceSize bytes);
+        void request(std::size_t texture, std::uint32_t level, std::uint64_t frame);
+        // The changes stay valid until the next update; the scratch behind them is reused so steady frames do not allocate.
+        std::span<const StreamingChange> update();
+        std::uint32_t first_resident_level(std::size_t texture) const;
+        std::uint32_t level_count(std::size_t texture) const;
+        const MipLevel& level(std::size_t texture, std::uint32_t level) const;
+        VkDeviceSize resident_bytes() const;
+    private:
+        struct StreamedTexture
+        {
+            std::vector<MipLevel> levels;
+            std::uint32_t tailLevel;
+            std::uint32_t firstResident;
+            std::uint32_t wantedLevel;
+            std::uint64_t lastRequest;
+        };
+
+        bool evict_one(std::size_t requester, std::vector<StreamingChange>& changes);
+        static void record_change(std::vector<StreamingChange>& changes, std::size_t texture, std::uint32_t firstLevel);
+
+        std::vector<StreamedTexture> textures;
+        VkDeviceSize budgetBytes{0};
+        VkDeviceSize residentTotal{0};
+        VkDeviceSize uploadBudgetBytes{std::numeric_limits<VkDeviceSize>::max()};
+        std::vector<std::size_t> updateOrder;
+        std::vector<StreamingChange> updateChanges;
+    };
+}
+
+#endif
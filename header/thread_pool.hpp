@@ -0,0 +1,83 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace app
+{
+    // Counts jobs that are still outstanding and keeps the first exception one of them threw.
+    class JobCounter final
+    {
+    public:
+        bool done() const;
+    private:
+        friend class ThreadPool;
+
+        std::atomic<std::size_t> pending{0};
+        std::mutex mutex;
+        std::exception_ptr error;
+    };
+
+    // Work-stealing pool. Each worker pushes and pops its own deque from the back and steals from the front of the
+    // others; threads outside the pool feed a shared injection queue. Waiting on a counter runs other jobs meanwhile,
+    // so jobs can fork and join without tying up a worker. wait_blocking sleeps instead, for threads that must not pick
+    // up unrelated work in the middle of what they are doing.
+    class ThreadPool final
+    {
+    public:
+        explicit ThreadPool(std::size_t threadCount = std::thread::hardware_concurrency(), bool pinThreads = false);
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        void submit(std::move_only_function<void()> task);
+        void submit(JobCounter& counter, std::move_only_function<void()> task);
+        void wait(JobCounter& counter);
+        void wait_blocking(JobCounter& counter);
+        std::size_t size() const;
+
+        // Calls body(begin, end) over [0, count) in chunks of at most grain items and returns once all have run.
+        template<typename Body>
+        void parallel_for(std::size_t count, std::size_t grain, Body&& body)
+        {
+            grain = std::max<std::size_t>(grain, 1);
+            JobCounter counter{};
+            for(std::size_t begin{0}; begin < count; begin += grain)
+            {
+                auto end{std::min(begin + grain, count)};
+                submit(counter, [&body, begin, end] { body(begin, end); });
+            }
+            wait(counter);
+        }
+    private:
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<std::move_only_function<void()>> tasks;
+        };
+
+        static void rethrow_error(JobCounter& counter);
+        std::size_t current_queue() const;
+        std::optional<std::move_only_function<void()>> take(std::size_t queue);
+        bool run_one(std::size_t queue);
+        void worker(std::stop_token stopToken, std::size_t index, bool pin);
+
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::atomic<std::size_t> queuedTasks{0};
+        std::mutex sleepMutex;
+        std::condition_variable_any condition;
+        std::vector<std::jthread> workers;
+    };
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef TRANSFORM_HPP
+#define TRANSFORM_HPP
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include "utils.hpp"
+#include "culling.hpp"
+
+namespace app
+{
+    struct Transform
+    {
+        glm::vec3 position{0.0f};
+        glm::quat rotation{1.0f, 0.0f, 0.0f, 0.0f};
+        glm::vec3 scale{1.0f};
+    };
+
+    // Translation * rotation * scale, the scalar reference for what TransformSystem computes in batches.
+    glm::mat4 to_matrix(const Transform& transform);
+
+    // Position, rotation and scale kept as one array per component so a batch of objects loads straight into SIMD
+    // lanes. Only batches touched since the last update are recomputed, and each batch remembers the frame it last
+    // changed so per-frame copies of the world matrices can skip everything that is still current.
+    class TransformSystem final
+    {
+    public:
+        constexpr static std::size_t batchSize{8};
+
+        std::uint32_t add(const Transform& transform);
+        void set_position(std::uint32_t index, const glm::vec3& position);
+        void set_rotation(std::uint32_t index, const glm::quat& rotation);
+        void set_scale(std::uint32_t index, const glm::vec3& scale);
+
+        // Recomputes the world matrices of dirty batches and stamps them with frame. Returns how many were recomputed.
+        std::size_t update(std::uint64_t frame);
+
+        // Copies into objects[i].model the world matrices of batches changed at or after sinceFrame.
+        std::size_t write_models(std::span<ObjectData> objects, std::uint64_t sinceFrame) const;
+
+        const glm::mat4& world(std::uint32_t index) const;
+        std::size_t size() const;
+    private:
+        void mark_dirty(std::uint32_t index);
+        void compute_batch(std::size_t batch);
+
+        std::size_t count{0};
+        std::vector<float> positionX;
+        std::vector<float> positionY;
+        std::vector<float> positionZ;
+        std::vector<float> rotationX;
+        std::vector<float> rotationY;
+        std::vector<float> rotationZ;
+        std::vector<float> rotationW;
+        std::vector<float> scaleX;
+        std::vector<float> scaleY;
+        std::vector<float> scaleZ;
+        std::vector<glm::mat4> worlds;
+        std::vector<std::uint8_t> dirtyBatches;
+        std::vector<std::uint64_t> batchChangedFrames;
+    };
+}
+
+#endif
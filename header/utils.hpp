@@ -4,8 +4,12 @@
 #include <optional>
 #include <vector>
 #include <array>
+#include <cstdint>
+#include <span>
 
-#define VK_USE_PLATFORM_WIN32_KHR
+#if defined(_WIN32)
+    #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
@@ -28,6 +32,25 @@ namespace app
         glm::vec2 textureCoordinate;
     };
 
+    // Half the size of Vertex. Positions are normalized to the mesh bounds and decoded in the vertex shader.
+    struct QuantizedVertex
+    {
+        static VkVertexInputBindingDescription binding_description();
+        static std::array<VkVertexInputAttributeDescription, 3> attribute_description();
+        std::array<std::int16_t, 4> position;
+        std::array<std::uint8_t, 4> color;
+        std::array<std::uint16_t, 2> textureCoordinate;
+    };
+
+    struct QuantizedMesh
+    {
+        std::vector<QuantizedVertex> vertices;
+        glm::vec3 positionScale;
+        glm::vec3 positionOffset;
+    };
+
+    QuantizedMesh quantize_vertices(std::span<const Vertex> vertices);
+
     constexpr inline std::array<const char*, 1> validationLayers
     {
         "VK_LAYER_KHRONOS_validation"
@@ -56,11 +79,25 @@ namespace app
         std::vector<VkPresentModeKHR> presentModes;
     };
 
+    struct TextureData
+    {
+        std::int32_t width;
+        std::int32_t height;
+        std::vector<std::uint8_t> pixels;
+    };
+
     struct UniformBufferObject
     {
         glm::mat4 model;
         glm::mat4 view;
         glm::mat4 projection;
+        glm::vec4 positionScale;
+        glm::vec4 positionOffset;
+        glm::mat4 viewProjection;
+        glm::mat4 inverseProjection;
+        // Render width and height in pixels, then the near and far planes the light clusters are sliced between.
+        glm::vec4 clusterViewport;
+        std::uint32_t lightCount;
     };
     
     VkResult create_debug_utils_messanger_ext(VkInstance instance, 
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <print>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "culling.hpp"
+#include "texture_streaming.hpp"
+#include "thread_pool.hpp"
+
+namespace
+{
+    template<typename Work>
+    double best_milliseconds(std::uint32_t repetitions, Work&& work)
+    {
+        double best{0.0};
+        for(std::uint32_t i{0}; i < repetitions; ++i)
+        {
+            auto start{std::chrono::steady_clock::now()};
+            work();
+            auto elapsed{std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()};
+            best = i == 0 ? elapsed : std::min(best, elapsed);
+        }
+        return best;
+    }
+
+    app::TextureData make_texture(std::int32_t extent)
+    {
+        app::TextureData texture{extent, extent, {}};
+        texture.pixels.resize(static_cast<std::size_t>(extent) * extent * 4);
+        for(std::size_t i{0}; i < std::size(texture.pixels); ++i)
+        {
+            texture.pixels[i] = static_cast<std::uint8_t>(i * 2654435761u >> 24);
+        }
+        return texture;
+    }
+
+    std::vector<app::ObjectData> make_objects(std::uint32_t count, std::uint32_t clustersPerObject)
+    {
+        std::vector<app::ObjectData> objects{};
+        for(const auto& position : app::layout_object_grid(count, {glm::vec3{0.0f}, 1.0f}))
+        {
+            objects.push_back({glm::translate(glm::mat4{1.0f}, position), glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}, 0, clustersPerObject, 0, 0});
+        }
+        return objects;
+    }
+}
+
+// Runs the CPU jobs the renderer hands to the pool with 1, 2, 4, ... workers and reports the speedup over one.
+int main()
+{
+    try
+    {
+        constexpr std::uint32_t repetitions{5};
+        constexpr std::uint32_t clustersPerObject{64};
+        auto texture{make_texture(4096)};
+        auto objects{make_objects(65536, clustersPerObject)};
+
+        std::vector<app::ClusterData> clusters(clustersPerObject);
+        for(std::uint32_t i{0}; i < clustersPerObject; ++i)
+        {
+            clusters[i].boundingSphere = glm::vec4{0.0f, 0.0f, static_cast<float>(i) * 0.01f, 0.2f};
+            clusters[i].cone = glm::vec4{0.0f, 0.0f, 1.0f, 0.5f};
+            clusters[i].indexCount = 372;
+        }
+
+        app::UniformBufferObject ubo{};
+        ubo.model = glm::mat4{1.0f};
+        ubo.view = glm::lookAt(glm::vec3{0.0f, -200.0f, 150.0f}, glm::vec3{0.0f}, glm::vec3{0.0f, 0.0f, 1.0f});
+        ubo.projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+
+        double mipBaseline{0.0};
+        double cullBaseline{0.0};
+        auto maxThreads{std::max(std::thread::hardware_concurrency(), 1u)};
+        std::vector<std::uint32_t> threadCounts{};
+        for(std::uint32_t threads{1}; threads < maxThreads; threads *= 2)
+        {
+            threadCounts.push_back(threads);
+        }
+        threadCounts.push_back(maxThreads);
+
+        std::println("{:>8} {:>12} {:>8} {:>12} {:>8}", "threads", "mips (ms)", "speedup", "cull (ms)", "speedup");
+        for(const auto threads : threadCounts)
+        {
+            app::ThreadPool pool{threads};
+            auto mips{best_milliseconds(repetitions, [&] { app::build_mip_chain(texture, &pool); })};
+            auto cull{best_milliseconds(repetitions, [&] { app::cull_clusters(objects, clusters, ubo, &pool); })};
+            if(threads == 1)
+            {
+                mipBaseline = mips;
+                cullBaseline = cull;
+            }
+            std::println("{:>8} {:>12.2f} {:>8.2f} {:>12.2f} {:>8.2f}", threads, mips, mipBaseline / mips, cull, cullBaseline / cull);
+        }
+    }
+    catch(const std::exception& e)
+    {
+        std::println(std::cerr, "{}", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <print>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "lighting.hpp"
+#include "system.hpp"
+
+namespace
+{
+    constexpr std::array<std::uint32_t, 6> lightCounts{16, 64, 256, 1'024, 4'096, 16'384};
+
+    template<typename Work>
+    double best_milliseconds(std::uint32_t repetitions, Work&& work)
+    {
+        double best{0.0};
+        for(std::uint32_t i{0}; i < repetitions; ++i)
+        {
+            auto start{std::chrono::steady_clock::now()};
+            work();
+            auto elapsed{std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()};
+            best = i == 0 ? elapsed : std::min(best, elapsed);
+        }
+        return best;
+    }
+
+    // The reference assignment on the renderer's default camera, with lights filling the space around the model.
+    void run_cpu_sweep()
+    {
+        constexpr std::uint32_t repetitions{3};
+        constexpr float nearPlane{1.0f};
+        constexpr float farPlane{10.0f};
+        app::UniformBufferObject ubo{};
+        ubo.model = glm::mat4{1.0f};
+        ubo.view = glm::lookAt(glm::vec3{2.0f, 2.0f, 2.0f}, glm::vec3{0.0f}, glm::vec3{0.0f, 0.0f, 1.0f});
+        ubo.projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, nearPlane, farPlane);
+        ubo.projection[1][1] *= -1;
+        ubo.inverseProjection = glm::inverse(ubo.projection);
+        ubo.clusterViewport = glm::vec4{1'920.0f, 1'080.0f, nearPlane, farPlane};
+
+        std::println("{:>8} {:>12} {:>12} {:>12} {:>12} {:>10}", "lights", "cpu (ms)", "per cluster", "max", "indices", "dropped");
+        for(const auto count : lightCounts)
+        {
+            auto lights{app::generate_lights(count, {glm::vec3{0.0f}, 1.5f}, 1)};
+            app::LightAssignment assignment{};
+            auto milliseconds{best_milliseconds(repetitions, [&]
+            {
+                assignment = app::assign_lights(lights, ubo);
+            })};
+
+            std::uint32_t occupied{0};
+            std::uint32_t most{0};
+            for(const auto& range : assignment.ranges)
+            {
+                occupied += range.y > 0;
+                most = std::max(most, range.y);
+            }
+            auto perCluster{occupied == 0 ? 0.0 : static_cast<double>(std::size(assignment.indices)) / occupied};
+            std::println("{:>8} {:>12.3f} {:>12.1f} {:>12} {:>12} {:>10}", count, milliseconds, perCluster, most,
+                         std::size(assignment.indices), assignment.droppedLights);
+        }
+    }
+
+    // Whole frames headless, first without lights and then with each count, so the table shows what lighting adds.
+    void run_gpu_sweep(const app::Options& defaults)
+    {
+        std::vector<std::uint32_t> counts{0};
+        counts.insert(std::end(counts), std::begin(lightCounts), std::end(lightCounts));
+
+        std::vector<std::pair<std::uint32_t, app::Statistics>> results{};
+        for(const auto count : counts)
+        {
+            auto options{defaults};
+            options.lightCount = count;
+            app::System program{options};
+            program.run();
+            results.emplace_back(count, program.gpu_frame_statistics());
+        }
+
+        std::println("{:>8} {:>12} {:>12} {:>12}", "lights", "gpu (ms)", "p95 (ms)", "added (ms)");
+        for(const auto& [count, statistics] : results)
+        {
+            std::println("{:>8} {:>12.3f} {:>12.3f} {:>12.3f}", count, statistics.mean, statistics.p95,
+                         statistics.mean - results.front().second.mean);
+        }
+    }
+}
+
+// Sweeps light counts from 16 to 16k through the CPU reference of the cluster assignment, reporting how densely the
+// clusters fill. With --gpu the renderer also runs headless at each count; any other options are passed through to it.
+int main(int argc, char** argv)
+{
+    try
+    {
+        std::vector<char*> arguments{argv, argv + argc};
+        auto gpu{std::erase_if(arguments, [](const char* argument) { return std::string_view{argument} == "--gpu"; }) > 0};
+
+        app::Options defaults{};
+        defaults.headless = true;
+        defaults.fixedTimestep = 1.0 / 60.0;
+        defaults.warmupFrames = 30;
+        defaults.frameCount = 300;
+        auto options{app::parse_options(arguments, defaults)};
+
+        run_cpu_sweep();
+        if(gpu)
+        {
+            run_gpu_sweep(options);
+        }
+    }
+    catch(const std::exception& e)
+    {
+        std::println(std::cerr, "{}", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
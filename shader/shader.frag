@@ -1,13 +1,136 @@
 #version 450
 
-layout(binding = 1) uniform sampler2D textureSampler;
+layout(constant_id = 0) const bool textured = true;
+layout(constant_id = 1) const bool vertexColor = false;
+layout(constant_id = 4) const bool lit = false;
+
+// Mirrors lighting.hpp and light_cull.comp.
+const uint clusterCountX = 16u;
+const uint clusterCountY = 9u;
+const uint clusterCountZ = 24u;
+const vec3 ambient = vec3(0.05);
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 projection;
+    vec4 positionScale;
+    vec4 positionOffset;
+    mat4 viewProjection;
+    mat4 inverseProjection;
+    vec4 clusterViewport;
+    uint lightCount;
+} ubo;
+
+layout(binding = 1) uniform sampler2DArray textureSampler;
+
+struct MaterialData
+{
+    vec4 uvTransform;
+    uint layer;
+    float maxFootprint;
+};
+
+layout(std430, binding = 8) readonly buffer MaterialBuffer {
+    MaterialData materials[];
+};
+
+struct PointLight
+{
+    vec4 positionRadius;
+    vec4 color;
+};
+
+layout(std430, binding = 9) readonly buffer LightBuffer {
+    PointLight lights[];
+};
+
+layout(std430, binding = 10) readonly buffer LightGridBuffer {
+    uvec2 lightGrid[];
+};
+
+layout(std430, binding = 11) readonly buffer LightIndexBuffer {
+    uint lightIndexCount;
+    uint lightIndices[];
+};
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTextureCoordinates;
+layout(location = 2) flat in uint fragMaterial;
+layout(location = 3) in vec3 fragViewPosition;
 
 layout(location = 0) out vec4 outColor;
 
+uint light_cluster()
+{
+    float nearPlane = ubo.clusterViewport.z;
+    float farPlane = ubo.clusterViewport.w;
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / ubo.clusterViewport.xy * vec2(clusterCountX, clusterCountY)),
+                     uvec2(clusterCountX - 1u, clusterCountY - 1u));
+    float depth = max(-fragViewPosition.z, nearPlane);
+    uint slice = min(uint(log(depth / nearPlane) / log(farPlane / nearPlane) * float(clusterCountZ)), clusterCountZ - 1u);
+    return (slice * clusterCountY + tile.y) * clusterCountX + tile.x;
+}
+
+// Only the lights assigned to this fragment's cluster are visited. Vertices carry no normal, so the face normal is
+// rebuilt from the screen space derivatives of the view position and turned towards the camera.
+vec3 shade()
+{
+    vec3 lighting = ambient;
+    if(ubo.lightCount == 0u)
+    {
+        return lighting;
+    }
+
+    vec3 normal = normalize(cross(dFdx(fragViewPosition), dFdy(fragViewPosition)));
+    normal = faceforward(normal, fragViewPosition, normal);
+
+    mat4 view = ubo.view * ubo.model;
+    uvec2 range = lightGrid[light_cluster()];
+    for(uint i = 0u; i < range.y; ++i)
+    {
+        PointLight light = lights[lightIndices[range.x + i]];
+        vec3 toLight = (view * vec4(light.positionRadius.xyz, 1.0)).xyz - fragViewPosition;
+        float distanceSquared = dot(toLight, toLight);
+        float radius = light.positionRadius.w;
+
+        // Inverse square falloff windowed to reach zero at the radius the light was culled with.
+        float ratio = distanceSquared / (radius * radius);
+        float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+        float attenuation = window * window / (1.0 + distanceSquared);
+        float diffuse = max(dot(normal, toLight * inversesqrt(max(distanceSquared, 1e-8))), 0.0);
+        lighting += light.color.rgb * diffuse * attenuation;
+    }
+    return lighting;
+}
+
 void main()
 {
-    outColor = vec4(texture(textureSampler, fragTextureCoordinates).rgb, 1.0);
-}
\ No newline at end of file
+    vec3 color = vec3(1.0);
+    if(textured)
+    {
+        // Wrapping happens before the atlas transform; gradients come from the unwrapped coordinates so the seam
+        // does not jump to the coarsest level.
+        MaterialData material = materials[fragMaterial];
+        vec2 coordinates = material.uvTransform.zw + fract(fragTextureCoordinates) * material.uvTransform.xy;
+        vec2 dx = dFdx(fragTextureCoordinates) * material.uvTransform.xy;
+        vec2 dy = dFdy(fragTextureCoordinates) * material.uvTransform.xy;
+        // Shrinking the gradients caps the level where a shared layer's padding runs out.
+        float footprint = max(length(dx), length(dy));
+        if(footprint > material.maxFootprint)
+        {
+            dx *= material.maxFootprint / footprint;
+            dy *= material.maxFootprint / footprint;
+        }
+        color *= textureGrad(textureSampler, vec3(coordinates, float(material.layer)), dx, dy).rgb;
+    }
+    if(vertexColor)
+    {
+        color *= fragColor;
+    }
+    if(lit)
+    {
+        color *= shade();
+    }
+    outColor = vec4(color, 1.0);
+}
@@ -1,21 +1,48 @@
 #version 450
 
+layout(constant_id = 2) const bool quantized = false;
+layout(constant_id = 3) const bool instanced = true;
+
 layout(binding = 0) uniform UniformBufferObject {
     mat4 model;
     mat4 view;
     mat4 projection;
+    vec4 positionScale;
+    vec4 positionOffset;
+    mat4 viewProjection;
 } ubo;
 
+struct ObjectData
+{
+    mat4 model;
+    vec4 boundingSphere;
+    uint firstCluster;
+    uint clusterCount;
+    uint firstDraw;
+    uint material;
+};
+
+layout(std430, binding = 2) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+};
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTextureCoordinates;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTextureCoordinates;
+layout(location = 2) flat out uint fragMaterial;
+layout(location = 3) out vec3 fragViewPosition;
 
 void main()
 {
-    gl_Position = ubo.projection * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    vec3 position = quantized ? inPosition * ubo.positionScale.xyz + ubo.positionOffset.xyz : inPosition;
+    mat4 objectModel = instanced ? objects[gl_InstanceIndex].model : mat4(1.0);
+    vec4 world = objectModel * vec4(position, 1.0);
+    gl_Position = ubo.viewProjection * world;
     fragColor = inColor;
     fragTextureCoordinates = inTextureCoordinates;
+    fragMaterial = instanced ? objects[gl_InstanceIndex].material : 0u;
+    fragViewPosition = (ubo.view * ubo.model * world).xyz;
 }
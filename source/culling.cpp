@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "culling.hpp"
+
+namespace app
+{
+    bool sphere_in_frustum(const std::array<glm::vec4, 6>& planes, const glm::vec3& center, float radius)
+    {
+        return std::ranges::all_of(planes, [&](const glm::vec4& plane) 
+        { 
+            return glm::dot(glm::vec3{plane}, center) + plane.w >= -radius; 
+        });
+    }
+
+    float max_scale(const glm::mat4& transform)
+    {
+        return std::max({glm::length(glm::vec3{transform[0]}), glm::length(glm::vec3{transform[1]}), glm::length(glm::vec3{transform[2]})});
+    }
+
+    BoundingSphere compute_bounding_sphere(std::span<const Vertex> vertices)
+    {
+        if(std::empty(vertices))
+        {
+            return {glm::vec3{0.0f}, 0.0f};
+        }
+
+        glm::vec3 minimum{vertices[0].position};
+        glm::vec3 maximum{vertices[0].position};
+        for(const auto& vertex : vertices)
+        {
+            minimum = glm::min(minimum, vertex.position);
+            maximum = glm::max(maximum, vertex.position);
+        }
+
+        BoundingSphere sphere{(minimum + maximum) * 0.5f, 0.0f};
+        for(const auto& vertex : vertices)
+        {
+            sphere.radius = std::max(sphere.radius, glm::length(vertex.position - sphere.center));
+        }
+        return sphere;
+    }
+
+    std::vector<glm::vec3> layout_object_grid(std::uint32_t count, const BoundingSphere& bounds)
+    {
+        auto side{static_cast<std::uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))))};
+        auto spacing{bounds.radius * 2.2f};
+        auto origin{(static_cast<float>(side) - 1.0f) * 0.5f};
+
+        std::vector<glm::vec3> positions(count);
+        for(std::uint32_t i{0}; i < count; ++i)
+        {
+            positions[i] = {(static_cast<float>(i % side) - origin) * spacing, (static_cast<float>(i / side) - origin) * spacing, 0.0f};
+        }
+        return positions;
+    }
+
+    std::vector<ClusterData> build_clusters(const MeshletSet& set, std::span<const Vertex> vertices)
+    {
+        std::vector<ClusterData> clusters{};
+        clusters.reserve(std::size(set.meshlets));
+        for(const auto& meshlet : set.meshlets)
+        {
+            auto bounds{compute_meshlet_bounds(set, meshlet, vertices)};
+
+            ClusterData cluster{};
+            cluster.boundingSphere = glm::vec4{bounds.center, bounds.radius};
+            cluster.cone = glm::vec4{bounds.coneAxis, bounds.coneCutoff};
+            cluster.firstIndex = meshlet.triangleOffset * 3;
+            cluster.indexCount = meshlet.triangleCount * 3;
+            clusters.push_back(cluster);
+        }
+        return clusters;
+    }
+
+    ClusterData whole_mesh_cluster(std::span<const Vertex> vertices, std::uint32_t indexCount)
+    {
+        auto sphere{compute_bounding_sphere(vertices)};
+
+        ClusterData cluster{};
+        cluster.boundingSphere = glm::vec4{sphere.center, sphere.radius};
+        cluster.cone = glm::vec4{0.0f, 0.0f, 0.0f, 1.0f};
+        cluster.firstIndex = 0;
+        cluster.indexCount = indexCount;
+        return cluster;
+    }
+
+    std::array<glm::vec4, 6> extract_frustum_planes(const glm::mat4& viewProjection)
+    {
+        auto clip{glm::transpose(viewProjection)};
+        std::array<glm::vec4, 6> planes{clip[3] + clip[0], clip[3] - clip[0], 
+                                        clip[3] + clip[1], clip[3] - clip[1], 
+                                        clip[2], clip[3] - clip[2]};
+        for(auto& plane : planes)
+        {
+            plane /= glm::length(glm::vec3{plane});
+        }
+        return planes;
+    }
+
+    std::vector<VkDrawIndexedIndirectCommand> cull_clusters(std::span<const ObjectData> objects, std::span<const ClusterData> clusters, 
+                                                            const UniformBufferObject& ubo, ThreadPool* pool)
+    {
+        auto planes{extract_frustum_planes(ubo.projection * ubo.view)};
+        auto camera{glm::vec3{glm::inverse(ubo.view)[3]}};
+
+        auto cull_range{[&](std::uint32_t firstObject, std::uint32_t lastObject, std::vector<VkDrawIndexedIndirectCommand>& draws)
+        {
+            for(auto objectIndex{firstObject}; objectIndex < lastObject; ++objectIndex)
+            {
+                const auto& object{objects[objectIndex]};
+                auto world{ubo.model * object.model};
+                auto scale{max_scale(world)};
+
+                if(!sphere_in_frustum(planes, glm::vec3{world * glm::vec4{glm::vec3{object.boundingSphere}, 1.0f}}, object.boundingSphere.w * scale))
+                {
+                    continue;
+                }
+
+                for(const auto& cluster : clusters.subspan(object.firstCluster, object.clusterCount))
+                {
+                    auto center{glm::vec3{world * glm::vec4{glm::vec3{cluster.boundingSphere}, 1.0f}}};
+                    auto radius{cluster.boundingSphere.w * scale};
+                    if(!sphere_in_frustum(planes, center, radius))
+                    {
+                        continue;
+                    }
+
+                    if(cluster.cone.w < 1.0f)
+                    {
+                        auto axis{glm::normalize(glm::mat3{world} * glm::vec3{cluster.cone})};
+                        auto toCluster{center - camera};
+                        if(glm::dot(toCluster, axis) >= cluster.cone.w * glm::length(toCluster) + radius)
+                        {
+                            continue;
+                        }
+                    }
+
+                    draws.push_back({cluster.indexCount, 1, cluster.firstIndex, cluster.vertexOffset, objectIndex});
+                }
+            }
+        }};
+
+        auto objectCount{static_cast<std::uint32_t>(std::size(objects))};
+        std::vector<VkDrawIndexedIndirectCommand> draws{};
+        if(pool == nullptr)
+        {
+            cull_range(0, objectCount, draws);
+            return draws;
+        }
+
+        constexpr std::size_t objectsPerChunk{256};
+        std::vector<std::vector<VkDrawIndexedIndirectCommand>> chunks((objectCount + objectsPerChunk - 1) / objectsPerChunk);
+        pool->parallel_for(objectCount, objectsPerChunk, [&](std::size_t begin, std::size_t end)
+        {
+            cull_range(static_cast<std::uint32_t>(begin), static_cast<std::uint32_t>(end), chunks[begin / objectsPerChunk]);
+        });
+
+        for(const auto& chunk : chunks)
+        {
+            draws.insert(std::end(draws), std::begin(chunk), std::end(chunk));
+        }
+        return draws;
+    }
+}
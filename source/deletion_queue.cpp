@@ -0,0 +1,34 @@
+#include "deletion_queue.hpp"
+
+namespace app
+{
+    void DeletionQueue::push(std::uint64_t value, std::move_only_function<void()> deleter)
+    {
+        deleters.emplace_back(value, std::move(deleter));
+    }
+
+    void DeletionQueue::flush(std::uint64_t completedValue)
+    {
+        while(!std::empty(deleters) && deleters.front().first <= completedValue)
+        {
+            auto deleter{std::move(deleters.front().second)};
+            deleters.pop_front();
+            deleter();
+        }
+    }
+
+    void DeletionQueue::flush()
+    {
+        while(!std::empty(deleters))
+        {
+            auto deleter{std::move(deleters.front().second)};
+            deleters.pop_front();
+            deleter();
+        }
+    }
+
+    std::size_t DeletionQueue::size() const
+    {
+        return std::size(deleters);
+    }
+}
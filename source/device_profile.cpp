@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "device_profile.hpp"
+
+namespace app
+{
+    namespace
+    {
+        // Shares of the frame budget that multisampling and texture uploads may take.
+        constexpr double sampleShare{0.25};
+        constexpr double uploadShare{0.1};
+        // Room left in the frame before rendering ahead with mailbox is worth its extra work.
+        constexpr double mailboxShare{0.5};
+
+        constexpr VkDeviceSize minimumStagingBytes{1 << 20};
+        constexpr VkDeviceSize maximumStagingBytes{64 << 20};
+
+        std::uint64_t type_rank(VkPhysicalDeviceType type)
+        {
+            switch(type)
+            {
+                case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+                    return 4;
+                case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+                    return 3;
+                case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+                    return 2;
+                case VK_PHYSICAL_DEVICE_TYPE_CPU:
+                    return 1;
+                default:
+                    return 0;
+            }
+        }
+
+        bool supports(std::span<const VkPresentModeKHR> presentModes, VkPresentModeKHR mode)
+        {
+            return std::ranges::find(presentModes, mode) != std::end(presentModes);
+        }
+
+        std::string to_hex(std::span<const std::uint8_t> bytes)
+        {
+            constexpr std::string_view digits{"0123456789abcdef"};
+            std::string text{};
+            for(auto byte : bytes)
+            {
+                text += digits[byte >> 4];
+                text += digits[byte & 0xf];
+            }
+            return text;
+        }
+
+        bool from_hex(std::string_view text, std::span<std::uint8_t> bytes)
+        {
+            if(std::size(text) != std::size(bytes) * 2)
+            {
+                return false;
+            }
+            for(std::size_t i{0}; i < std::size(bytes); ++i)
+            {
+                auto [end, error]{std::from_chars(std::data(text) + i * 2, std::data(text) + i * 2 + 2, bytes[i], 16)};
+                if(error != std::errc{} || end != std::data(text) + i * 2 + 2)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    std::uint64_t score_device(const DeviceTraits& traits)
+    {
+        constexpr std::uint64_t megabyteLimit{(std::uint64_t{1} << 40) - 1};
+        auto megabytes{std::min<std::uint64_t>(traits.localMemoryBytes >> 20, megabyteLimit)};
+        std::uint64_t features{static_cast<std::uint64_t>(traits.multiDrawIndirect) + traits.drawIndirectCount + traits.timelineSemaphore};
+        return type_rank(traits.type) << 56 | megabytes << 8 | features;
+    }
+
+    DeviceProfile choose_device_profile(const TuningMeasurements& measurements, std::span<const VkPresentModeKHR> presentModes,
+                                        double frameBudgetMilliseconds)
+    {
+        DeviceProfile profile{VK_SAMPLE_COUNT_1_BIT, VK_PRESENT_MODE_FIFO_KHR, minimumStagingBytes};
+
+        double sampleCost{0.0};
+        for(const auto& cost : measurements.sampleCosts)
+        {
+            if(cost.samples >= profile.samples && cost.milliseconds <= frameBudgetMilliseconds * sampleShare)
+            {
+                profile.samples = cost.samples;
+                sampleCost = cost.milliseconds;
+            }
+        }
+
+        auto stagingBytes{static_cast<VkDeviceSize>(measurements.uploadBytesPerMillisecond * frameBudgetMilliseconds * uploadShare)};
+        profile.stagingBytes = std::bit_floor(std::clamp(stagingBytes, minimumStagingBytes, maximumStagingBytes));
+
+        // With room to spare, mailbox renders ahead for lower latency; when frames run close to the budget a late one
+        // should tear rather than wait a whole refresh, which is what relaxed FIFO does.
+        if(sampleCost <= frameBudgetMilliseconds * mailboxShare && supports(presentModes, VK_PRESENT_MODE_MAILBOX_KHR))
+        {
+            profile.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+        }
+        else if(supports(presentModes, VK_PRESENT_MODE_FIFO_RELAXED_KHR))
+        {
+            profile.presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+        }
+        return profile;
+    }
+
+    DeviceProfileCache::DeviceProfileCache(std::filesystem::path path)
+        : path{std::move(path)}
+    {
+        load();
+    }
+
+    std::optional<DeviceProfile> DeviceProfileCache::find(const DeviceProfileKey& key) const
+    {
+        auto entry{std::ranges::find(entries, key, &Entry::key)};
+        if(entry == std::end(entries))
+        {
+            return std::nullopt;
+        }
+        return entry->profile;
+    }
+
+    void DeviceProfileCache::store(const DeviceProfileKey& key, const DeviceProfile& profile)
+    {
+        auto entry{std::ranges::find(entries, key, &Entry::key)};
+        if(entry == std::end(entries))
+        {
+            entries.push_back({key, profile});
+        }
+        else
+        {
+            entry->profile = profile;
+        }
+        save();
+    }
+
+    void DeviceProfileCache::load()
+    {
+        std::ifstream in{path};
+        std::string line{};
+        while(std::getline(in, line))
+        {
+            std::istringstream words{line};
+            std::string uuid{};
+            Entry entry{};
+            std::uint32_t samples{0};
+            std::uint32_t presentMode{0};
+            if(!(words >> uuid >> entry.key.driverVersion >> samples >> presentMode >> entry.profile.stagingBytes) ||
+               !from_hex(uuid, entry.key.deviceUuid) || !std::has_single_bit(samples))
+            {
+                continue;
+            }
+
+            entry.profile.samples = static_cast<VkSampleCountFlagBits>(samples);
+            entry.profile.presentMode = static_cast<VkPresentModeKHR>(presentMode);
+            entries.push_back(entry);
+        }
+    }
+
+    void DeviceProfileCache::save() const
+    {
+        std::ofstream out{path};
+        for(const auto& [key, profile] : entries)
+        {
+            out << to_hex(key.deviceUuid) << ' ' << key.driverVersion << ' ' << static_cast<std::uint32_t>(profile.samples) << ' '
+                << static_cast<std::uint32_t>(profile.presentMode) << ' ' << profile.stagingBytes << '\n';
+        }
+
+        if(!out)
+        {
+            throw std::runtime_error{"Error: failed to write device profiles to " + path.string() + "."};
+        }
+    }
+}
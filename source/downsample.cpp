@@ -0,0 +1,52 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "downsample.hpp"
+
+namespace app
+{
+    namespace
+    {
+        constexpr VkDeviceSize scratchHeaderBytes{16};
+        constexpr VkDeviceSize scratchTexelBytes{16};
+        constexpr VkDeviceSize planeEntries{downsampleTileSize * downsampleTileSize};
+
+        std::uint32_t rounded_up(std::uint32_t size, std::uint32_t level)
+        {
+            return std::max((size + (1u << level) - 1) >> level, 1u);
+        }
+
+        std::uint32_t rounded_down(std::uint32_t size, std::uint32_t level)
+        {
+            return std::max(size >> level, 1u);
+        }
+    }
+
+    DownsampleConstants downsample_constants(VkExtent2D source, std::uint32_t levelCount, bool includeSource)
+    {
+        auto maxSide{downsampleTileSize << (maxDownsampleLevels / 2)};
+        if(levelCount == 0 || levelCount > maxDownsampleLevels || source.width > maxSide || source.height > maxSide)
+        {
+            throw std::invalid_argument{"Error: mip chain is out of range for single pass downsampling."};
+        }
+
+        auto tilesX{(source.width + downsampleTileSize - 1) / downsampleTileSize};
+        auto tilesY{(source.height + downsampleTileSize - 1) / downsampleTileSize};
+        return {source.width, source.height, levelCount, includeSource ? 1u : 0u, tilesX * tilesY};
+    }
+
+    VkDeviceSize downsample_scratch_bytes(VkExtent2D source, std::uint32_t levelCount)
+    {
+        // Mirrors band_entries() in downsample.comp.
+        VkDeviceSize entries{planeEntries};
+        for(std::uint32_t level{1}; level <= levelCount; ++level)
+        {
+            auto width{rounded_up(source.width, level)};
+            auto height{rounded_up(source.height, level)};
+            auto bandColumns{width - rounded_down(source.width, level) + 1};
+            auto bandRows{height - rounded_down(source.height, level) + 1};
+            entries += static_cast<VkDeviceSize>(bandColumns) * height + static_cast<VkDeviceSize>(bandRows) * width;
+        }
+        return scratchHeaderBytes + entries * scratchTexelBytes;
+    }
+}
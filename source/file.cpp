@@ -1,6 +1,9 @@
 #include <stdexcept>
 #include <fstream>
 
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
 #include "utils.hpp"
 #include "file.hpp"
 
@@ -24,4 +27,25 @@ namespace file
         in.close();
         return buffer;
     }
+
+    void write_png(const std::filesystem::path& filename, std::uint32_t width, std::uint32_t height, const void* pixels)
+    {
+        auto path{filename.string()};
+        if(stbi_write_png(std::data(path), static_cast<int>(width), static_cast<int>(height), 4, pixels, 
+                          static_cast<int>(width * 4)) == 0)
+        {
+            throw std::runtime_error{"Error: failed to write image " + path + "."};
+        }
+    }
+
+    void write_raw(const std::filesystem::path& filename, const void* data, std::size_t size)
+    {
+        std::ofstream out{filename, std::ios::binary};
+        out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+
+        if(!out)
+        {
+            throw std::runtime_error{"Error: failed to write image " + filename.string() + "."};
+        }
+    }
 }
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__linux__)
+    #include <sys/inotify.h>
+    #include <unistd.h>
+#endif
+
+#include "file_watcher.hpp"
+
+namespace app
+{
+    #if defined(__linux__)
+        FileWatcher::FileWatcher(std::vector<std::filesystem::path> directories)
+            : directories{std::move(directories)}, descriptor{inotify_init1(IN_NONBLOCK | IN_CLOEXEC)}
+        {
+            if(descriptor < 0)
+            {
+                throw std::runtime_error{"Error: failed to create file watcher."};
+            }
+
+            // Close-write and moved-to cover both editors that write in place and those that save through a rename.
+            for(const auto& directory : this->directories)
+            {
+                auto watch{inotify_add_watch(descriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO)};
+                if(watch < 0)
+                {
+                    close(descriptor);
+                    throw std::runtime_error{"Error: failed to watch " + directory.string() + "."};
+                }
+                watches[watch] = directory;
+            }
+        }
+
+        FileWatcher::~FileWatcher()
+        {
+            close(descriptor);
+        }
+
+        std::vector<std::filesystem::path> FileWatcher::poll()
+        {
+            std::vector<std::filesystem::path> changed{};
+            alignas(inotify_event) char buffer[4096];
+            while(true)
+            {
+                auto length{read(descriptor, buffer, sizeof(buffer))};
+                if(length <= 0)
+                {
+                    return changed;
+                }
+
+                for(ssize_t offset{0}; offset < length; )
+                {
+                    const auto* event{reinterpret_cast<const inotify_event*>(buffer + offset)};
+                    offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+                    if(event->len == 0)
+                    {
+                        continue;
+                    }
+
+                    auto path{watches[event->wd] / event->name};
+                    if(std::ranges::find(changed, path) == std::end(changed))
+                    {
+                        changed.push_back(std::move(path));
+                    }
+                }
+            }
+        }
+    #else
+        FileWatcher::FileWatcher(std::vector<std::filesystem::path> directories)
+            : directories{std::move(directories)}
+        {
+            // The first scan only records the current write times.
+            poll();
+        }
+
+        FileWatcher::~FileWatcher() = default;
+
+        std::vector<std::filesystem::path> FileWatcher::poll()
+        {
+            std::vector<std::filesystem::path> changed{};
+            auto now{std::chrono::steady_clock::now()};
+            if(now - lastScan < std::chrono::milliseconds{500})
+            {
+                return changed;
+            }
+            lastScan = now;
+
+            for(const auto& directory : directories)
+            {
+                std::error_code error{};
+                for(const auto& entry : std::filesystem::directory_iterator{directory, error})
+                {
+                    auto writeTime{entry.last_write_time(error)};
+                    if(error || !entry.is_regular_file(error))
+                    {
+                        continue;
+                    }
+
+                    auto [known, inserted]{writeTimes.try_emplace(entry.path(), writeTime)};
+                    if(inserted || known->second != writeTime)
+                    {
+                        known->second = writeTime;
+                        changed.push_back(entry.path());
+                    }
+                }
+            }
+            return changed;
+        }
+    #endif
+}
@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+#include "frame_arena.hpp"
+
+namespace
+{
+    thread_local std::uint64_t heapAllocations{0};
+
+    void* allocate(std::size_t bytes)
+    {
+        ++heapAllocations;
+        if(auto* pointer{std::malloc(bytes == 0 ? 1 : bytes)})
+        {
+            return pointer;
+        }
+        throw std::bad_alloc{};
+    }
+
+    void* allocate_aligned(std::size_t bytes, std::align_val_t alignment)
+    {
+        ++heapAllocations;
+        auto align{static_cast<std::size_t>(alignment)};
+        bytes = (std::max<std::size_t>(bytes, 1) + align - 1) / align * align;
+        #if defined(_WIN32)
+            auto* pointer{_aligned_malloc(bytes, align)};
+        #else
+            auto* pointer{std::aligned_alloc(align, bytes)};
+        #endif
+        if(pointer == nullptr)
+        {
+            throw std::bad_alloc{};
+        }
+        return pointer;
+    }
+
+    void free_aligned(void* pointer)
+    {
+        #if defined(_WIN32)
+            _aligned_free(pointer);
+        #else
+            std::free(pointer);
+        #endif
+    }
+}
+
+// Replacing the global allocation functions is the only way to see every allocation the standard containers make.
+void* operator new(std::size_t bytes)
+{
+    return allocate(bytes);
+}
+
+void* operator new(std::size_t bytes, std::align_val_t alignment)
+{
+    return allocate_aligned(bytes, alignment);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    free_aligned(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept
+{
+    free_aligned(pointer);
+}
+
+namespace app
+{
+    std::uint64_t thread_heap_allocations()
+    {
+        return heapAllocations;
+    }
+
+    FrameArena::FrameArena(std::size_t capacity)
+        : block(capacity)
+    {
+    }
+
+    FrameArena::~FrameArena()
+    {
+        release_overflow();
+    }
+
+    void FrameArena::reset()
+    {
+        // Grow once to cover the busiest frame seen so far rather than borrowing from the heap every frame.
+        if(overflowBytes > 0)
+        {
+            auto grown{std::size(block) + overflowBytes};
+            release_overflow();
+            block = std::vector<std::byte>(std::max(grown, std::size(block) * 2));
+        }
+        offset = 0;
+    }
+
+    std::size_t FrameArena::used() const
+    {
+        return offset + overflowBytes;
+    }
+
+    std::size_t FrameArena::capacity() const
+    {
+        return std::size(block);
+    }
+
+    void* FrameArena::do_allocate(std::size_t bytes, std::size_t alignment)
+    {
+        void* pointer{std::data(block) + offset};
+        auto space{std::size(block) - offset};
+        if(std::align(alignment, bytes, pointer, space))
+        {
+            offset = static_cast<std::size_t>(static_cast<std::byte*>(pointer) - std::data(block)) + bytes;
+            return pointer;
+        }
+
+        pointer = ::operator new(bytes, std::align_val_t{alignment});
+        overflow.push_back({pointer, bytes, alignment});
+        overflowBytes += bytes;
+        return pointer;
+    }
+
+    void FrameArena::do_deallocate(void*, std::size_t, std::size_t)
+    {
+    }
+
+    bool FrameArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+    {
+        return this == &other;
+    }
+
+    void FrameArena::release_overflow()
+    {
+        for(const auto& allocation : overflow)
+        {
+            ::operator delete(allocation.pointer, allocation.bytes, std::align_val_t{allocation.alignment});
+        }
+        overflow.clear();
+        overflowBytes = 0;
+    }
+}
@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <print>
+
+#include "host_allocator.hpp"
+#include "resource.hpp"
+
+namespace app
+{
+    namespace
+    {
+        constexpr std::size_t scopeCount{VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1};
+
+        // Pooled blocks are carved with a fixed alignment and header space so any of them can serve any request
+        // of their size class.
+        constexpr std::size_t poolAlignment{64};
+        constexpr std::size_t smallestPooledBytes{64};
+        constexpr std::size_t sizeClassCount{7};
+        constexpr std::uint32_t unpooled{sizeClassCount};
+
+        struct Tag
+        {
+            VkAllocationCallbacks callbacks;
+            VkObjectType objectType;
+            std::array<MemoryCounter, scopeCount> scopes;
+            std::array<std::atomic<std::uint64_t>, scopeCount> allocations;
+        };
+
+        // Sits right before every pointer handed to the driver, since the free callback only gets the pointer back.
+        struct Header
+        {
+            Tag* tag;
+            std::size_t size;
+            std::size_t offset;
+            VkSystemAllocationScope scope;
+            std::uint32_t sizeClass;
+        };
+
+        struct State
+        {
+            std::atomic<bool> enabled{false};
+            bool poolCommandScope{false};
+            std::mutex mutex;
+            std::map<VkObjectType, std::unique_ptr<Tag>> tags;
+            MemoryCounter total;
+            MemoryCounter internal;
+            std::atomic<std::uint64_t> allocations{0};
+            std::atomic<std::uint64_t> pooledAllocations{0};
+        };
+
+        State& state()
+        {
+            static State instance{};
+            return instance;
+        }
+
+        struct CommandPool
+        {
+            CommandPool() = default;
+            CommandPool(const CommandPool&) = delete;
+            CommandPool& operator=(const CommandPool&) = delete;
+
+            ~CommandPool()
+            {
+                for(auto& blocks : freeBlocks)
+                {
+                    for(auto* block : blocks)
+                    {
+                        free_block(block);
+                    }
+                }
+            }
+
+            static void free_block(void* block)
+            {
+                #if defined(_WIN32)
+                    _aligned_free(block);
+                #else
+                    std::free(block);
+                #endif
+            }
+
+            std::array<std::vector<void*>, sizeClassCount> freeBlocks;
+        };
+
+        // Command-scope allocations are freed before the call that made them returns, so the freeing thread is the
+        // allocating one and a per-thread pool needs no locking.
+        thread_local CommandPool commandPool{};
+
+        void* allocate_block(std::size_t alignment, std::size_t bytes)
+        {
+            bytes = (bytes + alignment - 1) / alignment * alignment;
+            #if defined(_WIN32)
+                return _aligned_malloc(bytes, alignment);
+            #else
+                return std::aligned_alloc(alignment, bytes);
+            #endif
+        }
+
+        std::uint32_t size_class(std::size_t size, std::size_t alignment)
+        {
+            if(alignment > poolAlignment)
+            {
+                return unpooled;
+            }
+            for(std::uint32_t sizeClass{0}; sizeClass < sizeClassCount; ++sizeClass)
+            {
+                if(size <= smallestPooledBytes << sizeClass)
+                {
+                    return sizeClass;
+                }
+            }
+            return unpooled;
+        }
+
+        Header* header(void* memory)
+        {
+            return reinterpret_cast<Header*>(static_cast<std::byte*>(memory) - sizeof(Header));
+        }
+
+        void* VKAPI_PTR allocate(void* userData, std::size_t size, std::size_t alignment, VkSystemAllocationScope scope)
+        {
+            auto* tag{static_cast<Tag*>(userData)};
+            auto& tracking{state()};
+            alignment = std::max(alignment, alignof(Header));
+
+            auto sizeClass{unpooled};
+            std::size_t offset{(sizeof(Header) + alignment - 1) / alignment * alignment};
+            void* block{nullptr};
+            if(tracking.poolCommandScope && scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND)
+            {
+                sizeClass = size_class(size, alignment);
+            }
+
+            if(sizeClass != unpooled)
+            {
+                offset = poolAlignment;
+                auto& blocks{commandPool.freeBlocks[sizeClass]};
+                if(!std::empty(blocks))
+                {
+                    block = blocks.back();
+                    blocks.pop_back();
+                    tracking.pooledAllocations.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                {
+                    block = allocate_block(poolAlignment, offset + (smallestPooledBytes << sizeClass));
+                }
+            }
+            else
+            {
+                block = allocate_block(alignment, offset + size);
+            }
+
+            if(block == nullptr)
+            {
+                return nullptr;
+            }
+
+            auto* memory{static_cast<std::byte*>(block) + offset};
+            *header(memory) = Header{tag, size, offset, scope, sizeClass};
+            tag->scopes[scope].add(size);
+            tag->allocations[scope].fetch_add(1, std::memory_order_relaxed);
+            tracking.total.add(size);
+            tracking.allocations.fetch_add(1, std::memory_order_relaxed);
+            return memory;
+        }
+
+        void VKAPI_PTR deallocate(void*, void* memory)
+        {
+            if(memory == nullptr)
+            {
+                return;
+            }
+
+            auto [tag, size, offset, scope, sizeClass]{*header(memory)};
+            tag->scopes[scope].remove(size);
+            state().total.remove(size);
+
+            auto* block{static_cast<std::byte*>(memory) - offset};
+            if(sizeClass != unpooled)
+            {
+                commandPool.freeBlocks[sizeClass].push_back(block);
+            }
+            else
+            {
+                CommandPool::free_block(block);
+            }
+        }
+
+        void* VKAPI_PTR reallocate(void* userData, void* original, std::size_t size, std::size_t alignment, VkSystemAllocationScope scope)
+        {
+            if(original == nullptr)
+            {
+                return allocate(userData, size, alignment, scope);
+            }
+            if(size == 0)
+            {
+                deallocate(userData, original);
+                return nullptr;
+            }
+
+            // On failure the original allocation has to stay valid, so it is only freed once the copy exists.
+            auto* memory{allocate(userData, size, alignment, scope)};
+            if(memory != nullptr)
+            {
+                std::memcpy(memory, original, std::min(size, header(original)->size));
+                deallocate(userData, original);
+            }
+            return memory;
+        }
+
+        void VKAPI_PTR internal_allocation(void*, std::size_t size, VkInternalAllocationType, VkSystemAllocationScope)
+        {
+            state().internal.add(size);
+        }
+
+        void VKAPI_PTR internal_free(void*, std::size_t size, VkInternalAllocationType, VkSystemAllocationScope)
+        {
+            state().internal.remove(size);
+        }
+
+        std::string_view object_type_name(VkObjectType objectType)
+        {
+            switch(objectType)
+            {
+                case VK_OBJECT_TYPE_INSTANCE: return "instance";
+                case VK_OBJECT_TYPE_DEVICE: return "device";
+                case VK_OBJECT_TYPE_SEMAPHORE: return "semaphore";
+                case VK_OBJECT_TYPE_FENCE: return "fence";
+                case VK_OBJECT_TYPE_DEVICE_MEMORY: return "deviceMemory";
+                case VK_OBJECT_TYPE_BUFFER: return "buffer";
+                case VK_OBJECT_TYPE_IMAGE: return "image";
+                case VK_OBJECT_TYPE_QUERY_POOL: return "queryPool";
+                case VK_OBJECT_TYPE_IMAGE_VIEW: return "imageView";
+                case VK_OBJECT_TYPE_SHADER_MODULE: return "shaderModule";
+                case VK_OBJECT_TYPE_PIPELINE_LAYOUT: return "pipelineLayout";
+                case VK_OBJECT_TYPE_RENDER_PASS: return "renderPass";
+                case VK_OBJECT_TYPE_PIPELINE: return "pipeline";
+                case VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT: return "descriptorSetLayout";
+                case VK_OBJECT_TYPE_SAMPLER: return "sampler";
+                case VK_OBJECT_TYPE_DESCRIPTOR_POOL: return "descriptorPool";
+                case VK_OBJECT_TYPE_FRAMEBUFFER: return "framebuffer";
+                case VK_OBJECT_TYPE_COMMAND_POOL: return "commandPool";
+                case VK_OBJECT_TYPE_SURFACE_KHR: return "surface";
+                case VK_OBJECT_TYPE_SWAPCHAIN_KHR: return "swapchain";
+                case VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT: return "debugMessenger";
+                default: return "other";
+            }
+        }
+
+        std::string_view scope_name(std::size_t scope)
+        {
+            constexpr std::array<std::string_view, scopeCount> names{"command", "object", "cache", "device", "instance"};
+            return names[scope];
+        }
+    }
+
+    void enable_host_allocation_tracking(bool poolCommandScope)
+    {
+        auto& tracking{state()};
+        std::lock_guard lock{tracking.mutex};
+        tracking.poolCommandScope = tracking.poolCommandScope || poolCommandScope;
+        tracking.enabled.store(true, std::memory_order_release);
+    }
+
+    bool host_allocation_tracking_enabled()
+    {
+        return state().enabled.load(std::memory_order_acquire);
+    }
+
+    const VkAllocationCallbacks* host_allocator(VkObjectType objectType)
+    {
+        auto& tracking{state()};
+        if(!tracking.enabled.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+
+        std::lock_guard lock{tracking.mutex};
+        auto& tag{tracking.tags[objectType]};
+        if(!tag)
+        {
+            tag = std::make_unique<Tag>();
+            tag->objectType = objectType;
+            tag->callbacks = VkAllocationCallbacks{tag.get(), &allocate, &reallocate, &deallocate, &internal_allocation, &internal_free};
+        }
+        return &tag->callbacks;
+    }
+
+    std::vector<HostAllocationUsage> host_allocation_usage()
+    {
+        auto& tracking{state()};
+        std::lock_guard lock{tracking.mutex};
+
+        std::vector<HostAllocationUsage> usage{};
+        for(const auto& [objectType, tag] : tracking.tags)
+        {
+            for(std::size_t scope{0}; scope < scopeCount; ++scope)
+            {
+                auto allocations{tag->allocations[scope].load(std::memory_order_relaxed)};
+                if(allocations == 0)
+                {
+                    continue;
+                }
+                usage.push_back({object_type_name(objectType), scope_name(scope), tag->scopes[scope].bytes(),
+                                 tag->scopes[scope].peak_bytes(), allocations});
+            }
+        }
+        return usage;
+    }
+
+    HostAllocationTotals host_allocation_totals()
+    {
+        const auto& tracking{state()};
+        return {tracking.total.bytes(), tracking.total.peak_bytes(), tracking.internal.bytes(),
+                tracking.allocations.load(std::memory_order_relaxed), tracking.pooledAllocations.load(std::memory_order_relaxed)};
+    }
+
+    void write_host_allocation_report(std::ostream& out)
+    {
+        auto totals{host_allocation_totals()};
+        std::println(out, "Driver host allocations:");
+        for(const auto& entry : host_allocation_usage())
+        {
+            std::println(out, "\t{:<20} {:<9} live {:>10} B  peak {:>10} B  allocations {:>8}", entry.objectType, entry.scope,
+                         entry.bytes, entry.peakBytes, entry.allocations);
+        }
+        std::println(out, "\t{:<30} live {:>10} B  peak {:>10} B  allocations {:>8}", "total", totals.bytes, totals.peakBytes, totals.allocations);
+        std::println(out, "\t{:<30} live {:>10} B", "driver internal", totals.internalBytes);
+        std::println(out, "\t{:<30} {:>10}", "pooled command allocations", totals.pooledAllocations);
+    }
+}
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include "lighting.hpp"
+
+namespace app
+{
+    namespace
+    {
+        // Lights cover a tenth to a third of the scene's radius, the range where clustering pays off over a single list.
+        constexpr float minimumLightRadius{0.1f};
+        constexpr float maximumLightRadius{0.3f};
+
+        float slice_depth(std::uint32_t slice, float nearPlane, float farPlane)
+        {
+            return nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(slice) / static_cast<float>(lightClusterCountZ));
+        }
+    }
+
+    std::uint32_t light_cluster_slice(float viewDepth, float nearPlane, float farPlane)
+    {
+        auto slice{std::log(std::max(viewDepth, nearPlane) / nearPlane) / std::log(farPlane / nearPlane) * lightClusterCountZ};
+        return std::min(static_cast<std::uint32_t>(slice), lightClusterCountZ - 1);
+    }
+
+    LightClusterBounds light_cluster_bounds(std::uint32_t cluster, const glm::mat4& inverseProjection, float nearPlane, float farPlane)
+    {
+        glm::uvec3 cell{cluster % lightClusterCountX, cluster / lightClusterCountX % lightClusterCountY,
+                        cluster / (lightClusterCountX * lightClusterCountY)};
+        glm::vec2 tiles{static_cast<float>(lightClusterCountX), static_cast<float>(lightClusterCountY)};
+        auto tileMinimum{glm::vec2{cell} / tiles * 2.0f - 1.0f};
+        auto tileMaximum{(glm::vec2{cell} + 1.0f) / tiles * 2.0f - 1.0f};
+        auto sliceNear{slice_depth(cell.z, nearPlane, farPlane)};
+        auto sliceFar{slice_depth(cell.z + 1, nearPlane, farPlane)};
+
+        LightClusterBounds bounds{glm::vec3{std::numeric_limits<float>::max()}, glm::vec3{std::numeric_limits<float>::lowest()}};
+        for(std::uint32_t corner{0}; corner < 4; ++corner)
+        {
+            // Any depth on the ray through the tile corner will do, the corner is then moved onto both slice planes.
+            glm::vec2 ndc{corner & 1 ? tileMaximum.x : tileMinimum.x, corner & 2 ? tileMaximum.y : tileMinimum.y};
+            auto point{inverseProjection * glm::vec4{ndc, 0.5f, 1.0f}};
+            auto ray{glm::vec3{point} / point.w};
+            auto nearCorner{ray * (sliceNear / -ray.z)};
+            auto farCorner{ray * (sliceFar / -ray.z)};
+            bounds.minimum = glm::min(bounds.minimum, glm::min(nearCorner, farCorner));
+            bounds.maximum = glm::max(bounds.maximum, glm::max(nearCorner, farCorner));
+        }
+        return bounds;
+    }
+
+    bool sphere_touches_box(const glm::vec3& center, float radius, const LightClusterBounds& bounds)
+    {
+        auto offset{center - glm::clamp(center, bounds.minimum, bounds.maximum)};
+        return glm::dot(offset, offset) <= radius * radius;
+    }
+
+    std::vector<PointLight> generate_lights(std::uint32_t count, const BoundingSphere& bounds, std::uint32_t seed)
+    {
+        std::mt19937 generator{seed};
+        std::uniform_real_distribution<float> unit{-1.0f, 1.0f};
+        std::uniform_real_distribution<float> radius{minimumLightRadius * bounds.radius, maximumLightRadius * bounds.radius};
+        std::uniform_real_distribution<float> channel{0.2f, 1.0f};
+
+        std::vector<PointLight> lights(count);
+        for(auto& light : lights)
+        {
+            glm::vec3 offset{};
+            do
+            {
+                offset = {unit(generator), unit(generator), unit(generator)};
+            } while(glm::dot(offset, offset) > 1.0f);
+
+            light.positionRadius = glm::vec4{bounds.center + offset * bounds.radius, radius(generator)};
+            light.color = glm::vec4{channel(generator), channel(generator), channel(generator), 1.0f};
+        }
+        return lights;
+    }
+
+    LightAssignment assign_lights(std::span<const PointLight> lights, const UniformBufferObject& ubo)
+    {
+        auto view{ubo.view * ubo.model};
+        std::vector<glm::vec4> viewLights(std::size(lights));
+        std::ranges::transform(lights, std::begin(viewLights), [&](const PointLight& light)
+        {
+            return glm::vec4{glm::vec3{view * glm::vec4{glm::vec3{light.positionRadius}, 1.0f}}, light.positionRadius.w};
+        });
+
+        auto nearPlane{ubo.clusterViewport.z};
+        auto farPlane{ubo.clusterViewport.w};
+        LightAssignment assignment{std::vector<glm::uvec2>(lightClusterCount), {}, 0};
+        std::vector<std::uint32_t> clusterLights{};
+        for(std::uint32_t cluster{0}; cluster < lightClusterCount; ++cluster)
+        {
+            auto bounds{light_cluster_bounds(cluster, ubo.inverseProjection, nearPlane, farPlane)};
+            clusterLights.clear();
+            for(std::uint32_t i{0}; i < static_cast<std::uint32_t>(std::size(viewLights)); ++i)
+            {
+                if(sphere_touches_box(glm::vec3{viewLights[i]}, viewLights[i].w, bounds))
+                {
+                    clusterLights.push_back(i);
+                }
+            }
+
+            auto offset{static_cast<std::uint32_t>(std::size(assignment.indices))};
+            auto count{std::min({static_cast<std::uint32_t>(std::size(clusterLights)), maxClusterLights, lightIndexCapacity - offset})};
+            assignment.ranges[cluster] = {offset, count};
+            assignment.indices.insert(std::end(assignment.indices), std::begin(clusterLights), std::begin(clusterLights) + count);
+            assignment.droppedLights += static_cast<std::uint32_t>(std::size(clusterLights)) - count;
+        }
+        return assignment;
+    }
+}
@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <print>
+#include <ranges>
+
+#include "memory_registry.hpp"
+
+namespace app
+{
+    std::string_view to_string(MemoryCategory category)
+    {
+        constexpr std::array<std::string_view, static_cast<std::size_t>(MemoryCategory::count)> names
+        {
+            "vertex", "index", "uniform", "storage", "indirect", "texture", "depth", "color", "staging", "readback"
+        };
+        return names[static_cast<std::size_t>(category)];
+    }
+
+    void MemoryRegistry::Total::add(VkDeviceSize size)
+    {
+        bytes += size;
+        peakBytes = std::max(peakBytes, bytes);
+        ++allocations;
+    }
+
+    MemoryRegistry::~MemoryRegistry()
+    {
+        for(const auto& [id, record] : records)
+        {
+            std::println(std::cerr, "Warning: leaked {} bytes of {} memory \"{}\".", record.size, to_string(record.category), record.name);
+        }
+
+        if(!exitReportPath.empty())
+        {
+            std::ofstream out{exitReportPath};
+            if(out.is_open())
+            {
+                write_json(out);
+            }
+            else
+            {
+                std::println(std::cerr, "Error: failed to open memory report {}.", exitReportPath.string());
+            }
+        }
+    }
+
+    void MemoryRegistry::set_heaps(std::span<const VkMemoryHeap> memoryHeaps)
+    {
+        std::lock_guard lock{mutex};
+        heaps.assign(std::begin(memoryHeaps), std::end(memoryHeaps));
+        heapTotals.resize(std::size(heaps));
+    }
+
+    void MemoryRegistry::set_exit_report(std::filesystem::path path)
+    {
+        std::lock_guard lock{mutex};
+        exitReportPath = std::move(path);
+    }
+
+    MemoryRegistry::Id MemoryRegistry::add(MemoryCategory category, std::string name, std::uint32_t heap, VkDeviceSize size)
+    {
+        std::lock_guard lock{mutex};
+        if(heap >= std::size(heapTotals))
+        {
+            heapTotals.resize(heap + 1);
+        }
+        heapTotals[heap].add(size);
+        categoryTotals[static_cast<std::size_t>(category)].add(size);
+        total.add(size);
+
+        auto id{nextId++};
+        records.emplace(id, Record{category, std::move(name), heap, size});
+        return id;
+    }
+
+    void MemoryRegistry::remove(Id id)
+    {
+        std::lock_guard lock{mutex};
+        auto found{records.find(id)};
+        if(found == std::end(records))
+        {
+            return;
+        }
+
+        const auto& record{found->second};
+        heapTotals[record.heap].bytes -= record.size;
+        categoryTotals[static_cast<std::size_t>(record.category)].bytes -= record.size;
+        total.bytes -= record.size;
+        records.erase(found);
+    }
+
+    VkDeviceSize MemoryRegistry::bytes(MemoryCategory category) const
+    {
+        std::lock_guard lock{mutex};
+        return categoryTotals[static_cast<std::size_t>(category)].bytes;
+    }
+
+    VkDeviceSize MemoryRegistry::peak_bytes(MemoryCategory category) const
+    {
+        std::lock_guard lock{mutex};
+        return categoryTotals[static_cast<std::size_t>(category)].peakBytes;
+    }
+
+    void MemoryRegistry::write_json(std::ostream& out) const
+    {
+        std::lock_guard lock{mutex};
+
+        std::println(out, "{{");
+        std::println(out, "  \"bytes\": {},", total.bytes);
+        std::println(out, "  \"peakBytes\": {},", total.peakBytes);
+        std::println(out, "  \"allocations\": {},", total.allocations);
+
+        std::println(out, "  \"heaps\": [");
+        for(const auto& [i, heapTotal] : heapTotals | std::views::enumerate)
+        {
+            auto size{i < std::ssize(heaps) ? heaps[i].size : 0};
+            auto deviceLocal{i < std::ssize(heaps) && (heaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0};
+            std::println(out, "    {{\"index\": {}, \"deviceLocal\": {}, \"size\": {}, \"bytes\": {}, \"peakBytes\": {}, \"allocations\": {}}}{}",
+                         i, deviceLocal, size, heapTotal.bytes, heapTotal.peakBytes, heapTotal.allocations,
+                         i + 1 < std::ssize(heapTotals) ? "," : "");
+        }
+        std::println(out, "  ],");
+
+        std::println(out, "  \"categories\": {{");
+        for(const auto& [i, categoryTotal] : categoryTotals | std::views::enumerate)
+        {
+            std::println(out, "    \"{}\": {{\"bytes\": {}, \"peakBytes\": {}, \"allocations\": {}}}{}",
+                         to_string(static_cast<MemoryCategory>(i)), categoryTotal.bytes, categoryTotal.peakBytes, categoryTotal.allocations,
+                         i + 1 < std::ssize(categoryTotals) ? "," : "");
+        }
+        std::println(out, "  }},");
+
+        // Largest first, so the answer to where the memory went is at the top.
+        auto live{records | std::views::values | std::views::transform([](const Record& record) { return &record; }) | std::ranges::to<std::vector>()};
+        std::ranges::sort(live, std::ranges::greater{}, &Record::size);
+
+        std::println(out, "  \"live\": [");
+        for(const auto& [i, record] : live | std::views::enumerate)
+        {
+            std::println(out, "    {{\"name\": \"{}\", \"category\": \"{}\", \"heap\": {}, \"bytes\": {}}}{}", record->name,
+                         to_string(record->category), record->heap, record->size, i + 1 < std::ssize(live) ? "," : "");
+        }
+        std::println(out, "  ]");
+        std::println(out, "}}");
+    }
+}
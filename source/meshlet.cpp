@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "meshlet.hpp"
+#include "culling.hpp"
+
+namespace app
+{
+    MeshletSet build_meshlets(std::span<const std::uint32_t> indices, std::size_t vertexCount, 
+                              std::size_t maxVertices, std::size_t maxTriangles)
+    {
+        if(maxVertices < 3 || maxVertices > std::numeric_limits<std::uint8_t>::max() || maxTriangles == 0)
+        {
+            throw std::invalid_argument{"Error: invalid meshlet limits."};
+        }
+
+        constexpr std::uint8_t unused{std::numeric_limits<std::uint8_t>::max()};
+        std::vector<std::uint8_t> localIndices(vertexCount, unused);
+
+        MeshletSet set{};
+        Meshlet current{0, 0, 0, 0};
+
+        auto flush{[&]
+        {
+            for(const auto vertex : std::span{set.vertices}.subspan(current.vertexOffset))
+            {
+                localIndices[vertex] = unused;
+            }
+            set.meshlets.push_back(current);
+            current = {static_cast<std::uint32_t>(std::size(set.vertices)), 0, 
+                       static_cast<std::uint32_t>(std::size(set.triangles) / 3), 0};
+        }};
+
+        for(std::size_t i{0}; i + 2 < std::size(indices); i += 3)
+        {
+            auto triangle{indices.subspan(i, 3)};
+            auto newVertices{std::ranges::count_if(triangle, [&](std::uint32_t vertex) { return localIndices[vertex] == unused; })};
+
+            if(current.vertexCount + newVertices > maxVertices || current.triangleCount + 1 > maxTriangles)
+            {
+                flush();
+            }
+
+            for(const auto vertex : triangle)
+            {
+                if(localIndices[vertex] == unused)
+                {
+                    localIndices[vertex] = static_cast<std::uint8_t>(current.vertexCount++);
+                    set.vertices.push_back(vertex);
+                }
+                set.triangles.push_back(localIndices[vertex]);
+            }
+            ++current.triangleCount;
+        }
+
+        if(current.triangleCount > 0)
+        {
+            flush();
+        }
+
+        return set;
+    }
+
+    MeshletBounds compute_meshlet_bounds(const MeshletSet& set, const Meshlet& meshlet, std::span<const Vertex> vertices)
+    {
+        auto meshletVertices{std::span{set.vertices}.subspan(meshlet.vertexOffset, meshlet.vertexCount)};
+        auto meshletTriangles{std::span{set.triangles}.subspan(meshlet.triangleOffset * 3, meshlet.triangleCount * 3)};
+
+        std::vector<Vertex> positions{};
+        positions.reserve(std::size(meshletVertices));
+        for(const auto vertex : meshletVertices)
+        {
+            positions.push_back(vertices[vertex]);
+        }
+
+        auto sphere{compute_bounding_sphere(positions)};
+        MeshletBounds bounds{sphere.center, sphere.radius, glm::vec3{0.0f}, 1.0f};
+
+        std::vector<glm::vec3> normals{};
+        normals.reserve(meshlet.triangleCount);
+        for(std::size_t i{0}; i < std::size(meshletTriangles); i += 3)
+        {
+            auto& a{positions[meshletTriangles[i + 0]].position};
+            auto& b{positions[meshletTriangles[i + 1]].position};
+            auto& c{positions[meshletTriangles[i + 2]].position};
+
+            auto normal{glm::cross(b - a, c - a)};
+            auto length{glm::length(normal)};
+            if(length > 0.0f)
+            {
+                normals.push_back(normal / length);
+                bounds.coneAxis += normals.back();
+            }
+        }
+
+        auto axisLength{glm::length(bounds.coneAxis)};
+        if(axisLength == 0.0f)
+        {
+            return bounds;
+        }
+        bounds.coneAxis /= axisLength;
+
+        auto minimumDot{1.0f};
+        for(const auto& normal : normals)
+        {
+            minimumDot = std::min(minimumDot, glm::dot(bounds.coneAxis, normal));
+        }
+
+        // A cutoff of 1 never passes the backface test, which is what clusters with widely spread normals need.
+        if(minimumDot > 0.1f)
+        {
+            bounds.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+        }
+        return bounds;
+    }
+
+    std::vector<std::uint32_t> meshlet_indices(const MeshletSet& set)
+    {
+        std::vector<std::uint32_t> indices{};
+        indices.reserve(std::size(set.triangles));
+        for(const auto& meshlet : set.meshlets)
+        {
+            for(const auto local : std::span{set.triangles}.subspan(meshlet.triangleOffset * 3, meshlet.triangleCount * 3))
+            {
+                indices.push_back(set.vertices[meshlet.vertexOffset + local]);
+            }
+        }
+        return indices;
+    }
+}
@@ -0,0 +1,203 @@
+#include <stdexcept>
+#include <charconv>
+#include <string>
+#include <string_view>
+
+#include "options.hpp"
+
+namespace app
+{
+    namespace
+    {
+        std::uint32_t parse_unsigned(std::string_view option, std::string_view value)
+        {
+            std::uint32_t result{0};
+            auto [end, error]{std::from_chars(std::data(value), std::data(value) + std::size(value), result)};
+            if(error != std::errc{} || end != std::data(value) + std::size(value))
+            {
+                throw std::invalid_argument{"Error: invalid value '" + std::string{value} + "' for " + std::string{option} + "."};
+            }
+            return result;
+        }
+
+        double parse_non_negative(std::string_view option, std::string_view value)
+        {
+            double result{0.0};
+            auto [end, error]{std::from_chars(std::data(value), std::data(value) + std::size(value), result)};
+            if(error != std::errc{} || end != std::data(value) + std::size(value) || result < 0.0)
+            {
+                throw std::invalid_argument{"Error: invalid value '" + std::string{value} + "' for " + std::string{option} + "."};
+            }
+            return result;
+        }
+
+        CaptureFormat parse_capture_format(std::string_view option, std::string_view value)
+        {
+            if(value == "png")
+            {
+                return CaptureFormat::png;
+            }
+            if(value == "raw")
+            {
+                return CaptureFormat::raw;
+            }
+            throw std::invalid_argument{"Error: invalid value '" + std::string{value} + "' for " + std::string{option} + "."};
+        }
+
+        float parse_scale(std::string_view option, std::string_view value)
+        {
+            float result{0.0f};
+            auto [end, error]{std::from_chars(std::data(value), std::data(value) + std::size(value), result)};
+            if(error != std::errc{} || end != std::data(value) + std::size(value) || result <= 0.0f || result > 1.0f)
+            {
+                throw std::invalid_argument{"Error: invalid value '" + std::string{value} + "' for " + std::string{option} + "."};
+            }
+            return result;
+        }
+    }
+
+    Options parse_options(std::span<char*> arguments, Options defaults)
+    {
+        Options options{defaults};
+
+        for(std::size_t i{1}; i < std::size(arguments); ++i)
+        {
+            std::string_view argument{arguments[i]};
+
+            auto next_value{[&]() -> std::string_view
+            {
+                if(i + 1 >= std::size(arguments))
+                {
+                    throw std::invalid_argument{"Error: missing value for " + std::string{argument} + "."};
+                }
+                return arguments[++i];
+            }};
+
+            if(argument == "--headless")
+            {
+                options.headless = true;
+            }
+            else if(argument == "--frames")
+            {
+                options.frameCount = parse_unsigned(argument, next_value());
+            }
+            else if(argument == "--output")
+            {
+                options.outputDirectory = next_value();
+            }
+            else if(argument == "--capture-format")
+            {
+                options.captureFormat = parse_capture_format(argument, next_value());
+            }
+            else if(argument == "--fixed-timestep")
+            {
+                options.fixedTimestep = parse_non_negative(argument, next_value());
+            }
+            else if(argument == "--warmup")
+            {
+                options.warmupFrames = parse_unsigned(argument, next_value());
+            }
+            else if(argument == "--duration")
+            {
+                options.duration = parse_non_negative(argument, next_value());
+            }
+            else if(argument == "--report")
+            {
+                options.reportPath = next_value();
+            }
+            else if(argument == "--objects")
+            {
+                options.objectCount = parse_unsigned(argument, next_value());
+            }
+            else if(argument == "--lights")
+            {
+                options.lightCount = parse_unsigned(argument, next_value());
+            }
+            else if(argument == "--scene")
+            {
+                options.scenePath = next_value();
+            }
+            else if(argument == "--meshlets")
+            {
+                options.meshlets = true;
+            }
+            else if(argument == "--gpu-budget")
+            {
+                options.gpuBudgetMilliseconds = parse_non_negative(argument, next_value());
+            }
+            else if(argument == "--min-render-scale")
+            {
+                options.minimumRenderScale = parse_scale(argument, next_value());
+            }
+            else if(argument == "--texture-budget")
+            {
+                options.textureBudgetMegabytes = parse_unsigned(argument, next_value());
+            }
+            else if(argument == "--threads")
+            {
+                options.workerThreads = parse_unsigned(argument, next_value());
+            }
+            else if(argument == "--pin-threads")
+            {
+                options.pinThreads = true;
+            }
+            else if(argument == "--hot-reload")
+            {
+                options.hotReload = true;
+            }
+            else if(argument == "--host-allocations")
+            {
+                options.hostAllocationReport = true;
+            }
+            else if(argument == "--pool-command-allocations")
+            {
+                options.poolCommandAllocations = true;
+            }
+            else if(argument == "--memory-report")
+            {
+                options.memoryReportPath = next_value();
+            }
+            else if(argument == "--profile-cache")
+            {
+                options.profileCachePath = next_value();
+            }
+            else if(argument == "--retune")
+            {
+                options.retune = true;
+            }
+            else if(argument == "--shader-features")
+            {
+                options.shaderVariant = parse_shader_variant(next_value());
+            }
+            else if(argument == "--width")
+            {
+                options.width = parse_unsigned(argument, next_value());
+            }
+            else if(argument == "--height")
+            {
+                options.height = parse_unsigned(argument, next_value());
+            }
+            else
+            {
+                throw std::invalid_argument{"Error: unknown option " + std::string{argument} + "."};
+            }
+        }
+
+        if(options.width == 0 || options.height == 0)
+        {
+            throw std::invalid_argument{"Error: width and height must be non-zero."};
+        }
+
+        if(options.objectCount == 0)
+        {
+            throw std::invalid_argument{"Error: object count must be non-zero."};
+        }
+
+        if(options.headless && options.frameCount == 0 && options.duration == 0.0)
+        {
+            options.frameCount = 1;
+        }
+
+        return options;
+    }
+}
@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <print>
+#include <ranges>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+#endif
+
+#include "profiler.hpp"
+
+namespace app
+{
+    namespace
+    {
+        double percentile(const std::vector<double>& sorted, double fraction)
+        {
+            auto rank{static_cast<std::size_t>(std::ceil(fraction * std::size(sorted)))};
+            return sorted[std::clamp(rank, std::size_t{1}, std::size(sorted)) - 1];
+        }
+
+        void write_statistics(std::ostream& out, std::string_view name, const std::vector<double>& values)
+        {
+            auto statistics{compute_statistics(values)};
+            std::print(out, "    \"{}\": {{\"mean\": {:.4f}, \"p50\": {:.4f}, \"p95\": {:.4f}, \"p99\": {:.4f}, \"max\": {:.4f}}}", 
+                       name, statistics.mean, statistics.p50, statistics.p95, statistics.p99, statistics.max);
+        }
+    }
+
+    Statistics compute_statistics(std::vector<double> values)
+    {
+        if(std::empty(values))
+        {
+            return {};
+        }
+
+        std::ranges::sort(values);
+
+        Statistics statistics{};
+        statistics.mean = std::accumulate(std::begin(values), std::end(values), 0.0) / std::size(values);
+        statistics.p50 = percentile(values, 0.50);
+        statistics.p95 = percentile(values, 0.95);
+        statistics.p99 = percentile(values, 0.99);
+        statistics.max = values.back();
+        return statistics;
+    }
+
+    std::uint64_t peak_resident_memory()
+    {
+        #if defined(_WIN32)
+            PROCESS_MEMORY_COUNTERS counters{};
+            if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            {
+                return static_cast<std::uint64_t>(counters.PeakWorkingSetSize);
+            }
+            return 0;
+        #else
+            rusage usage{};
+            getrusage(RUSAGE_SELF, &usage);
+            #if defined(__APPLE__)
+                return static_cast<std::uint64_t>(usage.ru_maxrss);
+            #else
+                return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+            #endif
+        #endif
+    }
+
+    void Profiler::record_phase(std::string_view name, Clock::time_point start, Clock::time_point end)
+    {
+        std::lock_guard lock{mutex};
+        phaseSamples.emplace_back(std::string{name}, std::chrono::duration<double, std::milli>(start - origin).count(),
+                                  std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    void Profiler::record_first_frame(Clock::time_point time)
+    {
+        std::lock_guard lock{mutex};
+        if(!firstFrameMilliseconds.has_value())
+        {
+            firstFrameMilliseconds = std::chrono::duration<double, std::milli>(time - origin).count();
+        }
+    }
+
+    FrameSample* Profiler::frame_sample(std::uint64_t frame)
+    {
+        if(frame < warmupFrames)
+        {
+            return nullptr;
+        }
+
+        auto index{frame - warmupFrames};
+        if(index >= std::size(frameSamples))
+        {
+            frameSamples.resize(index + 1);
+        }
+        return &frameSamples[index];
+    }
+
+    void Profiler::record_frame(std::uint64_t frame, const FrameSample& sample)
+    {
+        if(auto target{frame_sample(frame)})
+        {
+            target->frameMilliseconds = sample.frameMilliseconds;
+            target->cpuMilliseconds = sample.cpuMilliseconds;
+            target->renderScale = sample.renderScale;
+            target->msaaSamples = sample.msaaSamples;
+            target->textureResidentBytes = sample.textureResidentBytes;
+            target->heapAllocations = sample.heapAllocations;
+            target->frameArenaBytes = sample.frameArenaBytes;
+        }
+    }
+
+    void Profiler::record_gpu_time(std::uint64_t frame, double milliseconds)
+    {
+        if(auto target{frame_sample(frame)})
+        {
+            target->gpuMilliseconds = milliseconds;
+        }
+    }
+
+    void Profiler::record_culling(std::uint64_t frame, const CullingSample& sample)
+    {
+        if(auto target{frame_sample(frame)})
+        {
+            target->drawnClusters = sample.drawnClusters;
+            target->frustumCulledClusters = sample.frustumCulledClusters;
+            target->occludedClusters = sample.occludedClusters;
+        }
+    }
+
+    void Profiler::set_warmup_frames(std::uint64_t frames)
+    {
+        warmupFrames = frames;
+    }
+
+    void Profiler::reserve_frames(std::uint64_t frames)
+    {
+        // Growing the sample list mid-run would show up as a heap allocation in the frame being measured.
+        frameSamples.reserve(frames);
+    }
+
+    std::uint64_t Profiler::measured_frames() const
+    {
+        return std::size(frameSamples);
+    }
+
+    Statistics Profiler::gpu_statistics() const
+    {
+        // Frames whose timestamps were never read back have no GPU time.
+        auto gpuTimes{frameSamples | std::views::transform(&FrameSample::gpuMilliseconds) | 
+                      std::views::filter([](double time) { return time > 0.0; }) | std::ranges::to<std::vector>()};
+        return compute_statistics(std::move(gpuTimes));
+    }
+
+    const std::vector<PhaseSample>& Profiler::phases() const
+    {
+        return phaseSamples;
+    }
+
+    double Profiler::startup_milliseconds() const
+    {
+        std::lock_guard lock{mutex};
+        double end{0.0};
+        for(const auto& phase : phaseSamples)
+        {
+            end = std::max(end, phase.startMilliseconds + phase.milliseconds);
+        }
+        return end;
+    }
+
+    void Profiler::write_startup_report(std::ostream& out) const
+    {
+        auto total{startup_milliseconds()};
+
+        std::lock_guard lock{mutex};
+        auto sorted{phaseSamples};
+        std::ranges::sort(sorted, {}, &PhaseSample::startMilliseconds);
+
+        std::println(out, "Startup phases:");
+        for(const auto& phase : sorted)
+        {
+            std::println(out, "\t{:<32} start {:>9.3f} ms  duration {:>9.3f} ms", phase.name, phase.startMilliseconds, phase.milliseconds);
+        }
+        std::println(out, "\t{:<32} {:>9.3f} ms", "total", total);
+    }
+
+    void Profiler::write_json(std::ostream& out, const MemoryUsage& memory, std::span<const CacheUsage> caches, 
+                              std::span<const HostAllocationUsage> hostAllocations) const
+    {
+        auto column{[this](auto member)
+        {
+            return frameSamples | std::views::transform(member) | std::ranges::to<std::vector>();
+        }};
+
+        auto gpuTimes{column(&FrameSample::gpuMilliseconds)};
+        std::erase_if(gpuTimes, [](double time) { return time <= 0.0; });
+
+        std::println(out, "{{");
+        std::println(out, "  \"frames\": {},", std::size(frameSamples));
+        std::println(out, "  \"warmupFrames\": {},", warmupFrames);
+        std::println(out, "  \"frameTimeMilliseconds\": {{");
+        write_statistics(out, "frame", column(&FrameSample::frameMilliseconds));
+        std::println(out, ",");
+        write_statistics(out, "cpu", column(&FrameSample::cpuMilliseconds));
+        std::println(out, ",");
+        write_statistics(out, "gpu", gpuTimes);
+        std::println(out, "");
+        std::println(out, "  }},");
+        std::println(out, "  \"clustersPerFrame\": {{");
+        write_statistics(out, "drawn", column(&FrameSample::drawnClusters));
+        std::println(out, ",");
+        write_statistics(out, "frustumCulled", column(&FrameSample::frustumCulledClusters));
+        std::println(out, ",");
+        write_statistics(out, "occluded", column(&FrameSample::occludedClusters));
+        std::println(out, "");
+        std::println(out, "  }},");
+        std::println(out, "  \"resolution\": {{");
+        write_statistics(out, "scale", column(&FrameSample::renderScale));
+        std::println(out, ",");
+        write_statistics(out, "samples", column(&FrameSample::msaaSamples));
+        std::println(out, "");
+        std::println(out, "  }},");
+        std::println(out, "  \"textureStreaming\": {{");
+        write_statistics(out, "residentBytes", column(&FrameSample::textureResidentBytes));
+        std::println(out, "");
+        std::println(out, "  }},");
+        std::println(out, "  \"hostAllocationsPerFrame\": {{");
+        write_statistics(out, "heap", column(&FrameSample::heapAllocations));
+        std::println(out, ",");
+        write_statistics(out, "frameArenaBytes", column(&FrameSample::frameArenaBytes));
+        std::println(out, "");
+        std::println(out, "  }},");
+
+        auto total{startup_milliseconds()};
+
+        std::println(out, "  \"startupMilliseconds\": {{");
+        std::println(out, "    \"phases\": {{");
+        for(const auto& [i, phase] : phaseSamples | std::views::enumerate)
+        {
+            std::println(out, "      \"{}\": {{\"start\": {:.4f}, \"duration\": {:.4f}}}{}", phase.name, phase.startMilliseconds,
+                         phase.milliseconds, i + 1 < std::ssize(phaseSamples) ? "," : "");
+        }
+        std::println(out, "    }},");
+        std::println(out, "    \"total\": {:.4f},", total);
+        std::println(out, "    \"timeToFirstFrame\": {:.4f}", firstFrameMilliseconds.value_or(0.0));
+        std::println(out, "  }},");
+
+        std::println(out, "  \"memory\": {{");
+        std::println(out, "    \"deviceBytes\": {},", memory.deviceBytes);
+        std::println(out, "    \"peakDeviceBytes\": {},", memory.peakDeviceBytes);
+        std::println(out, "    \"lazilyAllocatedBytes\": {},", memory.lazilyAllocatedBytes);
+        std::println(out, "    \"peakResidentBytes\": {},", memory.peakResidentBytes);
+        std::println(out, "    \"hostBytes\": {},", memory.hostBytes);
+        std::println(out, "    \"peakHostBytes\": {}", memory.peakHostBytes);
+        std::println(out, "  }},");
+
+        std::println(out, "  \"driverHostAllocations\": [");
+        for(const auto& [i, usage] : hostAllocations | std::views::enumerate)
+        {
+            std::println(out, "    {{\"objectType\": \"{}\", \"scope\": \"{}\", \"bytes\": {}, \"peakBytes\": {}, \"allocations\": {}}}{}", 
+                         usage.objectType, usage.scope, usage.bytes, usage.peakBytes, usage.allocations, 
+                         i + 1 < std::ssize(hostAllocations) ? "," : "");
+        }
+        std::println(out, "  ],");
+
+        std::println(out, "  \"resourceCaches\": {{");
+        for(const auto& [i, cache] : caches | std::views::enumerate)
+        {
+            auto hitRate{cache.lookups > 0 ? static_cast<double>(cache.hits) / static_cast<double>(cache.lookups) : 0.0};
+            std::println(out, "    \"{}\": {{\"lookups\": {}, \"hits\": {}, \"hitRate\": {:.4f}, \"bytesSaved\": {}, \"entries\": {}}}{}", 
+                         cache.name, cache.lookups, cache.hits, hitRate, cache.bytesSaved, cache.entries, i + 1 < std::ssize(caches) ? "," : "");
+        }
+        std::println(out, "  }}");
+        std::println(out, "}}");
+    }
+}
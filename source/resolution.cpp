@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <cmath>
+
+#include "resolution.hpp"
+
+namespace app
+{
+    ResolutionController::ResolutionController(const ResolutionSettings& settings)
+        : settings{settings}, currentSamples{settings.maximumSamples}
+    {
+        this->settings.minimumScale = std::clamp(settings.minimumScale, 0.1f, 1.0f);
+    }
+
+    bool ResolutionController::update(double gpuMilliseconds)
+    {
+        if(!enabled() || gpuMilliseconds <= 0.0)
+        {
+            return false;
+        }
+
+        auto load{static_cast<float>(gpuMilliseconds / settings.gpuBudgetMilliseconds)};
+
+        // Fragment cost scales with pixel count, so the side length moves with the square root of the load.
+        if(load > 1.0f || load < 1.0f - deadband)
+        {
+            auto target{currentScale / std::sqrt(load)};
+            currentScale = std::clamp(currentScale + (target - currentScale) * damping, settings.minimumScale, 1.0f);
+        }
+
+        pressureFrames = load > 1.0f && currentScale == settings.minimumScale ? pressureFrames + 1 : 0;
+        headroomFrames = load < headroom && currentScale == 1.0f ? headroomFrames + 1 : 0;
+
+        if(pressureFrames >= pressureFrameLimit && currentSamples > VK_SAMPLE_COUNT_1_BIT)
+        {
+            currentSamples = static_cast<VkSampleCountFlagBits>(currentSamples >> 1);
+            pressureFrames = 0;
+            return true;
+        }
+
+        if(headroomFrames >= headroomFrameLimit && currentSamples < settings.maximumSamples)
+        {
+            currentSamples = static_cast<VkSampleCountFlagBits>(currentSamples << 1);
+            headroomFrames = 0;
+            return true;
+        }
+
+        return false;
+    }
+
+    bool ResolutionController::enabled() const
+    {
+        return settings.gpuBudgetMilliseconds > 0.0;
+    }
+
+    float ResolutionController::scale() const
+    {
+        return currentScale;
+    }
+
+    VkSampleCountFlagBits ResolutionController::samples() const
+    {
+        return currentSamples;
+    }
+
+    VkExtent2D ResolutionController::render_extent(VkExtent2D targetExtent) const
+    {
+        return {std::max(static_cast<std::uint32_t>(std::lround(targetExtent.width * currentScale)), 1u),
+                std::max(static_cast<std::uint32_t>(std::lround(targetExtent.height * currentScale)), 1u)};
+    }
+}
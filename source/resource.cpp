@@ -0,0 +1,204 @@
+#include <algorithm>
+
+#include "resource.hpp"
+
+namespace app
+{
+    void MemoryCounter::add(VkDeviceSize size)
+    {
+        auto bytes{currentBytes.fetch_add(size, std::memory_order_relaxed) + size};
+        auto peak{peakBytes.load(std::memory_order_relaxed)};
+        while(peak < bytes && !peakBytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    void MemoryCounter::remove(VkDeviceSize size)
+    {
+        currentBytes.fetch_sub(size, std::memory_order_relaxed);
+    }
+
+    VkDeviceSize MemoryCounter::bytes() const
+    {
+        return currentBytes.load(std::memory_order_relaxed);
+    }
+
+    VkDeviceSize MemoryCounter::peak_bytes() const
+    {
+        return peakBytes.load(std::memory_order_relaxed);
+    }
+
+    Allocation::Allocation(VkDevice device, VkDeviceMemory memory, VkDeviceSize size, MemoryCounter* counter, bool lazilyAllocated, 
+                           MemoryRegistry* registry, MemoryRegistry::Id registration)
+        : device{device}, memory{memory}, allocationSize{size}, counter{counter}, lazy{lazilyAllocated}, registry{registry}
+        , registration{registration}
+    {
+        if(counter)
+        {
+            counter->add(allocationSize);
+        }
+    }
+
+    Allocation::Allocation(Allocation&& that) noexcept
+        : device{std::exchange(that.device, VK_NULL_HANDLE)}
+        , memory{std::exchange(that.memory, VK_NULL_HANDLE)}
+        , allocationSize{std::exchange(that.allocationSize, 0)}
+        , counter{std::exchange(that.counter, nullptr)}
+        , lazy{std::exchange(that.lazy, false)}
+        , registry{std::exchange(that.registry, nullptr)}
+        , registration{std::exchange(that.registration, 0)}
+    {
+    }
+
+    Allocation& Allocation::operator=(Allocation&& that) noexcept
+    {
+        if(this != &that)
+        {
+            reset();
+            device = std::exchange(that.device, VK_NULL_HANDLE);
+            memory = std::exchange(that.memory, VK_NULL_HANDLE);
+            allocationSize = std::exchange(that.allocationSize, 0);
+            counter = std::exchange(that.counter, nullptr);
+            lazy = std::exchange(that.lazy, false);
+            registry = std::exchange(that.registry, nullptr);
+            registration = std::exchange(that.registration, 0);
+        }
+        return *this;
+    }
+
+    Allocation::~Allocation()
+    {
+        reset();
+    }
+
+    void Allocation::reset()
+    {
+        if(memory == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        vkFreeMemory(device, memory, host_allocator(VK_OBJECT_TYPE_DEVICE_MEMORY));
+        if(counter)
+        {
+            counter->remove(allocationSize);
+        }
+        if(registry)
+        {
+            registry->remove(registration);
+        }
+        memory = VK_NULL_HANDLE;
+        allocationSize = 0;
+        lazy = false;
+        registry = nullptr;
+        registration = 0;
+    }
+
+    VkDeviceMemory Allocation::get() const
+    {
+        return memory;
+    }
+
+    VkDeviceSize Allocation::size() const
+    {
+        return allocationSize;
+    }
+
+    bool Allocation::lazily_allocated() const
+    {
+        return lazy;
+    }
+
+    Allocation::operator VkDeviceMemory() const
+    {
+        return memory;
+    }
+
+    Instance::Instance(VkInstance instance)
+        : instance{instance}
+    {
+    }
+
+    Instance::Instance(Instance&& that) noexcept
+        : instance{std::exchange(that.instance, VK_NULL_HANDLE)}
+    {
+    }
+
+    Instance& Instance::operator=(Instance&& that) noexcept
+    {
+        if(this != &that)
+        {
+            if(instance != VK_NULL_HANDLE)
+            {
+                vkDestroyInstance(instance, host_allocator(VK_OBJECT_TYPE_INSTANCE));
+            }
+            instance = std::exchange(that.instance, VK_NULL_HANDLE);
+        }
+        return *this;
+    }
+
+    Instance::~Instance()
+    {
+        if(instance != VK_NULL_HANDLE)
+        {
+            vkDestroyInstance(instance, host_allocator(VK_OBJECT_TYPE_INSTANCE));
+        }
+    }
+
+    VkInstance Instance::get() const
+    {
+        return instance;
+    }
+
+    Instance::operator VkInstance() const
+    {
+        return instance;
+    }
+
+    Device::Device(VkDevice device)
+        : device{device}
+    {
+    }
+
+    Device::Device(Device&& that) noexcept
+        : device{std::exchange(that.device, VK_NULL_HANDLE)}
+    {
+    }
+
+    Device& Device::operator=(Device&& that) noexcept
+    {
+        if(this != &that)
+        {
+            if(device != VK_NULL_HANDLE)
+            {
+                vkDestroyDevice(device, host_allocator(VK_OBJECT_TYPE_DEVICE));
+            }
+            device = std::exchange(that.device, VK_NULL_HANDLE);
+        }
+        return *this;
+    }
+
+    Device::~Device()
+    {
+        if(device != VK_NULL_HANDLE)
+        {
+            vkDestroyDevice(device, host_allocator(VK_OBJECT_TYPE_DEVICE));
+        }
+    }
+
+    VkDevice Device::get() const
+    {
+        return device;
+    }
+
+    Device::operator VkDevice() const
+    {
+        return device;
+    }
+
+    void WindowDeleter::operator()(GLFWwindow* window) const
+    {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
+}
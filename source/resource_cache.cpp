@@ -0,0 +1,117 @@
+#include <bit>
+#include <cstring>
+
+#include "resource_cache.hpp"
+
+namespace app
+{
+    namespace
+    {
+        constexpr std::uint64_t hashPrime{0x100000001b3ull};
+
+        std::uint64_t mix(std::uint64_t hash, std::uint64_t value)
+        {
+            return (hash ^ value) * hashPrime;
+        }
+
+        constexpr std::uint64_t checkPrime1{0x9e3779b185ebca87ull};
+        constexpr std::uint64_t checkPrime2{0xc2b2ae3d27d4eb4full};
+
+        // xxHash64 round: multiply and rotate rather than xor and multiply, so it does not collide where mix does.
+        std::uint64_t check_round(std::uint64_t hash, std::uint64_t value)
+        {
+            return std::rotl(hash + value * checkPrime2, 31) * checkPrime1;
+        }
+
+        // Murmur3 finaliser, so keys that differ in a few bits still spread over the whole table.
+        std::uint64_t avalanche(std::uint64_t hash)
+        {
+            hash ^= hash >> 33;
+            hash *= 0xff51afd7ed558ccdull;
+            hash ^= hash >> 33;
+            hash *= 0xc4ceb9fe1a85ec53ull;
+            hash ^= hash >> 33;
+            return hash;
+        }
+
+        template<typename... Values>
+        std::size_t combine(const Values&... values)
+        {
+            std::uint64_t hash{0xcbf29ce484222325ull};
+            ((hash = mix(hash, static_cast<std::uint64_t>(values))), ...);
+            return static_cast<std::size_t>(avalanche(hash));
+        }
+
+        std::uint32_t float_bits(float value)
+        {
+            // Folds -0.0 onto 0.0 so the hash agrees with operator==.
+            value = value == 0.0f ? 0.0f : value;
+            std::uint32_t bits{};
+            std::memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+    }
+
+    std::uint64_t hash_bytes(std::span<const std::byte> bytes)
+    {
+        // FNV-1a over whole words rather than single bytes keeps multi-megabyte textures cheap to key.
+        std::uint64_t hash{0xcbf29ce484222325ull};
+        std::size_t offset{0};
+        for(; offset + sizeof(std::uint64_t) <= std::size(bytes); offset += sizeof(std::uint64_t))
+        {
+            std::uint64_t word{};
+            std::memcpy(&word, std::data(bytes) + offset, sizeof(word));
+            hash = mix(hash, word);
+        }
+        for(; offset < std::size(bytes); ++offset)
+        {
+            hash = mix(hash, static_cast<std::uint64_t>(bytes[offset]));
+        }
+        return avalanche(mix(hash, std::size(bytes)));
+    }
+
+    std::uint64_t check_bytes(std::span<const std::byte> bytes)
+    {
+        std::uint64_t hash{checkPrime1 + checkPrime2};
+        std::size_t offset{0};
+        for(; offset + sizeof(std::uint64_t) <= std::size(bytes); offset += sizeof(std::uint64_t))
+        {
+            std::uint64_t word{};
+            std::memcpy(&word, std::data(bytes) + offset, sizeof(word));
+            hash = check_round(hash, word);
+        }
+        for(; offset < std::size(bytes); ++offset)
+        {
+            hash = check_round(hash, static_cast<std::uint64_t>(bytes[offset]));
+        }
+        return avalanche(check_round(hash, std::size(bytes)));
+    }
+
+    bool SamplerKey::operator==(const SamplerKey& that) const
+    {
+        const auto& a{info};
+        const auto& b{that.info};
+        return a.flags == b.flags && a.magFilter == b.magFilter && a.minFilter == b.minFilter && a.mipmapMode == b.mipmapMode &&
+               a.addressModeU == b.addressModeU && a.addressModeV == b.addressModeV && a.addressModeW == b.addressModeW &&
+               a.mipLodBias == b.mipLodBias && a.anisotropyEnable == b.anisotropyEnable && a.maxAnisotropy == b.maxAnisotropy &&
+               a.compareEnable == b.compareEnable && a.compareOp == b.compareOp && a.minLod == b.minLod && a.maxLod == b.maxLod &&
+               a.borderColor == b.borderColor && a.unnormalizedCoordinates == b.unnormalizedCoordinates;
+    }
+}
+
+namespace std
+{
+    size_t hash<app::TextureKey>::operator()(const app::TextureKey& key) const
+    {
+        return app::combine(key.contentHash, key.width, key.height, key.format);
+    }
+
+    size_t hash<app::SamplerKey>::operator()(const app::SamplerKey& key) const
+    {
+        const auto& info{key.info};
+        return app::combine(info.flags, info.magFilter, info.minFilter, info.mipmapMode, info.addressModeU, info.addressModeV,
+                            info.addressModeW, app::float_bits(info.mipLodBias), info.anisotropyEnable, app::float_bits(info.maxAnisotropy),
+                            info.compareEnable, info.compareOp, app::float_bits(info.minLod), app::float_bits(info.maxLod), info.borderColor,
+                            info.unnormalizedCoordinates);
+    }
+}
@@ -0,0 +1,199 @@
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <tiny_obj_loader.h>
+
+#include "scene.hpp"
+
+namespace app
+{
+    namespace
+    {
+        std::uint32_t find_name(const std::unordered_map<std::string, std::uint32_t>& names, const std::string& name,
+                                std::string_view kind, std::size_t line)
+        {
+            auto found{names.find(name)};
+            if(found == std::end(names))
+            {
+                throw std::runtime_error{"Error: unknown " + std::string{kind} + " '" + name + "' on scene line " + std::to_string(line) + "."};
+            }
+            return found->second;
+        }
+    }
+
+    SceneDescription load_scene(const std::filesystem::path& path)
+    {
+        std::ifstream in{path};
+        if(!in.is_open())
+        {
+            throw std::runtime_error{"Error: failed to open scene " + path.string() + "."};
+        }
+
+        auto directory{path.parent_path()};
+        SceneDescription scene{};
+        std::unordered_map<std::string, std::uint32_t> materialNames{};
+        std::unordered_map<std::string, std::uint32_t> meshNames{};
+
+        std::string line{};
+        for(std::size_t number{1}; std::getline(in, line); ++number)
+        {
+            line = line.substr(0, line.find('#'));
+            std::istringstream words{line};
+            std::string directive{};
+            if(!(words >> directive))
+            {
+                continue;
+            }
+
+            std::string name{};
+            if(directive == "material")
+            {
+                std::string texture{};
+                if(!(words >> name >> texture))
+                {
+                    throw std::runtime_error{"Error: malformed material on scene line " + std::to_string(number) + "."};
+                }
+                materialNames[name] = static_cast<std::uint32_t>(std::size(scene.materials));
+                scene.materials.push_back({directory / texture});
+            }
+            else if(directive == "mesh")
+            {
+                std::string model{};
+                std::string material{};
+                if(!(words >> name >> model >> material))
+                {
+                    throw std::runtime_error{"Error: malformed mesh on scene line " + std::to_string(number) + "."};
+                }
+                meshNames[name] = static_cast<std::uint32_t>(std::size(scene.meshes));
+                scene.meshes.push_back({directory / model, find_name(materialNames, material, "material", number)});
+            }
+            else if(directive == "instance")
+            {
+                glm::vec3 position{};
+                if(!(words >> name >> position.x >> position.y >> position.z))
+                {
+                    throw std::runtime_error{"Error: malformed instance on scene line " + std::to_string(number) + "."};
+                }
+
+                float scale{1.0f};
+                if(!(words >> scale))
+                {
+                    scale = 1.0f;
+                }
+
+                Transform transform{};
+                transform.position = position;
+                transform.scale = glm::vec3{scale};
+                scene.instances.push_back({find_name(meshNames, name, "mesh", number), transform});
+            }
+            else if(directive == "light")
+            {
+                glm::vec3 position{};
+                float radius{0.0f};
+                glm::vec3 color{};
+                if(!(words >> position.x >> position.y >> position.z >> radius >> color.r >> color.g >> color.b) || radius <= 0.0f)
+                {
+                    throw std::runtime_error{"Error: malformed light on scene line " + std::to_string(number) + "."};
+                }
+                scene.lights.push_back({glm::vec4{position, radius}, glm::vec4{color, 1.0f}});
+            }
+            else
+            {
+                throw std::runtime_error{"Error: unknown directive '" + directive + "' on scene line " + std::to_string(number) + "."};
+            }
+        }
+
+        if(std::empty(scene.meshes))
+        {
+            throw std::runtime_error{"Error: scene " + path.string() + " has no meshes."};
+        }
+        return scene;
+    }
+
+    SceneDescription single_model_scene(const std::filesystem::path& modelPath, const std::filesystem::path& texturePath)
+    {
+        SceneDescription scene{};
+        scene.materials.push_back({texturePath});
+        scene.meshes.push_back({modelPath, 0});
+        return scene;
+    }
+
+    MeshData load_obj(const std::filesystem::path& path)
+    {
+        tinyobj::attrib_t attribute{};
+        std::vector<tinyobj::shape_t> shapes{};
+        std::vector<tinyobj::material_t> materials{};
+        std::string warnings{};
+        std::string errors{};
+
+        if(!tinyobj::LoadObj(&attribute, &shapes, &materials, &warnings, &errors, path.string().c_str())) 
+        {
+            throw std::runtime_error(warnings + errors);
+        }
+
+        MeshData mesh{};
+        std::unordered_map<Vertex, std::uint32_t> uniqueVertices{};
+        for(const auto& shape : shapes) 
+        {
+            for(const auto& index : shape.mesh.indices) 
+            {
+                Vertex vertex{};
+
+                vertex.position = {attribute.vertices[3 * index.vertex_index + 0],
+                                   attribute.vertices[3 * index.vertex_index + 1],
+                                   attribute.vertices[3 * index.vertex_index + 2]};
+
+                // Faces written without texture coordinates have an index of -1 and keep the zero coordinate.
+                if(index.texcoord_index >= 0)
+                {
+                    vertex.textureCoordinate = {attribute.texcoords[2 * index.texcoord_index + 0],
+                                                1.0f - attribute.texcoords[2 * index.texcoord_index + 1]};
+                }
+
+                vertex.color = {1.0f, 1.0f, 1.0f};
+
+                if(uniqueVertices.find(vertex) == std::end(uniqueVertices))
+                {
+                    uniqueVertices[vertex] = static_cast<std::uint32_t>(std::size(mesh.vertices));
+                    mesh.vertices.push_back(vertex);
+                }
+
+                mesh.indices.push_back(uniqueVertices[vertex]);
+            }
+        }
+        return mesh;
+    }
+
+    std::uint32_t SceneGeometry::add_mesh(const MeshData& mesh, std::uint32_t material)
+    {
+        MeshRange range{};
+        range.firstIndex = static_cast<std::uint32_t>(std::size(indices));
+        range.indexCount = static_cast<std::uint32_t>(std::size(mesh.indices));
+        range.vertexOffset = static_cast<std::int32_t>(std::size(vertices));
+        range.vertexCount = static_cast<std::uint32_t>(std::size(mesh.vertices));
+        range.material = material;
+        range.bounds = compute_bounding_sphere(mesh.vertices);
+
+        // Indices stay local to their mesh; the draw's vertexOffset rebases them.
+        vertices.insert(std::end(vertices), std::begin(mesh.vertices), std::end(mesh.vertices));
+        indices.insert(std::end(indices), std::begin(mesh.indices), std::end(mesh.indices));
+        meshes.push_back(range);
+        return static_cast<std::uint32_t>(std::size(meshes) - 1);
+    }
+
+    std::vector<DrawItem> build_draw_list(std::span<const MeshRange> meshes, std::span<const SceneInstance> instances)
+    {
+        std::vector<DrawItem> draws{};
+        draws.reserve(std::size(instances));
+        for(const auto& instance : instances)
+        {
+            const auto& mesh{meshes[instance.mesh]};
+            draws.push_back({mesh.firstIndex, mesh.indexCount, mesh.vertexOffset, mesh.material, instance.mesh, instance.transform});
+        }
+        return draws;
+    }
+}
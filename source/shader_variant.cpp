@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <ranges>
+#include <stdexcept>
+
+#include "shader_variant.hpp"
+
+namespace app
+{
+    namespace
+    {
+        constexpr std::array<std::string_view, static_cast<std::size_t>(ShaderFeature::count)> featureNames
+        {
+            "textured",
+            "vertex-color",
+            "quantized",
+            "instanced",
+            "lit"
+        };
+    }
+
+    std::string ShaderVariantKey::name() const
+    {
+        std::string result{};
+        for(const auto& [i, featureName] : featureNames | std::views::enumerate)
+        {
+            if(has(static_cast<ShaderFeature>(i)))
+            {
+                result += std::empty(result) ? "" : ",";
+                result += featureName;
+            }
+        }
+        return std::empty(result) ? "none" : result;
+    }
+
+    ShaderVariantKey parse_shader_variant(std::string_view features)
+    {
+        ShaderVariantKey key{};
+        if(features == "none")
+        {
+            return key;
+        }
+
+        for(const auto token : features | std::views::split(','))
+        {
+            std::string_view featureName{std::begin(token), std::end(token)};
+            auto found{std::ranges::find(featureNames, featureName)};
+            if(found == std::end(featureNames))
+            {
+                throw std::invalid_argument{"Error: unknown shader feature '" + std::string{featureName} + "'."};
+            }
+            key = key.with(static_cast<ShaderFeature>(std::distance(std::begin(featureNames), found)));
+        }
+        return key;
+    }
+
+    ShaderSpecialization::ShaderSpecialization(ShaderVariantKey key)
+        : values{}, entries{}, specializationInfo{}
+    {
+        for(const auto i : std::views::iota(0u, static_cast<std::uint32_t>(featureCount)))
+        {
+            values[i] = key.has(static_cast<ShaderFeature>(i)) ? VK_TRUE : VK_FALSE;
+            entries[i].constantID = i;
+            entries[i].offset = static_cast<std::uint32_t>(i * sizeof(VkBool32));
+            entries[i].size = sizeof(VkBool32);
+        }
+
+        specializationInfo.mapEntryCount = static_cast<std::uint32_t>(std::size(entries));
+        specializationInfo.pMapEntries = std::data(entries);
+        specializationInfo.dataSize = sizeof(values);
+        specializationInfo.pData = std::data(values);
+    }
+
+    const VkSpecializationInfo* ShaderSpecialization::info() const
+    {
+        return &specializationInfo;
+    }
+}
+
+namespace std
+{
+    size_t hash<app::ShaderVariantKey>::operator()(const app::ShaderVariantKey& key) const
+    {
+        return hash<std::uint32_t>{}(key.value());
+    }
+}
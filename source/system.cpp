@@ -6,9 +6,11 @@
 #include <algorithm>
 #include <chrono>
 #include <unordered_map>
+#include <format>
+#include <cstdlib>
+#include <cstddef>
+#include <limits>
 
-#define GLM_FORCE_RADIANS
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -20,115 +22,264 @@
 
 #include "file.hpp"
 #include "system.hpp"
+#include "task_graph.hpp"
+#include "thread_pool.hpp"
+#include "host_allocator.hpp"
 
 #undef max
 
 namespace app
 {
-    System::System(const std::uint32_t width, const std::uint32_t height)
-        : physicalDevice{VK_NULL_HANDLE}, currentFrame{0}
-        , framebufferResized{false}, msaaSamples{VK_SAMPLE_COUNT_1_BIT}
-    {
-        create_window(width, height, name);
-        create_instance();
-        show_extensions_support();
-        setup_debug_messages();
-        create_surface();
-        pick_physical_device();
-        create_logical_device();
-        create_swap_chain();
-        create_image_views();
-        create_render_pass();
-        create_descriptor_set_layout();
-        create_graphics_pipeline();
-        create_command_pool();
-        create_color_resources();
-        create_depth_resources();
-        create_frame_buffers();
-        create_texture_image();
-        create_texture_image_view();
-        create_texture_sampler();
-        load_model();
-        create_vertex_buffer();
-        create_index_buffer();
-        create_uniform_buffers();
-        create_descriptor_pool();
-        create_descriptor_sets();
-        create_command_buffers();
-        create_sync_objects();
+    System::System(const Options& options)
+        : options{options}, jobs{options.workerThreads == 0 ? std::thread::hardware_concurrency() : options.workerThreads, options.pinThreads}
+        , physicalDevice{VK_NULL_HANDLE}, supportedFeatures{}, supportedVulkan12Features{}, setDebugUtilsObjectName{nullptr}
+        , swapChain{VK_NULL_HANDLE}, cullPipelineLayout{VK_NULL_HANDLE}, cullPipeline{VK_NULL_HANDLE}
+        , hiZDescriptorSetLayout{VK_NULL_HANDLE}, hiZPipelineLayout{VK_NULL_HANDLE}, hiZPipeline{VK_NULL_HANDLE}
+        , lightCullPipelineLayout{VK_NULL_HANDLE}, lightCullPipeline{VK_NULL_HANDLE}
+        , depthPrePass{VK_NULL_HANDLE}, depthPrePassPipeline{VK_NULL_HANDLE}, currentFrame{0}, frameNumber{0}
+        , shaderRebuildRunning{false}, shaderRebuildQueued{false}, positionScale{1.0f}, positionOffset{0.0f}, drawCapacity{0}, frameUniforms{}
+        , textureStreamer{static_cast<VkDeviceSize>(options.textureBudgetMegabytes) << 20}, streamedTexture{0}, textureFirstLevel{0}, textureVersion{0}
+        , textureSampler{VK_NULL_HANDLE}, hiZSampler{VK_NULL_HANDLE}, hiZDescriptorSet{VK_NULL_HANDLE}, framebufferResized{false}, memoryReportRequested{false}, msaaSamples{VK_SAMPLE_COUNT_1_BIT}, upscaleFilter{VK_FILTER_LINEAR}, deviceProfile{}, renderExtent{}
+        , frameTimeline{VK_NULL_HANDLE}, frameArenas(maxFramesInFlight)
+        , capturedFrames{0}, captureStalls{0}, timestampQueryPool{VK_NULL_HANDLE}
+        , timestampPeriod{0.0}, timestampMask{0}
+    {
+        profiler.set_warmup_frames(options.warmupFrames);
+        profiler.reserve_frames(options.frameCount);
+        if(options.hostAllocationReport || options.poolCommandAllocations)
+        {
+            enable_host_allocation_tracking(options.poolCommandAllocations);
+        }
+        if(!options.memoryReportPath.empty())
+        {
+            memoryRegistry.set_exit_report(options.memoryReportPath);
+        }
+
+        TaskGraph startup{};
+        using enum TaskGraph::Affinity;
+
+        auto sceneDescriptionTask{startup.add("load_scene_description", {}, [this]{ load_scene_description(); })};
+        auto decodeTexturesTask{startup.add("decode_textures", {sceneDescriptionTask}, [this]{ decode_textures(); })};
+        auto loadSceneTask{startup.add("load_scene", {sceneDescriptionTask}, [this]{ load_scene(); })};
+        auto readShadersTask{startup.add("read_shaders", {}, [this]{ read_shaders(); })};
+        startup.add("create_shader_watcher", {}, [this]{ create_shader_watcher(); });
+        startup.add("show_extensions_support", {}, [this]{ show_extensions_support(); });
+
+        auto windowTask{startup.add("create_window", {}, [&]{ create_window(options.width, options.height, name); }, main)};
+        auto instanceTask{startup.add("create_instance", {windowTask}, [this]{ create_instance(); })};
+        auto debugMessagesTask{startup.add("setup_debug_messages", {instanceTask}, [this]{ setup_debug_messages(); })};
+        auto surfaceTask{startup.add("create_surface", {instanceTask}, [this]{ create_surface(); })};
+        auto physicalDeviceTask{startup.add("pick_physical_device", {debugMessagesTask, surfaceTask}, [this]{ pick_physical_device(); })};
+        auto logicalDeviceTask{startup.add("create_logical_device", {physicalDeviceTask}, [this]{ create_logical_device(); })};
+        auto commandPoolTask{startup.add("create_command_pool", {logicalDeviceTask}, [this]{ create_command_pool(); })};
+        auto tuneTask{startup.add("tune_device_profile", {commandPoolTask}, [this]{ tune_device_profile(); })};
+        auto swapChainTask{startup.add("create_swap_chain", {tuneTask}, [this]{ create_swap_chain(); }, main)};
+        auto renderPassTask{startup.add("create_render_pass", {swapChainTask}, [this]{ create_render_pass(); })};
+        auto descriptorSetLayoutTask{startup.add("create_descriptor_set_layout", {logicalDeviceTask}, [this]{ create_descriptor_set_layout(); })};
+        auto depthPrePassTask{startup.add("create_depth_pre_pass", {logicalDeviceTask}, [this]{ create_depth_pre_pass(); })};
+        auto pipelineLayoutTask{startup.add("create_pipeline_layout", {descriptorSetLayoutTask}, [this]{ create_pipeline_layout(); })};
+        // Lights in the scene switch the startup variant to lit, so the mesh pipelines wait for the scene description.
+        startup.add("create_graphics_pipeline", {renderPassTask, pipelineLayoutTask, readShadersTask, sceneDescriptionTask}, 
+                    [this]{ create_graphics_pipeline(); });
+        startup.add("create_depth_pre_pass_pipeline", {depthPrePassTask, pipelineLayoutTask, readShadersTask, sceneDescriptionTask}, 
+                    [this]{ create_depth_pre_pass_pipeline(); });
+        startup.add("create_cull_pipeline", {descriptorSetLayoutTask, readShadersTask}, [this]{ create_cull_pipeline(); });
+        startup.add("create_hi_z_pipeline", {descriptorSetLayoutTask, readShadersTask}, [this]{ create_hi_z_pipeline(); });
+        startup.add("create_light_cull_pipeline", {descriptorSetLayoutTask, readShadersTask}, [this]{ create_light_cull_pipeline(); });
+        auto colorResourcesTask{startup.add("create_color_resources", {swapChainTask}, [this]{ create_color_resources(); })};
+        auto depthResourcesTask{startup.add("create_depth_resources", {swapChainTask}, [this]{ create_depth_resources(); })};
+        startup.add("create_frame_buffer", {renderPassTask, colorResourcesTask, depthResourcesTask}, [this]{ create_frame_buffer(); });
+        startup.add("report_transient_attachments", {colorResourcesTask, depthResourcesTask}, [this]{ report_transient_attachments(); });
+
+        // Uploads share the command pool and the graphics queue with the tuning benchmark, so they are chained rather than run
+        // side by side. Command buffers are allocated from the same pool and wait for the last upload in the chain.
+        auto textureImageTask{startup.add("create_texture_image", {decodeTexturesTask, tuneTask}, [this]{ create_texture_image(); })};
+        auto textureImageViewTask{startup.add("create_texture_image_view", {textureImageTask}, [this]{ create_texture_image_view(); })};
+        auto textureSamplerTask{startup.add("create_texture_sampler", {textureImageTask}, [this]{ create_texture_sampler(); })};
+        auto clustersTask{startup.add("create_clusters", {loadSceneTask}, [this]{ create_clusters(); })};
+        auto vertexBufferTask{startup.add("create_vertex_buffer", {loadSceneTask, textureImageTask}, [this]{ create_vertex_buffer(); })};
+        auto indexBufferTask{startup.add("create_index_buffer", {vertexBufferTask, clustersTask}, [this]{ create_index_buffer(); })};
+        auto objectBufferTask{startup.add("create_object_buffers", {indexBufferTask}, [this]{ create_object_buffers(); })};
+        auto clusterBufferTask{startup.add("create_cluster_buffer", {objectBufferTask}, [this]{ create_cluster_buffer(); })};
+        auto materialBufferTask{startup.add("create_material_buffer", {clusterBufferTask, decodeTexturesTask}, 
+                                            [this]{ create_material_buffer(); })};
+        auto drawBuffersTask{startup.add("create_draw_buffers", {logicalDeviceTask, clustersTask}, [this]{ create_draw_buffers(); })};
+        auto occlusionResourcesTask{startup.add("create_occlusion_resources", {materialBufferTask, depthPrePassTask}, 
+                                                [this]{ create_occlusion_resources(); })};
+        auto lightBuffersTask{startup.add("create_light_buffers", {occlusionResourcesTask}, 
+                                          [this]{ create_light_buffers(); })};
+
+        auto uniformBuffersTask{startup.add("create_uniform_buffers", {logicalDeviceTask}, [this]{ create_uniform_buffers(); })};
+        auto descriptorPoolTask{startup.add("create_descriptor_pool", {logicalDeviceTask}, [this]{ create_descriptor_pool(); })};
+        auto descriptorSetsTask{startup.add("create_descriptor_sets", {descriptorPoolTask, descriptorSetLayoutTask, uniformBuffersTask, textureImageViewTask, 
+                                                                       textureSamplerTask, drawBuffersTask, occlusionResourcesTask, 
+                                                                       materialBufferTask, lightBuffersTask}, 
+                                            [this]{ create_descriptor_sets(); })};
+        startup.add("create_hi_z_descriptor_sets", {descriptorSetsTask}, [this]{ create_hi_z_descriptor_sets(); });
+        startup.add("create_command_buffers", {lightBuffersTask}, [this]{ create_command_buffers(); });
+        startup.add("create_sync_objects", {logicalDeviceTask}, [this]{ create_sync_objects(); });
+        startup.add("create_timestamp_queries", {logicalDeviceTask}, [this]{ create_timestamp_queries(); });
+        startup.add("create_readback_buffers", {swapChainTask}, [this]{ create_readback_buffers(); });
+
+        startup.run(jobs, profiler);
+        profiler.write_startup_report(std::cout);
+
+        startTime = Profiler::Clock::now();
+        measurementStart = startTime;
+        previousFrameStart = startTime;
     }
     
     System::~System()
     {
-        cleanup_swap_chain();
+        // run() drains the GPU on the way out, but not when draw_frame threw; nothing below may be in use by the device.
+        vkDeviceWaitIdle(device);
 
-        vkDestroySampler(device, textureSampler, nullptr);
-        vkDestroyImageView(device, textureImageView, nullptr);
-        vkDestroyImage(device, textureImage, nullptr);
-        vkFreeMemory(device, textureImageMemory, nullptr);
-        
-        for(const auto i : std::views::iota(0, maxFramesInFlight))
+        // Encoders read straight out of the mapped readback buffers, so none may still run when those are freed.
+        for(auto& job : readbackJobs)
         {
-            vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-            vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+            try
+            {
+                jobs.wait_blocking(job);
+            }
+            catch(const std::exception& e)
+            {
+                std::println(std::cerr, "{}", e.what());
+            }
         }
+        // Hot reload may still have glslc running; let it finish writing before the renderer goes away.
+        jobs.wait_blocking(shaderCompileJobs);
+        wait_shader_rebuild();
+        if(shaderRebuild)
+        {
+            destroy_shader_rebuild(*shaderRebuild);
+        }
+        deletionQueue.flush();
+        cleanup_swap_chain();
 
-        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
-        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-
-        vkDestroyBuffer(device, indexBuffer, nullptr);
-        vkFreeMemory(device, indexBufferMemory, nullptr);
+        if(timestampQueryPool != VK_NULL_HANDLE)
+        {
+            vkDestroyQueryPool(device, timestampQueryPool, host_allocator(VK_OBJECT_TYPE_QUERY_POOL));
+        }
 
-        vkDestroyBuffer(device, vertexBuffer, nullptr);
-        vkFreeMemory(device, vertexBufferMemory, nullptr);
+        vkDestroyDescriptorPool(device, descriptorPool, host_allocator(VK_OBJECT_TYPE_DESCRIPTOR_POOL));
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, host_allocator(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
+        vkDestroyDescriptorSetLayout(device, hiZDescriptorSetLayout, host_allocator(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
 
         for(const auto i : std::views::iota(0, maxFramesInFlight))
         {
-            vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-            vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-            vkDestroyFence(device, inFlightFences[i], nullptr);
+            vkDestroySemaphore(device, imageAvailableSemaphores[i], host_allocator(VK_OBJECT_TYPE_SEMAPHORE));
+            vkDestroySemaphore(device, renderFinishedSemaphores[i], host_allocator(VK_OBJECT_TYPE_SEMAPHORE));
+            vkDestroyFence(device, inFlightFences[i], host_allocator(VK_OBJECT_TYPE_FENCE));
         }
 
-        vkDestroyPipeline(device, graphicsPipeline, nullptr);
-        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-
-        vkDestroyRenderPass(device, renderPass, nullptr);
-
-        vkDestroyCommandPool(device, commandPool, nullptr);
-        vkDestroyDevice(device, nullptr);
+        if(frameTimeline != VK_NULL_HANDLE)
+        {
+            vkDestroySemaphore(device, frameTimeline, host_allocator(VK_OBJECT_TYPE_SEMAPHORE));
+        }
 
-        if(enableValidationLayers)
+        for(const auto& [variant, pipeline] : graphicsPipelines)
         {
-            destroy_debug_utils_messenger_ext(instance, debugMessenger, nullptr);
+            vkDestroyPipeline(device, pipeline, host_allocator(VK_OBJECT_TYPE_PIPELINE));
         }
+        vkDestroyPipelineLayout(device, pipelineLayout, host_allocator(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+        vkDestroyPipeline(device, cullPipeline, host_allocator(VK_OBJECT_TYPE_PIPELINE));
+        vkDestroyPipelineLayout(device, cullPipelineLayout, host_allocator(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+        vkDestroyPipeline(device, hiZPipeline, host_allocator(VK_OBJECT_TYPE_PIPELINE));
+        vkDestroyPipelineLayout(device, hiZPipelineLayout, host_allocator(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+        vkDestroyPipeline(device, lightCullPipeline, host_allocator(VK_OBJECT_TYPE_PIPELINE));
+        vkDestroyPipelineLayout(device, lightCullPipelineLayout, host_allocator(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+        vkDestroyPipeline(device, depthPrePassPipeline, host_allocator(VK_OBJECT_TYPE_PIPELINE));
 
-        vkDestroySurfaceKHR(instance, surface, nullptr);
-        vkDestroyInstance(instance, nullptr);
+        vkDestroyRenderPass(device, renderPass, host_allocator(VK_OBJECT_TYPE_RENDER_PASS));
+        depthPrePassFrameBuffer.reset();
+        vkDestroyRenderPass(device, depthPrePass, host_allocator(VK_OBJECT_TYPE_RENDER_PASS));
 
-        glfwDestroyWindow(window);
-        glfwTerminate();
+        vkDestroyCommandPool(device, commandPool, host_allocator(VK_OBJECT_TYPE_COMMAND_POOL));
     }
 
     void System::run()
     {
-        while(!glfwWindowShouldClose(window))
+        while(!finished())
         {
-            glfwPollEvents();
+            if(!options.headless)
+            {
+                if(glfwWindowShouldClose(window.get()))
+                {
+                    break;
+                }
+                glfwPollEvents();
+                if(std::exchange(memoryReportRequested, false))
+                {
+                    write_memory_report(std::cout);
+                }
+            }
             draw_frame();
         }
 
         vkDeviceWaitIdle(device);
+
+        for(const auto i : std::views::iota(0, maxFramesInFlight))
+        {
+            read_gpu_time(i);
+            read_cull_statistics(i);
+        }
+        drain_readbacks();
     }  
 
+    bool System::finished() const
+    {
+        if(options.frameCount != 0 && frameNumber >= options.warmupFrames + options.frameCount)
+        {
+            return true;
+        }
+
+        if(options.duration > 0.0 && frameNumber > options.warmupFrames)
+        {
+            std::chrono::duration<double> elapsed{Profiler::Clock::now() - measurementStart};
+            return elapsed.count() >= options.duration;
+        }
+
+        return false;
+    }
+
+    MemoryUsage System::memory_usage() const
+    {
+        auto host{host_allocation_totals()};
+        return {memoryCounter.bytes(), memoryCounter.peak_bytes(), lazyMemoryCounter.bytes(), peak_resident_memory(), 
+                host.bytes, host.peakBytes};
+    }
+
+    Statistics System::gpu_frame_statistics() const
+    {
+        return profiler.gpu_statistics();
+    }
+
+    void System::write_report(std::ostream& out) const
+    {
+        std::array caches{textureCache.usage("textures"), samplerCache.usage("samplers")};
+        profiler.write_json(out, memory_usage(), caches, host_allocation_usage());
+    }
+
+    void System::write_memory_report(std::ostream& out) const
+    {
+        memoryRegistry.write_json(out);
+    }
+
     void System::create_window(const std::uint32_t width, const std::uint32_t height, const std::string_view name)
     {
+        if(options.headless)
+        {
+            return;
+        }
+
         glfwInit();
 
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
         //glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-        window = glfwCreateWindow(width, height, std::data(name), nullptr, nullptr);
-        glfwSetWindowUserPointer(window, this);
-        glfwSetFramebufferSizeCallback(window, &framebuffer_resize_callback);
+        window.reset(glfwCreateWindow(width, height, std::data(name), nullptr, nullptr));
+        glfwSetWindowUserPointer(window.get(), this);
+        glfwSetFramebufferSizeCallback(window.get(), &framebuffer_resize_callback);
+        glfwSetKeyCallback(window.get(), &key_callback);
         
     }
 
@@ -145,7 +296,7 @@ namespace app
         info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         info.pEngineName = "No Engine";
         info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        info.apiVersion = VK_API_VERSION_1_0;
+        info.apiVersion = VK_API_VERSION_1_2;
         info.pNext = nullptr;
 
         VkInstanceCreateInfo createInfo{};
@@ -172,11 +323,13 @@ namespace app
             createInfo.pNext = nullptr;
         }
 
-        if(VkResult result{vkCreateInstance(&createInfo, nullptr, &instance)}; 
+        VkInstance handle{};
+        if(VkResult result{vkCreateInstance(&createInfo, host_allocator(VK_OBJECT_TYPE_INSTANCE), &handle)}; 
            result != VK_SUCCESS)
         {
             throw std::runtime_error{"Error: failed to create instance."};
         }
+        instance = Instance{handle};
     }
 
     void System::show_extensions_support() const
@@ -224,10 +377,14 @@ namespace app
 
     std::vector<const char*> System::required_extensions() const
     {
-        std::uint32_t glfwExtensionCount{0};
-        const char** glfwExtensions{glfwGetRequiredInstanceExtensions(&glfwExtensionCount)};
+        std::vector<const char*> extensions{};
+        if(!options.headless)
+        {
+            std::uint32_t glfwExtensionCount{0};
+            const char** glfwExtensions{glfwGetRequiredInstanceExtensions(&glfwExtensionCount)};
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
 
-        std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
         if(enableValidationLayers)
         {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -258,10 +415,12 @@ namespace app
         VkDebugUtilsMessengerCreateInfoEXT createInfo{};
         populate_debug_messenger_create_info(createInfo);
 
-        if(create_debug_utils_messanger_ext(instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS)
+        VkDebugUtilsMessengerEXT handle{};
+        if(create_debug_utils_messanger_ext(instance, &createInfo, host_allocator(VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT), &handle) != VK_SUCCESS)
         {
             throw std::runtime_error{"Error: failed to set up debug messanger."};
         }
+        debugMessenger = DebugMessenger{instance, handle};
     }
 
     void System::populate_debug_messenger_create_info(VkDebugUtilsMessengerCreateInfoEXT& createInfo)
@@ -291,13 +450,19 @@ namespace app
         std::vector<VkPhysicalDevice> devices(deviceCount);
         vkEnumeratePhysicalDevices(instance, &deviceCount, std::data(devices));
 
+        std::uint64_t bestScore{0};
         for(const auto& device : devices)
         {
-            if(is_device_suitable(device))
+            if(!is_device_suitable(device))
+            {
+                continue;
+            }
+
+            auto score{score_device(device_traits(device))};
+            if(physicalDevice == VK_NULL_HANDLE || score > bestScore)
             {
                 physicalDevice = device;
-                msaaSamples = max_usable_sample_count();
-                break;
+                bestScore = score;
             }
         }
 
@@ -305,6 +470,322 @@ namespace app
         {
             throw std::runtime_error{"failed to find a suitable GPU"};
         }
+
+        query_device_features();
+
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        std::println("Using {} out of {} devices.", properties.deviceName, deviceCount);
+    }
+
+    DeviceTraits System::device_traits(VkPhysicalDevice device)
+    {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(device, &properties);
+
+        VkPhysicalDeviceMemoryProperties memoryProperties{};
+        vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        if(properties.apiVersion >= VK_API_VERSION_1_2)
+        {
+            features.pNext = &vulkan12Features;
+        }
+        vkGetPhysicalDeviceFeatures2(device, &features);
+
+        DeviceTraits traits{properties.deviceType, 0, features.features.multiDrawIndirect == VK_TRUE, 
+                            vulkan12Features.drawIndirectCount == VK_TRUE, vulkan12Features.timelineSemaphore == VK_TRUE};
+        for(std::uint32_t i{0}; i < memoryProperties.memoryHeapCount; ++i)
+        {
+            if(memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+            {
+                traits.localMemoryBytes += memoryProperties.memoryHeaps[i].size;
+            }
+        }
+        return traits;
+    }
+
+    void System::query_device_features()
+    {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+        supportedVulkan12Features = {};
+        supportedVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+        if(properties.apiVersion < VK_API_VERSION_1_2)
+        {
+            return;
+        }
+
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &supportedVulkan12Features;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+        supportedVulkan12Features.pNext = nullptr;
+    }
+
+    DeviceProfileKey System::device_profile_key()
+    {
+        VkPhysicalDeviceIDProperties idProperties{};
+        idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+        VkPhysicalDeviceProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &idProperties;
+        vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+        DeviceProfileKey key{{}, properties.properties.driverVersion};
+        std::ranges::copy(idProperties.deviceUUID, std::begin(key.deviceUuid));
+        return key;
+    }
+
+    void System::tune_device_profile()
+    {
+        std::vector<VkPresentModeKHR> presentModes{};
+        if(!options.headless)
+        {
+            presentModes = query_swap_chain_support(physicalDevice).presentModes;
+        }
+
+        auto key{device_profile_key()};
+        DeviceProfileCache cache{options.profileCachePath};
+        std::optional<DeviceProfile> profile{};
+        if(!options.retune)
+        {
+            profile = cache.find(key);
+        }
+        if(profile)
+        {
+            std::println("Loaded device profile from {}.", options.profileCachePath.string());
+        }
+        else
+        {
+            auto budget{options.gpuBudgetMilliseconds > 0.0 ? options.gpuBudgetMilliseconds : tuningFrameBudgetMilliseconds};
+            profile = choose_device_profile(measure_device(), presentModes, budget);
+            try
+            {
+                cache.store(key, *profile);
+            }
+            catch(const std::exception& e)
+            {
+                std::println(std::cerr, "{}", e.what());
+            }
+        }
+
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        if(!(properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts & profile->samples))
+        {
+            profile->samples = VK_SAMPLE_COUNT_1_BIT;
+        }
+
+        deviceProfile = *profile;
+        msaaSamples = deviceProfile.samples;
+        resolution = ResolutionController{{options.gpuBudgetMilliseconds, options.minimumRenderScale, msaaSamples}};
+        textureStreamer.set_upload_budget(deviceProfile.stagingBytes);
+        std::println("Device profile: {}x MSAA, present mode {}, {:.1f} MiB texture uploads per frame.", 
+                     static_cast<std::uint32_t>(deviceProfile.samples), static_cast<std::uint32_t>(deviceProfile.presentMode), 
+                     static_cast<double>(deviceProfile.stagingBytes) / (1 << 20));
+    }
+
+    TuningMeasurements System::measure_device()
+    {
+        TuningMeasurements measurements{};
+
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        VkSampleCountFlags counts{properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts};
+
+        // Clearing and resolving window-sized targets stands in for the bandwidth a sample count adds to every frame.
+        auto depthFormat{find_depth_format()};
+        Image resolveImage{};
+        Allocation resolveImageMemory{};
+        create_image(options.width, options.height, 1, VK_SAMPLE_COUNT_1_BIT, tuningColorFormat, VK_IMAGE_TILING_OPTIMAL, 
+                     VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, resolveImage, resolveImageMemory, 
+                     MemoryCategory::color, "tuning resolve");
+
+        for(auto samples : {VK_SAMPLE_COUNT_1_BIT, VK_SAMPLE_COUNT_2_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_8_BIT})
+        {
+            if(!(counts & samples))
+            {
+                continue;
+            }
+
+            Image colorImage{};
+            Allocation colorImageMemory{};
+            create_image(options.width, options.height, 1, samples, tuningColorFormat, VK_IMAGE_TILING_OPTIMAL, 
+                         VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, 
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImage, colorImageMemory, MemoryCategory::color, 
+                         std::format("tuning color {}x", static_cast<std::uint32_t>(samples)));
+
+            Image depthImage{};
+            Allocation depthImageMemory{};
+            create_image(options.width, options.height, 1, samples, depthFormat, VK_IMAGE_TILING_OPTIMAL, 
+                         VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, 
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory, MemoryCategory::depth, 
+                         std::format("tuning depth {}x", static_cast<std::uint32_t>(samples)));
+
+            auto milliseconds{time_commands([&](VkCommandBuffer commandBuffer)
+            {
+                for(std::uint32_t i{0}; i < tuningIterations; ++i)
+                {
+                    record_sample_cost(commandBuffer, colorImage, depthImage, depthFormat, resolveImage, samples);
+                }
+            })};
+            measurements.sampleCosts.push_back({samples, milliseconds / tuningIterations});
+        }
+
+        Buffer sourceBuffer{};
+        Allocation sourceBufferMemory{};
+        create_buffer(tuningUploadBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
+                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, sourceBuffer, sourceBufferMemory, MemoryCategory::staging, "tuning staging");
+
+        Buffer destinationBuffer{};
+        Allocation destinationBufferMemory{};
+        create_buffer(tuningUploadBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
+                      destinationBuffer, destinationBufferMemory, MemoryCategory::texture, "tuning upload");
+
+        auto milliseconds{time_commands([&](VkCommandBuffer commandBuffer)
+        {
+            VkBufferCopy copyRegion{0, 0, tuningUploadBytes};
+            for(std::uint32_t i{0}; i < tuningIterations; ++i)
+            {
+                vkCmdCopyBuffer(commandBuffer, sourceBuffer, destinationBuffer, 1, &copyRegion);
+            }
+        })};
+        measurements.uploadBytesPerMillisecond = static_cast<double>(tuningUploadBytes * tuningIterations) / std::max(milliseconds, 1e-3);
+
+        return measurements;
+    }
+
+    void System::record_sample_cost(VkCommandBuffer commandBuffer, VkImage colorImage, VkImage depthImage, VkFormat depthFormat, 
+                                    VkImage resolveImage, VkSampleCountFlagBits samples)
+    {
+        // Every iteration starts from undefined contents, as a frame whose attachments are cleared on load does.
+        std::array<VkImageMemoryBarrier, 3> clearBarriers{};
+        for(auto& barrier : clearBarriers)
+        {
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        }
+        clearBarriers[0].image = colorImage;
+        clearBarriers[1].image = depthImage;
+        clearBarriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        if(has_stencil_component(depthFormat))
+        {
+            clearBarriers[1].subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
+        clearBarriers[2].image = resolveImage;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 
+                             static_cast<std::uint32_t>(std::size(clearBarriers)), std::data(clearBarriers));
+
+        VkClearColorValue clearColor{{0.0f, 0.0f, 0.0f, 1.0f}};
+        VkImageSubresourceRange colorRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        vkCmdClearColorImage(commandBuffer, colorImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &colorRange);
+
+        VkClearDepthStencilValue clearDepth{1.0f, 0};
+        vkCmdClearDepthStencilImage(commandBuffer, depthImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearDepth, 1, 
+                                    &clearBarriers[1].subresourceRange);
+
+        VkImageMemoryBarrier resolveBarrier{clearBarriers[0]};
+        resolveBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        resolveBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        resolveBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        resolveBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 
+                             1, &resolveBarrier);
+
+        VkImageSubresourceLayers layers{VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        VkExtent3D extent{options.width, options.height, 1};
+        if(samples == VK_SAMPLE_COUNT_1_BIT)
+        {
+            VkImageCopy region{layers, {}, layers, {}, extent};
+            vkCmdCopyImage(commandBuffer, colorImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, resolveImage, 
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        }
+        else
+        {
+            VkImageResolve region{layers, {}, layers, {}, extent};
+            vkCmdResolveImage(commandBuffer, colorImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, resolveImage, 
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        }
+    }
+
+    double System::time_commands(const std::function<void(VkCommandBuffer)>& record)
+    {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        std::uint32_t queueFamilyCount{0};
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, std::data(queueFamilies));
+        auto validBits{queueFamilies[find_queue_families(physicalDevice).graphicsFamily.value()].timestampValidBits};
+
+        // Without timestamps the host clock around the submission is the fallback; it also counts the submit itself.
+        VkQueryPool queryPool{VK_NULL_HANDLE};
+        if(validBits != 0 && properties.limits.timestampPeriod != 0.0f)
+        {
+            VkQueryPoolCreateInfo queryPoolInfo{};
+            queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            queryPoolInfo.queryCount = 2;
+            if(vkCreateQueryPool(device, &queryPoolInfo, host_allocator(VK_OBJECT_TYPE_QUERY_POOL), &queryPool) != VK_SUCCESS)
+            {
+                throw std::runtime_error{"Error: failed to create tuning query pool."};
+            }
+        }
+
+        VkCommandBuffer commandBuffer{begin_single_time_commands()};
+        if(queryPool != VK_NULL_HANDLE)
+        {
+            vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+        }
+        record(commandBuffer);
+        if(queryPool != VK_NULL_HANDLE)
+        {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+        }
+
+        auto start{std::chrono::steady_clock::now()};
+        end_single_time_commands(commandBuffer);
+        double milliseconds{std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()};
+
+        if(queryPool != VK_NULL_HANDLE)
+        {
+            std::array<std::uint64_t, 2> timestamps{};
+            if(vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(timestamps), std::data(timestamps), sizeof(std::uint64_t), 
+                                     VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) == VK_SUCCESS)
+            {
+                auto mask{validBits == 64 ? std::numeric_limits<std::uint64_t>::max() : (std::uint64_t{1} << validBits) - 1};
+                milliseconds = ((timestamps[1] - timestamps[0]) & mask) * properties.limits.timestampPeriod / 1'000'000.0;
+            }
+            vkDestroyQueryPool(device, queryPool, host_allocator(VK_OBJECT_TYPE_QUERY_POOL));
+        }
+        return milliseconds;
+    }
+
+    std::vector<const char*> System::required_device_extensions() const
+    {
+        if(options.headless)
+        {
+            return {};
+        }
+        return {std::begin(deviceExtensions), std::end(deviceExtensions)};
     }
 
     bool System::check_device_extension_support(VkPhysicalDevice device)
@@ -315,7 +796,8 @@ namespace app
         std::vector<VkExtensionProperties> availableExtensions(extensionCount);
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, std::data(availableExtensions));
 
-        std::set<std::string_view> requiredExtensions(std::begin(deviceExtensions), std::end(deviceExtensions));
+        auto extensions{required_device_extensions()};
+        std::set<std::string_view> requiredExtensions(std::begin(extensions), std::end(extensions));
         for(const auto& extensions : availableExtensions)
         {
             requiredExtensions.erase(extensions.extensionName);
@@ -325,17 +807,11 @@ namespace app
 
     bool System::is_device_suitable(VkPhysicalDevice device)
     {
-        VkPhysicalDeviceProperties deviceProperties{};
-        vkGetPhysicalDeviceProperties(device, &deviceProperties);
-
-        VkPhysicalDeviceFeatures deviceFeatures{};
-        vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
-
         auto extensionsSupported{check_device_extension_support(device)};
 
-        bool swapChainAdequate{false};
+        bool swapChainAdequate{options.headless};
 
-        if(extensionsSupported)
+        if(extensionsSupported && !options.headless)
         {
             auto swapChainDetails{query_swap_chain_support(device)};
             swapChainAdequate = !std::empty(swapChainDetails.formats) && !std::empty(swapChainDetails.presentModes);
@@ -343,13 +819,14 @@ namespace app
 
         VkPhysicalDeviceFeatures supportedFeatures{};
         vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
-        
-        return deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
-               deviceFeatures.geometryShader &&
-               find_queue_families(device).is_complete() &&
+
+        // Only what the renderer cannot run without; device type and the rest are left to score_device.
+        return find_queue_families(device).is_complete() &&
                extensionsSupported &&
                swapChainAdequate &&
-               supportedFeatures.samplerAnisotropy;
+               supportedFeatures.samplerAnisotropy &&
+               supportedFeatures.shaderStorageImageWriteWithoutFormat &&
+               supportedFeatures.shaderStorageImageArrayDynamicIndexing;
     }
 
     QueueFamilyIndices System::find_queue_families(VkPhysicalDevice device)
@@ -370,7 +847,14 @@ namespace app
             }
 
             VkBool32 presentSupport{false};
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+            if(options.headless)
+            {
+                presentSupport = indices.graphicsFamily.has_value();
+            }
+            else
+            {
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+            }
 
             if(presentSupport)
             {
@@ -389,7 +873,7 @@ namespace app
     {
         auto indices{find_queue_families(physicalDevice)};
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos{};
-        std::vector<std::uint32_t> uniqueQueueFamilies{indices.graphicsFamily.value(), indices.presentFamily.value()};
+        std::set<std::uint32_t> uniqueQueueFamilies{indices.graphicsFamily.value(), indices.presentFamily.value()};
 
         float queuePriority{1.0f};
         for(const auto queueFamily : uniqueQueueFamilies)
@@ -406,14 +890,27 @@ namespace app
         VkPhysicalDeviceFeatures deviceFeatures{};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
         deviceFeatures.sampleRateShading = VK_TRUE;
+        deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+        deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+        deviceFeatures.shaderStorageImageWriteWithoutFormat = VK_TRUE;
+        deviceFeatures.shaderStorageImageArrayDynamicIndexing = VK_TRUE;
+
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        vulkan12Features.timelineSemaphore = supportedVulkan12Features.timelineSemaphore;
+        vulkan12Features.drawIndirectCount = supportedVulkan12Features.drawIndirectCount;
 
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        createInfo.pNext = properties.apiVersion >= VK_API_VERSION_1_2 ? &vulkan12Features : nullptr;
         createInfo.queueCreateInfoCount = std::size(queueCreateInfos);
         createInfo.pQueueCreateInfos = std::data(queueCreateInfos);
         createInfo.pEnabledFeatures = &deviceFeatures;
-        createInfo.enabledExtensionCount = static_cast<std::uint32_t>(std::size(deviceExtensions));
-        createInfo.ppEnabledExtensionNames = std::data(deviceExtensions);
+        auto extensions{required_device_extensions()};
+        createInfo.enabledExtensionCount = static_cast<std::uint32_t>(std::size(extensions));
+        createInfo.ppEnabledExtensionNames = std::data(extensions);
 
         if(enableValidationLayers)
         {
@@ -422,24 +919,43 @@ namespace app
         }
         else
         {
-            createInfo.enabledLayerCount = std::size(validationLayers);
+            createInfo.enabledLayerCount = 0;
         }
 
-        if(vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS)
+        VkDevice handle{};
+        if(vkCreateDevice(physicalDevice, &createInfo, host_allocator(VK_OBJECT_TYPE_DEVICE), &handle) != VK_SUCCESS)
         {
             throw std::runtime_error{"Error: failed to create logical device."};
         }
+        device = Device{handle};
 
         vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
         vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+
+        VkPhysicalDeviceMemoryProperties memoryProperties{};
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+        memoryRegistry.set_heaps({memoryProperties.memoryHeaps, memoryProperties.memoryHeapCount});
+
+        // The debug utils extension is only enabled alongside the validation layers.
+        if(enableValidationLayers)
+        {
+            setDebugUtilsObjectName = reinterpret_cast<PFN_vkSetDebugUtilsObjectNameEXT>(vkGetInstanceProcAddr(instance, "vkSetDebugUtilsObjectNameEXT"));
+        }
     }
 
     void System::create_surface()
     {
-        if(glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS)
+        if(options.headless)
+        {
+            return;
+        }
+
+        VkSurfaceKHR handle{};
+        if(glfwCreateWindowSurface(instance, window.get(), host_allocator(VK_OBJECT_TYPE_SURFACE_KHR), &handle) != VK_SUCCESS)
         {
             throw std::runtime_error{"Error: failed to create window surface."};
         }
+        surface = Surface{instance, handle};
     }
 
     VkSurfaceFormatKHR System::choose_swap_surface_format(const std::vector<VkSurfaceFormatKHR>& availableFormats) const
@@ -457,12 +973,10 @@ namespace app
     
     VkPresentModeKHR System::choose_swap_present_mode(const std::vector<VkPresentModeKHR>& availablePresentModes) const
     {
-        for(const auto& availablePresentMode : availablePresentModes)
+        // A cached profile can outlive a surface that offered its mode; FIFO is always there.
+        if(std::ranges::find(availablePresentModes, deviceProfile.presentMode) != std::end(availablePresentModes))
         {
-            if(availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
-            {
-                return availablePresentMode;
-            }
+            return deviceProfile.presentMode;
         }
 
         return VK_PRESENT_MODE_FIFO_KHR;
@@ -481,12 +995,12 @@ namespace app
             std::int32_t height;
         } size;
 
-        glfwGetFramebufferSize(window, &size.width, &size.height);
+        glfwGetFramebufferSize(window.get(), &size.width, &size.height);
 
         VkExtent2D actualExtent{static_cast<std::uint32_t>(size.width), 
                                 static_cast<std::uint32_t>(size.height)};
         actualExtent.width = std::clamp(actualExtent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
-        actualExtent.width = std::clamp(actualExtent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+        actualExtent.height = std::clamp(actualExtent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
         return actualExtent;
     }
 
@@ -518,12 +1032,23 @@ namespace app
 
     void System::create_swap_chain()
     {
+        if(options.headless)
+        {
+            create_offscreen_targets();
+            return;
+        }
+
         auto swapChainSupport{query_swap_chain_support(physicalDevice)};
 
         auto surfaceFormat{choose_swap_surface_format(swapChainSupport.formats)};
         auto presentMode{choose_swap_present_mode(swapChainSupport.presentModes)};
         auto extent{choose_swap_extent(swapChainSupport.capabilities)};
 
+        if(!(swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT))
+        {
+            throw std::runtime_error{"Error: swap chain images cannot be used as a blit destination."};
+        }
+
         auto imageCount{swapChainSupport.capabilities.minImageCount + 1};
         if(swapChainSupport.capabilities.maxImageCount > 0 &&
            imageCount > swapChainSupport.capabilities.maxImageCount)
@@ -538,7 +1063,15 @@ namespace app
         createInfo.imageFormat = surfaceFormat.format;
         createInfo.imageExtent = extent;
         createInfo.imageArrayLayers = 1;
-        createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        createInfo.imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        if(capturing())
+        {
+            if(!(swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+            {
+                throw std::runtime_error{"Error: swap chain images cannot be captured."};
+            }
+            createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
 
         auto indices{find_queue_families(physicalDevice)};
         std::vector<std::uint32_t> queueFamilyIndices{indices.graphicsFamily.value(), indices.presentFamily.value()};
@@ -559,13 +1092,23 @@ namespace app
         createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
         createInfo.presentMode = presentMode;
         createInfo.clipped = VK_TRUE;
-        createInfo.oldSwapchain = VK_NULL_HANDLE;
+        createInfo.oldSwapchain = swapChain;
 
-        if(vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS)
+        VkSwapchainKHR newSwapChain{};
+        if(vkCreateSwapchainKHR(device, &createInfo, host_allocator(VK_OBJECT_TYPE_SWAPCHAIN_KHR), &newSwapChain) != VK_SUCCESS)
         {
             throw std::runtime_error{"Error: failed to create swap chain."};
         }
 
+        if(swapChain != VK_NULL_HANDLE)
+        {
+            deletionQueue.push(frameNumber, [this, oldSwapChain = swapChain]
+            {
+                vkDestroySwapchainKHR(device, oldSwapChain, host_allocator(VK_OBJECT_TYPE_SWAPCHAIN_KHR));
+            });
+        }
+        swapChain = newSwapChain;
+
         vkGetSwapchainImagesKHR(device, swapChain, &imageCount, nullptr);
         swapChainImages.resize(imageCount);
         vkGetSwapchainImagesKHR(device, swapChain, &imageCount, std::data(swapChainImages));
@@ -574,27 +1117,41 @@ namespace app
         swapChainExtent = extent;
     }
 
-    void System::cleanup_swap_chain()
+    void System::create_offscreen_targets()
     {
-        vkDestroyImageView(device, colorImageView, nullptr);
-        vkDestroyImage(device, colorImage, nullptr);
-        vkFreeMemory(device, colorImageMemory, nullptr);
+        swapChainImageFormat = VK_FORMAT_R8G8B8A8_SRGB;
+        swapChainExtent = {options.width, options.height};
 
-        vkDestroyImageView(device, depthImageView, nullptr);
-        vkDestroyImage(device, depthImage, nullptr);
-        vkFreeMemory(device, depthImageMemory, nullptr);
+        swapChainImages.resize(maxFramesInFlight);
+        offscreenImages.resize(maxFramesInFlight);
+        offscreenImagesMemory.resize(maxFramesInFlight);
 
-        for(auto framebuffer : swapChainFrameBuffers)
+        for(const auto i : std::views::iota(0, maxFramesInFlight))
         {
-            vkDestroyFramebuffer(device, framebuffer, nullptr);
+            create_image(swapChainExtent.width, swapChainExtent.height, 1, VK_SAMPLE_COUNT_1_BIT, swapChainImageFormat, VK_IMAGE_TILING_OPTIMAL,
+                         VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
+                         offscreenImages[i], offscreenImagesMemory[i], MemoryCategory::color, std::format("offscreen image {}", i));
+            swapChainImages[i] = offscreenImages[i];
         }
+    }
+
+    void System::cleanup_swap_chain()
+    {
+        sceneFrameBuffer.reset();
 
-        for(auto imageView : swapChainImageViews)
+        if(swapChain != VK_NULL_HANDLE)
         {
-            vkDestroyImageView(device, imageView, nullptr);
+            vkDestroySwapchainKHR(device, swapChain, host_allocator(VK_OBJECT_TYPE_SWAPCHAIN_KHR));
+            swapChain = VK_NULL_HANDLE;
         }
+    }
 
-        vkDestroySwapchainKHR(device, swapChain, nullptr);
+    void System::retire_render_targets()
+    {
+        deletionQueue.retire(frameNumber, std::move(sceneFrameBuffer),
+                             std::move(colorImageView), std::move(colorImage), std::move(colorImageMemory),
+                             std::move(sceneColorImageView), std::move(sceneColorImage), std::move(sceneColorImageMemory),
+                             std::move(depthImageView), std::move(depthImage), std::move(depthImageMemory));
     }
 
     void System::recreate_swap_chain()
@@ -605,41 +1162,88 @@ namespace app
             std::int32_t height;
         } size;
 
-        glfwGetFramebufferSize(window, &size.width, &size.height);
+        glfwGetFramebufferSize(window.get(), &size.width, &size.height);
         while(size.width == 0 || size.height ==0)
         {
-            glfwGetFramebufferSize(window, &size.width, &size.height);
+            glfwGetFramebufferSize(window.get(), &size.width, &size.height);
             glfwWaitEvents();
         }
-        
-        vkDeviceWaitIdle(device);
 
-        cleanup_swap_chain();
+        retire_render_targets();
 
         create_swap_chain();
-        create_image_views();
         create_color_resources();
         create_depth_resources();
-        create_frame_buffers();
+        create_frame_buffer();
+        report_transient_attachments();
     }
 
-    void System::create_image_views()
+    void System::recreate_render_targets()
     {
-        swapChainImageViews.resize(std::size(swapChainImages));
+        // A rebuild in flight targets the render pass about to be replaced. This is the one place a reload can block
+        // the render loop, and only when the resolution changes while shaders are being rebuilt.
+        wait_shader_rebuild();
+        finish_shader_rebuild();
 
-        for(const auto i : std::views::iota(0ull, std::size(swapChainImages)))
+        retire_render_targets();
+        deletionQueue.push(frameNumber, [this, oldPipelines = std::move(graphicsPipelines), oldRenderPass = renderPass]
         {
-            swapChainImageViews[i] = create_image_view(swapChainImages[i], swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
-        }
-    }
+            for(const auto& [variant, pipeline] : oldPipelines)
+            {
+                vkDestroyPipeline(device, pipeline, host_allocator(VK_OBJECT_TYPE_PIPELINE));
+            }
+            vkDestroyRenderPass(device, oldRenderPass, host_allocator(VK_OBJECT_TYPE_RENDER_PASS));
+        });
+        graphicsPipelines.clear();
 
-    void System::create_descriptor_set_layout()
-    {
-        VkDescriptorSetLayoutBinding uboLayoutBinding{};
+        msaaSamples = resolution.samples();
+        create_render_pass();
+        create_graphics_pipeline();
+        create_color_resources();
+        create_depth_resources();
+        create_frame_buffer();
+        report_transient_attachments();
+    }
+
+    std::uint64_t System::completed_frames() const
+    {
+        if(frameTimeline != VK_NULL_HANDLE)
+        {
+            std::uint64_t value{0};
+            vkGetSemaphoreCounterValue(device, frameTimeline, &value);
+            return value;
+        }
+
+        if(frameNumber < static_cast<std::uint64_t>(maxFramesInFlight))
+        {
+            return 0;
+        }
+        return frameNumber - maxFramesInFlight + 1;
+    }
+
+    void System::name_object(VkObjectType objectType, std::uint64_t handle, std::string_view objectName)
+    {
+        if(setDebugUtilsObjectName == nullptr)
+        {
+            return;
+        }
+
+        std::string terminatedName{objectName};
+        VkDebugUtilsObjectNameInfoEXT nameInfo{};
+        nameInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+        nameInfo.objectType = objectType;
+        nameInfo.objectHandle = handle;
+        nameInfo.pObjectName = terminatedName.c_str();
+        setDebugUtilsObjectName(device, &nameInfo);
+    }
+
+    void System::create_descriptor_set_layout()
+    {
+        VkDescriptorSetLayoutBinding uboLayoutBinding{};
         uboLayoutBinding.binding = 0;
         uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
         uboLayoutBinding.descriptorCount = 1;
-        uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
         uboLayoutBinding.pImmutableSamplers = nullptr;
 
         VkDescriptorSetLayoutBinding samplerLayoutBinding{};
@@ -649,37 +1253,339 @@ namespace app
         samplerLayoutBinding.pImmutableSamplers = nullptr;
         samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-        std::array<VkDescriptorSetLayoutBinding, 2> bindings{uboLayoutBinding, samplerLayoutBinding};
+        VkDescriptorSetLayoutBinding objectLayoutBinding{};
+        objectLayoutBinding.binding = 2;
+        objectLayoutBinding.descriptorCount = 1;
+        objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        objectLayoutBinding.pImmutableSamplers = nullptr;
+        objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutBinding drawCommandLayoutBinding{};
+        drawCommandLayoutBinding.binding = 3;
+        drawCommandLayoutBinding.descriptorCount = 1;
+        drawCommandLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        drawCommandLayoutBinding.pImmutableSamplers = nullptr;
+        drawCommandLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutBinding drawCountLayoutBinding{};
+        drawCountLayoutBinding.binding = 4;
+        drawCountLayoutBinding.descriptorCount = 1;
+        drawCountLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        drawCountLayoutBinding.pImmutableSamplers = nullptr;
+        drawCountLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutBinding clusterLayoutBinding{};
+        clusterLayoutBinding.binding = 5;
+        clusterLayoutBinding.descriptorCount = 1;
+        clusterLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        clusterLayoutBinding.pImmutableSamplers = nullptr;
+        clusterLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutBinding visibilityLayoutBinding{};
+        visibilityLayoutBinding.binding = 6;
+        visibilityLayoutBinding.descriptorCount = 1;
+        visibilityLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        visibilityLayoutBinding.pImmutableSamplers = nullptr;
+        visibilityLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutBinding hiZLayoutBinding{};
+        hiZLayoutBinding.binding = 7;
+        hiZLayoutBinding.descriptorCount = 1;
+        hiZLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        hiZLayoutBinding.pImmutableSamplers = nullptr;
+        hiZLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutBinding materialLayoutBinding{};
+        materialLayoutBinding.binding = 8;
+        materialLayoutBinding.descriptorCount = 1;
+        materialLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        materialLayoutBinding.pImmutableSamplers = nullptr;
+        materialLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        VkDescriptorSetLayoutBinding lightLayoutBinding{};
+        lightLayoutBinding.binding = 9;
+        lightLayoutBinding.descriptorCount = 1;
+        lightLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        lightLayoutBinding.pImmutableSamplers = nullptr;
+        lightLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutBinding lightGridLayoutBinding{};
+        lightGridLayoutBinding.binding = 10;
+        lightGridLayoutBinding.descriptorCount = 1;
+        lightGridLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        lightGridLayoutBinding.pImmutableSamplers = nullptr;
+        lightGridLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutBinding lightIndexLayoutBinding{};
+        lightIndexLayoutBinding.binding = 11;
+        lightIndexLayoutBinding.descriptorCount = 1;
+        lightIndexLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        lightIndexLayoutBinding.pImmutableSamplers = nullptr;
+        lightIndexLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+        std::array<VkDescriptorSetLayoutBinding, 12> bindings{uboLayoutBinding, samplerLayoutBinding, objectLayoutBinding, 
+                                                              drawCommandLayoutBinding, drawCountLayoutBinding, clusterLayoutBinding, 
+                                                              visibilityLayoutBinding, hiZLayoutBinding, materialLayoutBinding, 
+                                                              lightLayoutBinding, lightGridLayoutBinding, lightIndexLayoutBinding};
         VkDescriptorSetLayoutCreateInfo layoutInfo{};
         layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
         layoutInfo.bindingCount = static_cast<std::uint32_t>(std::size(bindings));
         layoutInfo.pBindings = std::data(bindings);
 
-        if(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+        if(vkCreateDescriptorSetLayout(device, &layoutInfo, host_allocator(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT), &descriptorSetLayout) != VK_SUCCESS)
         {
             throw std::runtime_error{"Error: failed to create descriptor set layout."};
         }
+
+        VkDescriptorSetLayoutBinding hiZSourceLayoutBinding{};
+        hiZSourceLayoutBinding.binding = 0;
+        hiZSourceLayoutBinding.descriptorCount = 1;
+        hiZSourceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        hiZSourceLayoutBinding.pImmutableSamplers = nullptr;
+        hiZSourceLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutBinding hiZDestinationLayoutBinding{};
+        hiZDestinationLayoutBinding.binding = 1;
+        hiZDestinationLayoutBinding.descriptorCount = downsampleDestinationCount;
+        hiZDestinationLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        hiZDestinationLayoutBinding.pImmutableSamplers = nullptr;
+        hiZDestinationLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutBinding hiZScratchLayoutBinding{};
+        hiZScratchLayoutBinding.binding = 2;
+        hiZScratchLayoutBinding.descriptorCount = 1;
+        hiZScratchLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        hiZScratchLayoutBinding.pImmutableSamplers = nullptr;
+        hiZScratchLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        std::array<VkDescriptorSetLayoutBinding, 3> hiZBindings{hiZSourceLayoutBinding, hiZDestinationLayoutBinding, hiZScratchLayoutBinding};
+        layoutInfo.bindingCount = static_cast<std::uint32_t>(std::size(hiZBindings));
+        layoutInfo.pBindings = std::data(hiZBindings);
+
+        if(vkCreateDescriptorSetLayout(device, &layoutInfo, host_allocator(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT), &hiZDescriptorSetLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error{"Error: failed to create Hi-Z descriptor set layout."};
+        }
+    }
+
+    void System::read_shaders()
+    {
+        std::filesystem::path directory{shaderDirectory};
+        vertexShaderCode = file::read_file(directory / "shader.vert.spv");
+        fragmentShaderCode = file::read_file(directory / "shader.frag.spv");
+        cullShaderCode = file::read_file(directory / "cull.comp.spv");
+        downsampleShaderCode = file::read_file(directory / "downsample.comp.spv");
+        lightCullShaderCode = file::read_file(directory / "light_cull.comp.spv");
+    }
+
+    void System::create_shader_watcher()
+    {
+        if(options.hotReload)
+        {
+            shaderWatcher.emplace(std::vector<std::filesystem::path>{shaderSourceDirectory, shaderDirectory});
+        }
+    }
+
+    void System::poll_shader_reload()
+    {
+        if(!shaderWatcher)
+        {
+            return;
+        }
+
+        // Edited sources are recompiled into the SPIR-V directory, and the rebuild follows once glslc has written it.
+        for(const auto& path : shaderWatcher->poll())
+        {
+            auto extension{path.extension()};
+            auto fileName{path.filename()};
+            if(extension == ".vert" || extension == ".frag")
+            {
+                compile_shader(path);
+            }
+            else if(fileName == "shader.vert.spv" || fileName == "shader.frag.spv")
+            {
+                shaderRebuildQueued = true;
+            }
+        }
+
+        if(shaderRebuildRunning && shaderRebuildJob.done())
+        {
+            wait_shader_rebuild();
+            finish_shader_rebuild();
+        }
+
+        if(shaderRebuildQueued && !shaderRebuildRunning)
+        {
+            start_shader_rebuild();
+        }
+    }
+
+    void System::compile_shader(const std::filesystem::path& source)
+    {
+        auto binary{std::filesystem::path{shaderDirectory} / source.filename()};
+        binary += ".spv";
+        auto command{std::format("\"{}\" --target-env=vulkan1.2 -O \"{}\" -o \"{}\"", shaderCompiler, source.string(), binary.string())};
+        jobs.submit(shaderCompileJobs, [command = std::move(command), name = source.filename().string()]
+        {
+            // glslc leaves the previous binary in place on errors, so the running pipelines stay as they were.
+            if(std::system(command.c_str()) != 0)
+            {
+                std::println(std::cerr, "Error: failed to compile {}.", name);
+            }
+        });
+    }
+
+    void System::start_shader_rebuild()
+    {
+        std::vector<ShaderVariantKey> variants{};
+        for(const auto& [variant, pipeline] : graphicsPipelines)
+        {
+            variants.push_back(variant);
+        }
+        auto depthVariant{options.shaderVariant.only({ShaderFeature::quantized, ShaderFeature::instanced})};
+
+        shaderRebuildQueued = false;
+        shaderRebuildRunning = true;
+        jobs.submit(shaderRebuildJob, [this, variants = std::move(variants), depthVariant, targetRenderPass = renderPass, samples = msaaSamples]
+        {
+            std::filesystem::path directory{shaderDirectory};
+            ShaderRebuild rebuild{file::read_file(directory / "shader.vert.spv"), file::read_file(directory / "shader.frag.spv"), {}, VK_NULL_HANDLE};
+            try
+            {
+                for(auto variant : variants)
+                {
+                    rebuild.graphicsPipelines[variant] = create_mesh_pipeline(targetRenderPass, samples, false, variant, 
+                                                                              rebuild.vertexCode, rebuild.fragmentCode);
+                }
+                rebuild.depthPrePassPipeline = create_mesh_pipeline(depthPrePass, VK_SAMPLE_COUNT_1_BIT, true, depthVariant, 
+                                                                    rebuild.vertexCode, rebuild.fragmentCode);
+            }
+            catch(...)
+            {
+                destroy_shader_rebuild(rebuild);
+                throw;
+            }
+            shaderRebuild = std::move(rebuild);
+        });
+    }
+
+    void System::finish_shader_rebuild()
+    {
+        if(!shaderRebuild)
+        {
+            return;
+        }
+
+        // Frames still in flight may be using the old pipelines, so they retire with the frame about to be recorded.
+        deletionQueue.push(frameNumber, [this, oldPipelines = std::move(graphicsPipelines), oldDepthPrePassPipeline = depthPrePassPipeline]
+        {
+            for(const auto& [variant, pipeline] : oldPipelines)
+            {
+                vkDestroyPipeline(device, pipeline, host_allocator(VK_OBJECT_TYPE_PIPELINE));
+            }
+            vkDestroyPipeline(device, oldDepthPrePassPipeline, host_allocator(VK_OBJECT_TYPE_PIPELINE));
+        });
+
+        graphicsPipelines = std::move(shaderRebuild->graphicsPipelines);
+        depthPrePassPipeline = shaderRebuild->depthPrePassPipeline;
+        vertexShaderCode = std::move(shaderRebuild->vertexCode);
+        fragmentShaderCode = std::move(shaderRebuild->fragmentCode);
+        shaderRebuild.reset();
+        std::println("Reloaded shaders.");
+    }
+
+    void System::wait_shader_rebuild()
+    {
+        if(!shaderRebuildRunning)
+        {
+            return;
+        }
+
+        shaderRebuildRunning = false;
+        try
+        {
+            jobs.wait_blocking(shaderRebuildJob);
+        }
+        catch(const std::exception& e)
+        {
+            std::println(std::cerr, "{} Keeping the current shaders.", e.what());
+        }
+    }
+
+    void System::destroy_shader_rebuild(const ShaderRebuild& rebuild)
+    {
+        for(const auto& [variant, pipeline] : rebuild.graphicsPipelines)
+        {
+            vkDestroyPipeline(device, pipeline, host_allocator(VK_OBJECT_TYPE_PIPELINE));
+        }
+        vkDestroyPipeline(device, rebuild.depthPrePassPipeline, host_allocator(VK_OBJECT_TYPE_PIPELINE));
+    }
+
+    void System::create_pipeline_layout()
+    {
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 0;
+        pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+        if(vkCreatePipelineLayout(device, &pipelineLayoutInfo, host_allocator(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &pipelineLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error{"Error: failed to create pipeline."};
+        }
     }
 
     void System::create_graphics_pipeline()
     {
-        auto vertexShaderCode{file::read_file("../shader/vert.spv")};
-        auto fragmentShaderCode{file::read_file("../shader/frag.spv")};
+        graphics_pipeline(options.shaderVariant);
+    }
+
+    VkPipeline System::graphics_pipeline(ShaderVariantKey variant)
+    {
+        // Variants other than the startup one are specialized on first use.
+        if(auto found{graphicsPipelines.find(variant)}; found != std::end(graphicsPipelines))
+        {
+            return found->second;
+        }
+        return graphicsPipelines[variant] = create_mesh_pipeline(renderPass, msaaSamples, false, variant);
+    }
+
+    void System::create_depth_pre_pass_pipeline()
+    {
+        // Only the features that move vertices matter without a fragment stage.
+        auto variant{options.shaderVariant.only({ShaderFeature::quantized, ShaderFeature::instanced})};
+        depthPrePassPipeline = create_mesh_pipeline(depthPrePass, VK_SAMPLE_COUNT_1_BIT, true, variant);
+    }
+
+    VkPipeline System::create_mesh_pipeline(VkRenderPass targetRenderPass, VkSampleCountFlagBits samples, bool depthOnly, 
+                                            ShaderVariantKey variant)
+    {
+        return create_mesh_pipeline(targetRenderPass, samples, depthOnly, variant, vertexShaderCode, fragmentShaderCode);
+    }
+
+    VkPipeline System::create_mesh_pipeline(VkRenderPass targetRenderPass, VkSampleCountFlagBits samples, bool depthOnly, 
+                                            ShaderVariantKey variant, const std::vector<char>& vertexCode, 
+                                            const std::vector<char>& fragmentCode)
+    {
+        ShaderSpecialization specialization{variant};
 
-        auto vertexShaderModule{create_shader_module(vertexShaderCode)};
-        auto fragmentShaderModule{create_shader_module(fragmentShaderCode)};
+        auto vertexShaderModule{create_shader_module(vertexCode)};
+        auto fragmentShaderModule{create_shader_module(fragmentCode)};
 
         VkPipelineShaderStageCreateInfo vertexShaderCreateInfo{};
         vertexShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
         vertexShaderCreateInfo.module = vertexShaderModule;
         vertexShaderCreateInfo.pName = "main";
+        vertexShaderCreateInfo.pSpecializationInfo = specialization.info();
 
         VkPipelineShaderStageCreateInfo fragmentShaderCreateInfo{};
         fragmentShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
         fragmentShaderCreateInfo.module = fragmentShaderModule;
         fragmentShaderCreateInfo.pName = "main";
+        fragmentShaderCreateInfo.pSpecializationInfo = specialization.info();
 
         std::vector<VkPipelineShaderStageCreateInfo> shaderStages{vertexShaderCreateInfo, fragmentShaderCreateInfo};
 
@@ -690,8 +1596,9 @@ namespace app
         dynamicState.dynamicStateCount = static_cast<std::uint32_t>(std::size(dynamicStates));
         dynamicState.pDynamicStates = std::data(dynamicStates);
 
-        auto bindingDescription{Vertex::binding_description()};
-        auto attributeDescription{Vertex::attribute_description()};
+        auto quantized{variant.has(ShaderFeature::quantized)};
+        auto bindingDescription{quantized ? QuantizedVertex::binding_description() : Vertex::binding_description()};
+        auto attributeDescription{quantized ? QuantizedVertex::attribute_description() : Vertex::attribute_description()};
 
         VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -705,24 +1612,13 @@ namespace app
         inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-        VkViewport viewport{};
-        viewport.x = 0.0f; 
-        viewport.y = 0.0f; 
-        viewport.width = static_cast<float>(swapChainExtent.width); 
-        viewport.height = static_cast<float>(swapChainExtent.height); 
-        viewport.maxDepth = 0.0f; 
-        viewport.maxDepth = 1.0f; 
-
-        VkRect2D scissor{};
-        scissor.offset = {0, 0};
-        scissor.extent = swapChainExtent;
-
+        // Viewport and scissor are dynamic, so the pipeline does not depend on the render resolution.
         VkPipelineViewportStateCreateInfo viewportState{};
         viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
         viewportState.viewportCount = 1;
-        viewportState.pViewports = &viewport;
+        viewportState.pViewports = nullptr;
         viewportState.scissorCount = 1;
-        viewportState.pScissors = &scissor;
+        viewportState.pScissors = nullptr;
 
         VkPipelineRasterizationStateCreateInfo rasterizer{};
         rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -739,8 +1635,8 @@ namespace app
 
         VkPipelineMultisampleStateCreateInfo multisampling{};
         multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-        multisampling.sampleShadingEnable = VK_TRUE;
-        multisampling.rasterizationSamples = msaaSamples;
+        multisampling.sampleShadingEnable = depthOnly ? VK_FALSE : VK_TRUE;
+        multisampling.rasterizationSamples = samples;
         multisampling.minSampleShading = 0.2f;
         multisampling.pSampleMask = nullptr;
         multisampling.alphaToCoverageEnable = VK_FALSE;
@@ -775,28 +1671,16 @@ namespace app
         colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
         colorBlending.logicOpEnable = VK_FALSE;
         colorBlending.logicOp = VK_LOGIC_OP_COPY;
-        colorBlending.attachmentCount = 1;
+        colorBlending.attachmentCount = depthOnly ? 0 : 1;
         colorBlending.pAttachments = &colorBlendAttachment;
         colorBlending.blendConstants[0] = 0.0f;
         colorBlending.blendConstants[1] = 0.0f;
         colorBlending.blendConstants[2] = 0.0f;
         colorBlending.blendConstants[3] = 0.0f;
 
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 1;
-        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-        pipelineLayoutInfo.pushConstantRangeCount = 0;
-        pipelineLayoutInfo.pPushConstantRanges = nullptr;
-
-        if(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
-        {
-            throw std::runtime_error{"Error: failed to create pipeline."};
-        }
-
         VkGraphicsPipelineCreateInfo pipelineInfo{};
         pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipelineInfo.stageCount = 2;
+        pipelineInfo.stageCount = depthOnly ? 1 : 2;
         pipelineInfo.pStages = std::data(shaderStages);
         pipelineInfo.pVertexInputState = &vertexInputInfo;
         pipelineInfo.pInputAssemblyState = &inputAssembly;
@@ -807,18 +1691,143 @@ namespace app
         pipelineInfo.pColorBlendState = &colorBlending;
         pipelineInfo.pDynamicState = &dynamicState;
         pipelineInfo.layout = pipelineLayout;
-        pipelineInfo.renderPass = renderPass;
+        pipelineInfo.renderPass = targetRenderPass;
         pipelineInfo.subpass = 0;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
         pipelineInfo.basePipelineIndex = -1;
 
-        if(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+        VkPipeline pipeline{VK_NULL_HANDLE};
+        auto result{vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, host_allocator(VK_OBJECT_TYPE_PIPELINE), &pipeline)};
+
+        vkDestroyShaderModule(device, vertexShaderModule, host_allocator(VK_OBJECT_TYPE_SHADER_MODULE));
+        vkDestroyShaderModule(device, fragmentShaderModule, host_allocator(VK_OBJECT_TYPE_SHADER_MODULE));
+
+        if(result != VK_SUCCESS)
         {
             throw std::runtime_error{"Error: failed to create graphics pipeline."};
         }
+        return pipeline;
+    }
+
+    void System::create_cull_pipeline()
+    {
+        auto cullShaderModule{create_shader_module(cullShaderCode)};
+
+        VkPipelineShaderStageCreateInfo cullShaderCreateInfo{};
+        cullShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        cullShaderCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        cullShaderCreateInfo.module = cullShaderModule;
+        cullShaderCreateInfo.pName = "main";
+
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(CullConstants);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if(vkCreatePipelineLayout(device, &pipelineLayoutInfo, host_allocator(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &cullPipelineLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error{"Error: failed to create cull pipeline layout."};
+        }
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage = cullShaderCreateInfo;
+        pipelineInfo.layout = cullPipelineLayout;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+        pipelineInfo.basePipelineIndex = -1;
+
+        if(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, host_allocator(VK_OBJECT_TYPE_PIPELINE), &cullPipeline) != VK_SUCCESS)
+        {
+            throw std::runtime_error{"Error: failed to create cull pipeline."};
+        }
+
+        vkDestroyShaderModule(device, cullShaderModule, host_allocator(VK_OBJECT_TYPE_SHADER_MODULE));
+    }
+
+    void System::create_hi_z_pipeline()
+    {
+        auto hiZShaderModule{create_shader_module(downsampleShaderCode)};
+
+        VkPipelineShaderStageCreateInfo hiZShaderCreateInfo{};
+        hiZShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        hiZShaderCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        hiZShaderCreateInfo.module = hiZShaderModule;
+        hiZShaderCreateInfo.pName = "main";
+
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(DownsampleConstants);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &hiZDescriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if(vkCreatePipelineLayout(device, &pipelineLayoutInfo, host_allocator(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &hiZPipelineLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error{"Error: failed to create Hi-Z pipeline layout."};
+        }
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage = hiZShaderCreateInfo;
+        pipelineInfo.layout = hiZPipelineLayout;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+        pipelineInfo.basePipelineIndex = -1;
+
+        if(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, host_allocator(VK_OBJECT_TYPE_PIPELINE), &hiZPipeline) != VK_SUCCESS)
+        {
+            throw std::runtime_error{"Error: failed to create Hi-Z pipeline."};
+        }
+
+        vkDestroyShaderModule(device, hiZShaderModule, host_allocator(VK_OBJECT_TYPE_SHADER_MODULE));
+    }
+
+    void System::create_light_cull_pipeline()
+    {
+        auto lightCullShaderModule{create_shader_module(lightCullShaderCode)};
+
+        VkPipelineShaderStageCreateInfo lightCullShaderCreateInfo{};
+        lightCullShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        lightCullShaderCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        lightCullShaderCreateInfo.module = lightCullShaderModule;
+        lightCullShaderCreateInfo.pName = "main";
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 0;
+        pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+        if(vkCreatePipelineLayout(device, &pipelineLayoutInfo, host_allocator(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &lightCullPipelineLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error{"Error: failed to create light cull pipeline layout."};
+        }
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage = lightCullShaderCreateInfo;
+        pipelineInfo.layout = lightCullPipelineLayout;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+        pipelineInfo.basePipelineIndex = -1;
+
+        if(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, host_allocator(VK_OBJECT_TYPE_PIPELINE), &lightCullPipeline) != VK_SUCCESS)
+        {
+            throw std::runtime_error{"Error: failed to create light cull pipeline."};
+        }
 
-        vkDestroyShaderModule(device, vertexShaderModule, nullptr);
-        vkDestroyShaderModule(device, fragmentShaderModule, nullptr);
+        vkDestroyShaderModule(device, lightCullShaderModule, host_allocator(VK_OBJECT_TYPE_SHADER_MODULE));
     }
 
     VkShaderModule System::create_shader_module(const std::vector<char>& code)
@@ -830,7 +1839,7 @@ namespace app
 
         VkShaderModule shaderModule{};
 
-        if(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+        if(vkCreateShaderModule(device, &createInfo, host_allocator(VK_OBJECT_TYPE_SHADER_MODULE), &shaderModule) != VK_SUCCESS)
         {
             throw std::runtime_error{"Error: failed to create shader module."};
         }
@@ -840,15 +1849,18 @@ namespace app
 
     void System::create_render_pass()
     {
+        // Without multisampling the scene color target is rendered directly and there is nothing to resolve.
+        bool multisampled{msaaSamples != VK_SAMPLE_COUNT_1_BIT};
+
         VkAttachmentDescription colorAttachment{};
         colorAttachment.format = swapChainImageFormat;
         colorAttachment.samples = msaaSamples;
         colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.finalLayout = multisampled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
 
         VkAttachmentReference colorAttachmentRef{};
         colorAttachmentRef.attachment = 0;
@@ -857,12 +1869,12 @@ namespace app
         VkAttachmentDescription colorAttachmentResolve{};
         colorAttachmentResolve.format = swapChainImageFormat;
         colorAttachmentResolve.samples = VK_SAMPLE_COUNT_1_BIT;
-        colorAttachmentResolve.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachmentResolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
 
         VkAttachmentReference colorAttachmentResolveRef{};
         colorAttachmentResolveRef.attachment = 2;
@@ -886,20 +1898,26 @@ namespace app
         subpass.colorAttachmentCount = 1;
         subpass.pColorAttachments = &colorAttachmentRef;
         subpass.pDepthStencilAttachment = &depthAttachmentRef;
-        subpass.pResolveAttachments = &colorAttachmentResolveRef;
+        subpass.pResolveAttachments = multisampled ? &colorAttachmentResolveRef : nullptr;
 
+        // The previous frame's upscale still reads the scene color target.
         VkSubpassDependency dependency{};
         dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
         dependency.dstSubpass = 0;
         dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | 
-                                  VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+                                  VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                  VK_PIPELINE_STAGE_TRANSFER_BIT;
         dependency.srcAccessMask = 0;
         dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
                                   VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
         dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
                                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
-        std::array attachments{colorAttachment, depthAttachment, colorAttachmentResolve};
+        std::vector<VkAttachmentDescription> attachments{colorAttachment, depthAttachment};
+        if(multisampled)
+        {
+            attachments.push_back(colorAttachmentResolve);
+        }
 
         VkRenderPassCreateInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -910,33 +1928,92 @@ namespace app
         renderPassInfo.dependencyCount = 1;
         renderPassInfo.pDependencies = &dependency;
 
-        if(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
+        if(vkCreateRenderPass(device, &renderPassInfo, host_allocator(VK_OBJECT_TYPE_RENDER_PASS), &renderPass) != VK_SUCCESS)
         {
             throw std::runtime_error{"Error: failed to create render pass."};
         }
     }
 
-    void System::create_frame_buffers()
+    VkFormat System::find_occlusion_depth_format()
+    {
+        return find_supported_format({VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM}, VK_IMAGE_TILING_OPTIMAL, 
+                                     VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+    }
+
+    void System::create_depth_pre_pass()
+    {
+        VkAttachmentDescription depthAttachment{};
+        depthAttachment.format = find_occlusion_depth_format();
+        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VkAttachmentReference depthAttachmentRef{};
+        depthAttachmentRef.attachment = 0;
+        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 0;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+        std::array<VkSubpassDependency, 2> dependencies{};
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].dstSubpass = 0;
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        dependencies[0].srcAccessMask = 0;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &depthAttachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = static_cast<std::uint32_t>(std::size(dependencies));
+        renderPassInfo.pDependencies = std::data(dependencies);
+
+        if(vkCreateRenderPass(device, &renderPassInfo, host_allocator(VK_OBJECT_TYPE_RENDER_PASS), &depthPrePass) != VK_SUCCESS)
+        {
+            throw std::runtime_error{"Error: failed to create depth pre-pass."};
+        }
+    }
+
+    void System::create_frame_buffer()
     {
-        swapChainFrameBuffers.resize(std::size(swapChainImageViews));
-        for(const auto i : std::views::iota(0ull, std::size(swapChainImageViews)))
+        std::vector<VkImageView> attachments{sceneColorImageView, depthImageView};
+        if(msaaSamples != VK_SAMPLE_COUNT_1_BIT)
         {
-            std::array attachments{colorImageView, depthImageView, swapChainImageViews[i]};
+            attachments = {colorImageView, depthImageView, sceneColorImageView};
+        }
 
-            VkFramebufferCreateInfo frameBufferInfo{};
-            frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            frameBufferInfo.renderPass = renderPass;
-            frameBufferInfo.attachmentCount = static_cast<std::uint32_t>(std::size(attachments));
-            frameBufferInfo.pAttachments = std::data(attachments);
-            frameBufferInfo.width = swapChainExtent.width;
-            frameBufferInfo.height = swapChainExtent.height;
-            frameBufferInfo.layers = 1;
+        VkFramebufferCreateInfo frameBufferInfo{};
+        frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        frameBufferInfo.renderPass = renderPass;
+        frameBufferInfo.attachmentCount = static_cast<std::uint32_t>(std::size(attachments));
+        frameBufferInfo.pAttachments = std::data(attachments);
+        frameBufferInfo.width = swapChainExtent.width;
+        frameBufferInfo.height = swapChainExtent.height;
+        frameBufferInfo.layers = 1;
 
-            if(vkCreateFramebuffer(device, &frameBufferInfo, nullptr, &swapChainFrameBuffers[i]) != VK_SUCCESS)
-            {
-                throw std::runtime_error{"Error: failed to create framebuffer."};
-            }
+        VkFramebuffer frameBuffer{};
+        if(vkCreateFramebuffer(device, &frameBufferInfo, host_allocator(VK_OBJECT_TYPE_FRAMEBUFFER), &frameBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error{"Error: failed to create framebuffer."};
         }
+        sceneFrameBuffer = Framebuffer{device, frameBuffer};
     }
 
     void System::create_command_pool()
@@ -948,14 +2025,15 @@ namespace app
         commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
         commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
 
-        if(vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPool))
+        if(vkCreateCommandPool(device, &commandPoolCreateInfo, host_allocator(VK_OBJECT_TYPE_COMMAND_POOL), &commandPool))
         {
             throw std::runtime_error{"Error: failed to create command pool."};
         }
     }
     
     void System::create_image(std::uint32_t width, std::uint32_t height, std::uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, 
-                                VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory)
+                                VkMemoryPropertyFlags properties, Image& image, Allocation& imageMemory, MemoryCategory category, 
+                                std::string_view objectName, std::uint32_t arrayLayers)
     {
         VkImageCreateInfo imageCreateInfo{};
         imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -964,7 +2042,7 @@ namespace app
         imageCreateInfo.extent.height = static_cast<std::uint32_t>(height);
         imageCreateInfo.extent.depth = 1;
         imageCreateInfo.mipLevels = mipLevels;
-        imageCreateInfo.arrayLayers = 1;
+        imageCreateInfo.arrayLayers = arrayLayers;
         imageCreateInfo.format = format;
         imageCreateInfo.tiling = tiling;
         imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -973,23 +2051,18 @@ namespace app
         imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
         imageCreateInfo.flags = 0;
 
-        if(vkCreateImage(device, &imageCreateInfo, nullptr, &image) != VK_SUCCESS)
+        VkImage handle{};
+        if(vkCreateImage(device, &imageCreateInfo, host_allocator(VK_OBJECT_TYPE_IMAGE), &handle) != VK_SUCCESS)
         {
             throw std::runtime_error{"Error: failed to create image."};
         }
+        image = Image{device, handle};
+        name_object(VK_OBJECT_TYPE_IMAGE, reinterpret_cast<std::uint64_t>(handle), objectName);
 
         VkMemoryRequirements memoryRequirements{};
         vkGetImageMemoryRequirements(device, image, &memoryRequirements);
 
-        VkMemoryAllocateInfo allocateInfo{};
-        allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocateInfo.allocationSize = memoryRequirements.size;
-        allocateInfo.memoryTypeIndex = find_memory_type(memoryRequirements.memoryTypeBits, properties);
-
-        if(vkAllocateMemory(device, &allocateInfo, nullptr, &imageMemory) != VK_SUCCESS)
-        {
-            throw std::runtime_error{"Error: failed to allocate image memory."};
-        }
+        imageMemory = allocate_memory(memoryRequirements, properties, category, objectName);
 
         vkBindImageMemory(device, image, imageMemory, 0);
     }
@@ -997,8 +2070,10 @@ namespace app
     void System::create_depth_resources()
     {
         auto depthFormat{find_depth_format()};
-        create_image(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 
-                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
+        create_image(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL, 
+                     VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, depthImage, depthImageMemory, 
+                     MemoryCategory::depth, "depth");
         depthImageView = create_image_view(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
     }
 
@@ -1034,74 +2109,319 @@ namespace app
         return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
     }
 
-    void System::create_texture_image()
+    void System::decode_textures()
     {
-        struct 
+        std::vector<TextureData> decoded(std::size(scene.materials));
+        jobs.parallel_for(std::size(scene.materials), 1, [&](std::size_t begin, std::size_t end)
         {
-            std::int32_t  width;
-            std::int32_t  height;
-            std::int32_t  channels;
-        } texture;
-        stbi_uc* pixels = stbi_load(std::data(texturePath), &texture.width, &texture.height, &texture.channels, STBI_rgb_alpha);
-        VkDeviceSize imageSize{static_cast<VkDeviceSize>(texture.width * texture.height * 4)};
+            for(auto i{begin}; i < end; ++i)
+            {
+                const auto& path{scene.materials[i].texturePath};
+                auto& texture{decoded[i]};
 
-        if(pixels == nullptr)
-        {
-            throw std::runtime_error{"Error: failed to load texture image."};
+                std::int32_t channels{};
+                stbi_uc* pixels = stbi_load(path.string().c_str(), &texture.width, &texture.height, &channels, STBI_rgb_alpha);
+
+                if(pixels == nullptr)
+                {
+                    throw std::runtime_error{"Error: failed to load texture image " + path.string() + "."};
+                }
+
+                texture.pixels.assign(pixels, pixels + static_cast<std::size_t>(texture.width) * texture.height * 4);
+                stbi_image_free(pixels);
+            }
+        });
+
+        // Acquired in material order so atlas entries do not depend on which decode finished first.
+        for(auto& texture : decoded)
+        {
+            materialTextures.push_back(acquire_texture(std::move(texture)));
+        }
+
+        if(std::empty(materialTextures))
+        {
+            throw std::runtime_error{"Error: scene has no materials."};
         }
 
-        mipLevels = static_cast<std::uint32_t>(std::floor(std::log2(std::max(texture.width, texture.height)))) + 1;
+        // All materials share one array image, so any mix of them is drawn by the same indirect batch. The whole chain
+        // stays in host memory so finer levels can be streamed in without touching the files again. Being the only
+        // streamed texture, the atlas has no other texture to evict levels from: the residency budget (--texture-budget)
+        // caps how fine it is streamed, and levels it no longer asks for stay resident within that cap.
+        auto atlas{pack_texture_atlas(atlasTextures)};
+        atlasTextures = {};
+        streamedTexture = textureStreamer.add(build_atlas_mip_chain(atlas, &jobs), streamingTailExtent);
 
-        VkBuffer stagingBuffer{};
-        VkDeviceMemory stagingBufferMemory{};
-        
-        create_buffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
-                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+        materialPlacements.clear();
+        for(auto texture : materialTextures)
+        {
+            materialPlacements.push_back(atlas.placements[texture]);
+        }
+    }
 
-        void* data{};
-        vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-        memcpy(data, pixels, static_cast<std::size_t>(imageSize));
-        vkUnmapMemory(device, stagingBufferMemory);
+    std::size_t System::acquire_texture(TextureData texture)
+    {
+        auto width{static_cast<std::uint32_t>(texture.width)};
+        auto height{static_cast<std::uint32_t>(texture.height)};
+        auto pixels{std::as_bytes(std::span{texture.pixels})};
+        TextureKey key{hash_bytes(pixels), check_bytes(pixels), std::size(pixels), width, height, VK_FORMAT_R8G8B8A8_SRGB};
 
-        stbi_image_free(pixels);
+        // Materials pointing at identical pixels share one atlas entry.
+        return textureCache.acquire(key, mip_chain_bytes(width, height), [&]
+        {
+            atlasTextures.push_back(std::move(texture));
+            return std::size(atlasTextures) - 1;
+        });
+    }
 
-        create_image(texture.width, texture.height, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | 
-                     VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
-        transition_image_layout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
-        copy_buffer_to_image(stagingBuffer, textureImage, static_cast<std::uint32_t>(texture.width), static_cast<std::uint32_t>(texture.height));
-        //transition_image_layout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+    VkSampler System::acquire_sampler(const VkSamplerCreateInfo& samplerInfo)
+    {
+        // Sampler objects cost next to nothing in memory; what sharing saves is the driver's limited sampler slots.
+        return samplerCache.acquire({samplerInfo}, 0, [&]
+        {
+            VkSampler sampler{};
+            if(vkCreateSampler(device, &samplerInfo, host_allocator(VK_OBJECT_TYPE_SAMPLER), &sampler) != VK_SUCCESS)
+            {
+                throw std::runtime_error{"Error: failed to create sampler."};
+            }
+            return Sampler{device, sampler};
+        });
+    }
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+    void System::create_texture_image()
+    {
+        mipLevels = textureStreamer.level_count(streamedTexture);
 
-        generate_mipmaps(textureImage, VK_FORMAT_R8G8B8A8_SRGB, texture.width, texture.height, mipLevels);
+        VkCommandBuffer commandBuffer{begin_single_time_commands()};
+        record_texture_residency(commandBuffer, textureStreamer.first_resident_level(streamedTexture));
+        end_single_time_commands(commandBuffer);
     }
-    
-    VkImageView System::create_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, std::uint32_t mipLevels)
+
+    void System::record_texture_residency(VkCommandBuffer commandBuffer, std::uint32_t firstLevel)
+    {
+        const auto& finest{textureStreamer.level(streamedTexture, firstLevel)};
+
+        Image image{};
+        Allocation imageMemory{};
+        create_image(finest.width, finest.height, mipLevels - firstLevel, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, 
+                     VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory, MemoryCategory::texture, 
+                     std::format("texture {} from level {}", streamedTexture, firstLevel), finest.layers);
+
+        // Levels already on the device are copied across; only the missing finer ones come from host memory.
+        auto copiedLevel{textureImage ? std::max(firstLevel, textureFirstLevel) : mipLevels};
+
+        VkDeviceSize stagingSize{0};
+        for(auto level{firstLevel}; level < copiedLevel; ++level)
+        {
+            stagingSize += std::size(textureStreamer.level(streamedTexture, level).pixels);
+        }
+
+        Buffer stagingBuffer{};
+        Allocation stagingBufferMemory{};
+        std::vector<VkBufferImageCopy> uploads{};
+        if(stagingSize > 0)
+        {
+            create_buffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
+                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, MemoryCategory::staging, 
+                          std::format("texture {} staging", streamedTexture));
+
+            void* data{};
+            vkMapMemory(device, stagingBufferMemory, 0, stagingSize, 0, &data);
+
+            VkDeviceSize offset{0};
+            for(auto level{firstLevel}; level < copiedLevel; ++level)
+            {
+                const auto& mip{textureStreamer.level(streamedTexture, level)};
+                memcpy(static_cast<std::uint8_t*>(data) + offset, std::data(mip.pixels), std::size(mip.pixels));
+
+                VkBufferImageCopy region{};
+                region.bufferOffset = offset;
+                region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                region.imageSubresource.mipLevel = level - firstLevel;
+                region.imageSubresource.baseArrayLayer = 0;
+                region.imageSubresource.layerCount = mip.layers;
+                region.imageExtent = {mip.width, mip.height, 1};
+                uploads.push_back(region);
+
+                offset += std::size(mip.pixels);
+            }
+            vkUnmapMemory(device, stagingBufferMemory);
+        }
+
+        std::vector<VkImageCopy> copies{};
+        for(auto level{copiedLevel}; level < mipLevels; ++level)
+        {
+            const auto& mip{textureStreamer.level(streamedTexture, level)};
+
+            VkImageCopy region{};
+            region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.srcSubresource.mipLevel = level - textureFirstLevel;
+            region.srcSubresource.baseArrayLayer = 0;
+            region.srcSubresource.layerCount = mip.layers;
+            region.dstSubresource = region.srcSubresource;
+            region.dstSubresource.mipLevel = level - firstLevel;
+            region.extent = {mip.width, mip.height, 1};
+            copies.push_back(region);
+        }
+
+        std::array<VkImageMemoryBarrier, 2> barriers{};
+        for(auto& barrier : barriers)
+        {
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseMipLevel = 0;
+            barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        }
+
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[0].image = image;
+        barriers[0].srcAccessMask = 0;
+        barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        // Earlier frames only read the old image, so waiting for their fragment shaders is enough.
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barriers[1].image = textureImage;
+        barriers[1].srcAccessMask = 0;
+        barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 
+                             std::empty(copies) ? 1 : 2, std::data(barriers));
+
+        if(!std::empty(uploads))
+        {
+            vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
+                                   static_cast<std::uint32_t>(std::size(uploads)), std::data(uploads));
+        }
+
+        if(!std::empty(copies))
+        {
+            vkCmdCopyImage(commandBuffer, textureImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
+                           static_cast<std::uint32_t>(std::size(copies)), std::data(copies));
+        }
+
+        auto& readBarrier{barriers[0]};
+        readBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        readBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        readBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        readBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 
+                             1, &readBarrier);
+
+        // The copy above reads the old image in this very frame, so it outlives the frame being recorded.
+        deletionQueue.retire(frameNumber + 1, std::move(textureImageView), std::move(textureImage), std::move(textureImageMemory), 
+                             std::move(stagingBuffer), std::move(stagingBufferMemory));
+
+        textureImage = std::move(image);
+        textureImageMemory = std::move(imageMemory);
+        textureFirstLevel = firstLevel;
+        ++textureVersion;
+    }
+
+    ImageView System::create_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, std::uint32_t mipLevels, 
+                                        std::uint32_t baseMipLevel, VkImageViewType viewType, std::uint32_t layerCount)
     {
         VkImageViewCreateInfo viewInfo{};
         viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
         viewInfo.image = image;
-        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.viewType = viewType;
         viewInfo.format = format;
         viewInfo.subresourceRange.aspectMask = aspectFlags;
-        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
         viewInfo.subresourceRange.levelCount = mipLevels;
         viewInfo.subresourceRange.baseArrayLayer = 0;
-        viewInfo.subresourceRange.layerCount = 1;
+        viewInfo.subresourceRange.layerCount = layerCount;
 
         VkImageView imageView{};
-        if(vkCreateImageView(device, &viewInfo, nullptr, &imageView) != VK_SUCCESS)
+        if(vkCreateImageView(device, &viewInfo, host_allocator(VK_OBJECT_TYPE_IMAGE_VIEW), &imageView) != VK_SUCCESS)
         {
             throw std::runtime_error{"Error: failed to create texture image view."};
         }
 
-        return imageView;
+        return ImageView{device, imageView};
     }
 
     void System::create_texture_image_view()
     {
-        textureImageView = create_image_view(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+        // The view only spans the resident levels; missing finer levels simply do not exist to the sampler.
+        const auto& finest{textureStreamer.level(streamedTexture, textureFirstLevel)};
+        textureImageView = create_image_view(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels - textureFirstLevel, 0, 
+                                             VK_IMAGE_VIEW_TYPE_2D_ARRAY, finest.layers);
+    }
+
+    void System::update_texture_streaming()
+    {
+        auto planes{extract_frustum_planes(frameUniforms.projection * frameUniforms.view)};
+        auto viewportHeight{static_cast<float>(resolution.render_extent(swapChainExtent).height)};
+
+        // Every material samples the atlas, so the nearest visible instance decides how sharp it has to be.
+        float projectedPixels{0.0f};
+        for(const auto& object : objects)
+        {
+            auto world{frameUniforms.model * object.model};
+            auto center{glm::vec3{world * glm::vec4{glm::vec3{object.boundingSphere}, 1.0f}}};
+            if(!sphere_in_frustum(planes, center, object.boundingSphere.w * max_scale(world)))
+            {
+                continue;
+            }
+            // A packed texture spans only part of a layer, so it needs the atlas proportionally sharper.
+            const auto& placement{materialPlacements[object.material]};
+            auto coverage{std::max(placement.uvTransform.x, placement.uvTransform.y)};
+            projectedPixels = std::max(projectedPixels, projected_diameter(world, object.boundingSphere, frameUniforms.view, 
+                                                                           frameUniforms.projection, viewportHeight) / coverage);
+        }
+
+        const auto& full{textureStreamer.level(streamedTexture, 0)};
+        textureStreamer.request(streamedTexture, wanted_mip_level(std::max(full.width, full.height), projectedPixels, mipLevels), frameNumber);
+
+        for(const auto& change : textureStreamer.update())
+        {
+            pendingTextureLevel = change.firstLevel;
+        }
+    }
+
+    void System::record_texture_streaming(VkCommandBuffer commandBuffer)
+    {
+        if(pendingTextureLevel && *pendingTextureLevel != textureFirstLevel)
+        {
+            record_texture_residency(commandBuffer, *pendingTextureLevel);
+            create_texture_image_view();
+        }
+        pendingTextureLevel.reset();
+
+        // Descriptor sets of frames still in flight are rewritten when their slot comes around again.
+        update_texture_descriptor(currentFrame);
+    }
+
+    void System::update_texture_descriptor(std::uint32_t frame)
+    {
+        if(textureDescriptorVersions[frame] == textureVersion)
+        {
+            return;
+        }
+
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = textureImageView;
+        imageInfo.sampler = textureSampler;
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = descriptorSets[frame];
+        descriptorWrite.dstBinding = 1;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pImageInfo = &imageInfo;
+
+        vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+        textureDescriptorVersions[frame] = textureVersion;
     }
     
     void System::create_texture_sampler()
@@ -1127,14 +2447,109 @@ namespace app
         samplerInfo.minLod = 0.0f;
         samplerInfo.maxLod = static_cast<float>(mipLevels);
 
-        if(vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS)
+        textureSampler = acquire_sampler(samplerInfo);
+    }
+
+    void System::create_occlusion_resources()
+    {
+        auto depthFormat{find_occlusion_depth_format()};
+        create_image(occlusionExtent.width, occlusionExtent.height, 1, VK_SAMPLE_COUNT_1_BIT, depthFormat, VK_IMAGE_TILING_OPTIMAL, 
+                     VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
+                     occlusionDepthImage, occlusionDepthImageMemory, MemoryCategory::depth, "occlusion depth");
+        occlusionDepthImageView = create_image_view(occlusionDepthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+
+        VkImageView depthView{occlusionDepthImageView};
+        VkFramebufferCreateInfo frameBufferInfo{};
+        frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        frameBufferInfo.renderPass = depthPrePass;
+        frameBufferInfo.attachmentCount = 1;
+        frameBufferInfo.pAttachments = &depthView;
+        frameBufferInfo.width = occlusionExtent.width;
+        frameBufferInfo.height = occlusionExtent.height;
+        frameBufferInfo.layers = 1;
+
+        VkFramebuffer frameBuffer{};
+        if(vkCreateFramebuffer(device, &frameBufferInfo, host_allocator(VK_OBJECT_TYPE_FRAMEBUFFER), &frameBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error{"Error: failed to create depth pre-pass framebuffer."};
+        }
+        depthPrePassFrameBuffer = Framebuffer{device, frameBuffer};
+
+        create_image(occlusionExtent.width, occlusionExtent.height, hiZLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R32G32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, 
+                     VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, hiZImage, hiZImageMemory, 
+                     MemoryCategory::depth, "hi-z pyramid");
+        hiZImageView = create_image_view(hiZImage, VK_FORMAT_R32G32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, hiZLevels);
+        for(std::uint32_t level{0}; level < hiZLevels; ++level)
+        {
+            hiZMipViews.push_back(create_image_view(hiZImage, VK_FORMAT_R32G32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 1, level));
+        }
+
+        static_assert(hiZLevels - 1 <= maxDownsampleLevels, "The Hi-Z pyramid must fit in a single downsample dispatch.");
+        create_buffer(downsample_scratch_bytes(occlusionExtent, hiZLevels - 1), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | 
+                      VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, hiZScratchBuffer, hiZScratchBufferMemory, 
+                      MemoryCategory::storage, "hi-z downsample scratch");
+
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.anisotropyEnable = VK_FALSE;
+        samplerInfo.maxAnisotropy = 1.0f;
+        samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+        samplerInfo.unnormalizedCoordinates = VK_FALSE;
+        samplerInfo.compareEnable = VK_FALSE;
+        samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+        samplerInfo.minLod = 0.0f;
+        samplerInfo.maxLod = static_cast<float>(hiZLevels);
+
+        hiZSampler = acquire_sampler(samplerInfo);
+
+        VkDeviceSize visibilitySize{sizeof(std::uint32_t) * max_draw_count()};
+        create_buffer(visibilitySize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, visibilityBuffer, visibilityBufferMemory, MemoryCategory::storage, "visibility");
+
+        cullStatisticsBuffers.resize(maxFramesInFlight);
+        cullStatisticsBuffersMemory.resize(maxFramesInFlight);
+        cullStatisticsBuffersMapped.resize(maxFramesInFlight);
+        cullStatisticsFrames.resize(maxFramesInFlight);
+        for(const auto i : std::views::iota(0, maxFramesInFlight))
         {
-            throw std::runtime_error{"Error: failed to create texture sampler."};
+            create_buffer(sizeof(CullStatistics), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
+                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, cullStatisticsBuffers[i], cullStatisticsBuffersMemory[i], 
+                          MemoryCategory::readback, std::format("cull statistics {}", i));
+            vkMapMemory(device, cullStatisticsBuffersMemory[i], 0, sizeof(CullStatistics), 0, &cullStatisticsBuffersMapped[i]);
         }
+
+        VkCommandBuffer commandBuffer{begin_single_time_commands()};
+
+        vkCmdFillBuffer(commandBuffer, visibilityBuffer, 0, VK_WHOLE_SIZE, 0);
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = hiZImage;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = hiZLevels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 
+                             0, nullptr, 0, nullptr, 1, &barrier);
+
+        end_single_time_commands(commandBuffer);
     }
 
     void System::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, 
-                                 VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+                                 Buffer& buffer, Allocation& bufferMemory, MemoryCategory category, std::string_view objectName)
     {
         VkBufferCreateInfo bufferCreateInfo{};
         bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -1142,58 +2557,61 @@ namespace app
         bufferCreateInfo.usage = usage;
         bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-        if(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer) != VK_SUCCESS)
+        VkBuffer handle{};
+        if(vkCreateBuffer(device, &bufferCreateInfo, host_allocator(VK_OBJECT_TYPE_BUFFER), &handle) != VK_SUCCESS)
         {
             throw std::runtime_error{"Error: failed to create vertex buffer."};
         }
+        buffer = Buffer{device, handle};
+        name_object(VK_OBJECT_TYPE_BUFFER, reinterpret_cast<std::uint64_t>(handle), objectName);
 
         VkMemoryRequirements memoryRequirements{};
         vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
 
-        VkMemoryAllocateInfo allocateInfo{};
-        allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocateInfo.allocationSize = memoryRequirements.size;
-        allocateInfo.memoryTypeIndex = find_memory_type(memoryRequirements.memoryTypeBits, properties);
-        
-        if(vkAllocateMemory(device, &allocateInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-        {
-            throw std::runtime_error{"Error: failed to allocate vertex buffer memory."};
-        }
+        bufferMemory = allocate_memory(memoryRequirements, properties, category, objectName);
 
         vkBindBufferMemory(device, buffer, bufferMemory, 0);
     }
 
     void System::create_vertex_buffer()
     {
+        // Every variant of a run shares one vertex layout, chosen by the startup variant.
+        QuantizedMesh quantizedMesh{};
+        const void* source{std::data(vertices)};
         VkDeviceSize bufferSize{sizeof(vertices[0]) * std::size(vertices)};
+        if(options.shaderVariant.has(ShaderFeature::quantized))
+        {
+            quantizedMesh = quantize_vertices(vertices);
+            positionScale = glm::vec4{quantizedMesh.positionScale, 0.0f};
+            positionOffset = glm::vec4{quantizedMesh.positionOffset, 0.0f};
+            source = std::data(quantizedMesh.vertices);
+            bufferSize = sizeof(QuantizedVertex) * std::size(quantizedMesh.vertices);
+        }
 
-        VkBuffer stagingBuffer{};
-        VkDeviceMemory stagingBufferMemory{};
+        Buffer stagingBuffer{};
+        Allocation stagingBufferMemory{};
         create_buffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
-                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, MemoryCategory::staging, "vertices staging");
 
         void* data{nullptr};
         vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, std::data(vertices), static_cast<std::size_t>(bufferSize));
+        memcpy(data, source, static_cast<std::size_t>(bufferSize));
         vkUnmapMemory(device, stagingBufferMemory);
 
         create_buffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
-                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory, MemoryCategory::vertex, "vertices");
 
         copy_buffer(stagingBuffer, vertexBuffer, bufferSize);
-
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
     }
 
     void System::create_index_buffer()
     {
         VkDeviceSize bufferSize{sizeof(indices[0]) * std::size(indices)};
 
-        VkBuffer stagingBuffer{};
-        VkDeviceMemory stagingBufferMemory{};
+        Buffer stagingBuffer{};
+        Allocation stagingBufferMemory{};
         create_buffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
-                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, MemoryCategory::staging, "indices staging");
 
         void* data{};
         vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
@@ -1201,15 +2619,205 @@ namespace app
         vkUnmapMemory(device, stagingBufferMemory);
 
         create_buffer(bufferSize,VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory, MemoryCategory::index, "indices");
 
         copy_buffer(stagingBuffer, indexBuffer, bufferSize);
+    }
+
+    void System::create_device_buffer(const void* source, VkDeviceSize size, VkBufferUsageFlags usage, Buffer& buffer, Allocation& bufferMemory, 
+                                      MemoryCategory category, std::string_view objectName)
+    {
+        Buffer stagingBuffer{};
+        Allocation stagingBufferMemory{};
+        create_buffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
+                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, MemoryCategory::staging, 
+                      std::format("{} staging", objectName));
+
+        void* data{};
+        vkMapMemory(device, stagingBufferMemory, 0, size, 0, &data);
+        memcpy(data, source, static_cast<std::size_t>(size));
+        vkUnmapMemory(device, stagingBufferMemory);
+
+        create_buffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory, 
+                      category, objectName);
+
+        copy_buffer(stagingBuffer, buffer, size);
+    }
+
+    void System::create_clusters()
+    {
+        std::vector<std::uint32_t> clusterIndices{};
+        clusterIndices.reserve(std::size(indices));
+        for(auto& mesh : meshes)
+        {
+            std::span meshVertices{std::data(vertices) + mesh.vertexOffset, mesh.vertexCount};
+            std::span meshIndices{std::data(indices) + mesh.firstIndex, mesh.indexCount};
+
+            std::vector<ClusterData> meshClusters{};
+            if(options.meshlets)
+            {
+                auto meshlets{build_meshlets(meshIndices, mesh.vertexCount)};
+                meshClusters = build_clusters(meshlets, meshVertices);
+                auto reordered{meshlet_indices(meshlets)};
+                mesh.indexCount = static_cast<std::uint32_t>(std::size(reordered));
+                clusterIndices.insert(std::end(clusterIndices), std::begin(reordered), std::end(reordered));
+            }
+            else
+            {
+                meshClusters = {whole_mesh_cluster(meshVertices, mesh.indexCount)};
+                clusterIndices.insert(std::end(clusterIndices), std::begin(meshIndices), std::end(meshIndices));
+            }
+
+            // Clusters address the merged index buffer; the mesh's vertexOffset rebases its local indices.
+            mesh.firstIndex = static_cast<std::uint32_t>(std::size(clusterIndices)) - mesh.indexCount;
+            mesh.firstCluster = static_cast<std::uint32_t>(std::size(clusters));
+            mesh.clusterCount = static_cast<std::uint32_t>(std::size(meshClusters));
+            for(auto& cluster : meshClusters)
+            {
+                cluster.firstIndex += mesh.firstIndex;
+                cluster.vertexOffset = mesh.vertexOffset;
+                clusters.push_back(cluster);
+            }
+        }
+        indices = std::move(clusterIndices);
+
+        if(options.meshlets)
+        {
+            std::println("Built {} meshlets from {} triangles.", std::size(clusters), std::size(indices) / 3);
+        }
+
+        // A scene without instances shows its first mesh on the --objects grid, as a single model always has.
+        if(std::empty(scene.instances))
+        {
+            for(const auto& position : layout_object_grid(options.objectCount, meshes[0].bounds))
+            {
+                scene.instances.push_back({0, {position}});
+            }
+        }
+
+        drawList = build_draw_list(meshes, scene.instances);
+        objects.clear();
+        drawCapacity = 0;
+        for(const auto& draw : drawList)
+        {
+            const auto& mesh{meshes[draw.mesh]};
+            transforms.add(draw.transform);
+            objects.push_back({glm::mat4{1.0f}, glm::vec4{mesh.bounds.center, mesh.bounds.radius}, mesh.firstCluster, 
+                               mesh.clusterCount, drawCapacity, draw.material});
+            drawCapacity += mesh.clusterCount;
+        }
+        transforms.update(0);
+        transforms.write_models(objects, 0);
+    }
+
+    void System::create_object_buffers()
+    {
+        if(max_draw_count() > 1 && (!supportedFeatures.multiDrawIndirect || !supportedFeatures.drawIndirectFirstInstance))
+        {
+            throw std::runtime_error{"Error: drawing multiple clusters requires multiDrawIndirect and drawIndirectFirstInstance."};
+        }
+
+        // One mapped copy per frame in flight, so world matrices can be rewritten while an earlier frame still reads its own.
+        VkDeviceSize bufferSize{sizeof(objects[0]) * std::size(objects)};
+        objectBuffers.resize(maxFramesInFlight);
+        objectBuffersMemory.resize(maxFramesInFlight);
+        objectBuffersMapped.resize(maxFramesInFlight);
+
+        for(const auto i : std::views::iota(0, maxFramesInFlight))
+        {
+            create_buffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
+                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, objectBuffers[i], objectBuffersMemory[i], MemoryCategory::storage, 
+                          std::format("objects {}", i));
+            vkMapMemory(device, objectBuffersMemory[i], 0, bufferSize, 0, &objectBuffersMapped[i]);
+            memcpy(objectBuffersMapped[i], std::data(objects), static_cast<std::size_t>(bufferSize));
+        }
+    }
+
+    void System::create_cluster_buffer()
+    {
+        create_device_buffer(std::data(clusters), sizeof(clusters[0]) * std::size(clusters), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 
+                             clusterBuffer, clusterBufferMemory, MemoryCategory::storage, "clusters");
+    }
+
+    void System::create_material_buffer()
+    {
+        create_device_buffer(std::data(materialPlacements), sizeof(materialPlacements[0]) * std::size(materialPlacements), 
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, materialBuffer, materialBufferMemory, MemoryCategory::storage, "materials");
+    }
+
+    void System::create_light_buffers()
+    {
+        lights = scene.lights;
+        if(options.lightCount > 0)
+        {
+            // Generated lights are scattered over the space the objects take up, so they land where there is something to light.
+            glm::vec3 minimum{std::numeric_limits<float>::max()};
+            glm::vec3 maximum{std::numeric_limits<float>::lowest()};
+            for(const auto& object : objects)
+            {
+                auto center{glm::vec3{object.model * glm::vec4{glm::vec3{object.boundingSphere}, 1.0f}}};
+                auto radius{object.boundingSphere.w * max_scale(object.model)};
+                minimum = glm::min(minimum, center - radius);
+                maximum = glm::max(maximum, center + radius);
+            }
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+            auto generated{generate_lights(options.lightCount, {(minimum + maximum) * 0.5f, glm::length(maximum - minimum) * 0.5f}, lightSeed)};
+            lights.insert(std::end(lights), std::begin(generated), std::end(generated));
+        }
+
+        // A storage buffer cannot be empty, so a scene without lights still uploads one that is never read.
+        std::vector<PointLight> uploaded{lights};
+        uploaded.resize(std::max<std::size_t>(std::size(uploaded), 1));
+        create_device_buffer(std::data(uploaded), sizeof(uploaded[0]) * std::size(uploaded), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 
+                             lightBuffer, lightBufferMemory, MemoryCategory::storage, "lights");
+
+        // The grid and index list are rebuilt every frame from that frame's camera, so each frame in flight has its own.
+        lightGridBuffers.resize(maxFramesInFlight);
+        lightGridBuffersMemory.resize(maxFramesInFlight);
+        lightIndexBuffers.resize(maxFramesInFlight);
+        lightIndexBuffersMemory.resize(maxFramesInFlight);
+        for(const auto i : std::views::iota(0, maxFramesInFlight))
+        {
+            create_buffer(sizeof(glm::uvec2) * lightClusterCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
+                          lightGridBuffers[i], lightGridBuffersMemory[i], MemoryCategory::storage, std::format("light grid {}", i));
+            // A counter, then the light indices of every cluster back to back.
+            create_buffer(sizeof(std::uint32_t) * (lightIndexCapacity + 1), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, lightIndexBuffers[i], lightIndexBuffersMemory[i], MemoryCategory::storage, 
+                          std::format("light indices {}", i));
+        }
+
+        if(!std::empty(lights))
+        {
+            std::println("Assigning {} lights to {} clusters.", std::size(lights), lightClusterCount);
+        }
+    }
+
+    std::uint32_t System::max_draw_count() const
+    {
+        return drawCapacity;
+    }
+
+    void System::create_draw_buffers()
+    {
+        VkDeviceSize commandBufferSize{sizeof(VkDrawIndexedIndirectCommand) * max_draw_count() * 2};
+
+        drawCommandBuffers.resize(maxFramesInFlight);
+        drawCommandBuffersMemory.resize(maxFramesInFlight);
+        drawCountBuffers.resize(maxFramesInFlight);
+        drawCountBuffersMemory.resize(maxFramesInFlight);
+
+        for(const auto i : std::views::iota(0, maxFramesInFlight))
+        {
+            create_buffer(commandBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, 
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawCommandBuffers[i], drawCommandBuffersMemory[i], MemoryCategory::indirect, 
+                          std::format("draw commands {}", i));
+            create_buffer(sizeof(CullStatistics), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | 
+                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
+                          drawCountBuffers[i], drawCountBuffersMemory[i], MemoryCategory::indirect, std::format("draw count {}", i));
+        }
     }
 
-    std::uint32_t System::find_memory_type(std::uint32_t typeFilter, VkMemoryPropertyFlags properties)
+    std::optional<std::uint32_t> System::find_memory_type(std::uint32_t typeFilter, VkMemoryPropertyFlags properties)
     {
         VkPhysicalDeviceMemoryProperties memoryProperties{};
         vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
@@ -1221,10 +2829,46 @@ namespace app
                 return i;
             }
         }
+        return std::nullopt;
+    }
 
-        throw std::runtime_error{"Error: failed to find suitable memory type."};
+    Allocation System::allocate_memory(const VkMemoryRequirements& memoryRequirements, VkMemoryPropertyFlags properties, 
+                                       MemoryCategory category, std::string_view objectName)
+    {
+        auto memoryType{find_memory_type(memoryRequirements.memoryTypeBits, properties)};
 
-        return {};
+        // Lazily allocated memory is only a hint; without it transient attachments fall back to ordinary memory.
+        bool lazy{(properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0};
+        if(!memoryType && lazy)
+        {
+            lazy = false;
+            memoryType = find_memory_type(memoryRequirements.memoryTypeBits, properties & ~VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+        }
+
+        if(!memoryType)
+        {
+            throw std::runtime_error{"Error: failed to find suitable memory type."};
+        }
+
+        VkMemoryAllocateInfo allocateInfo{};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocateInfo.allocationSize = memoryRequirements.size;
+        allocateInfo.memoryTypeIndex = *memoryType;
+
+        VkDeviceMemory memory{};
+        if(vkAllocateMemory(device, &allocateInfo, host_allocator(VK_OBJECT_TYPE_DEVICE_MEMORY), &memory) != VK_SUCCESS)
+        {
+            throw std::runtime_error{"Error: failed to allocate device memory."};
+        }
+
+        name_object(VK_OBJECT_TYPE_DEVICE_MEMORY, reinterpret_cast<std::uint64_t>(memory), objectName);
+
+        VkPhysicalDeviceMemoryProperties memoryProperties{};
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+        auto registration{memoryRegistry.add(category, std::string{objectName}, memoryProperties.memoryTypes[*memoryType].heapIndex, 
+                                             memoryRequirements.size)};
+        return Allocation{device, memory, memoryRequirements.size, lazy ? &lazyMemoryCounter : &memoryCounter, lazy, 
+                          &memoryRegistry, registration};
     }
 
     void System::copy_buffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
@@ -1251,27 +2895,32 @@ namespace app
         for(const auto i : std::views::iota(0, maxFramesInFlight))
         {
             create_buffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
-                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
+                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i], MemoryCategory::uniform, 
+                          std::format("uniforms {}", i));
             vkMapMemory(device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
         }
     }
 
     void System::create_descriptor_pool()
     {
-        std::array<VkDescriptorPoolSize, 2> poolSizes{};
+        std::array<VkDescriptorPoolSize, 4> poolSizes{};
         poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
         poolSizes[0].descriptorCount = static_cast<std::uint32_t>(maxFramesInFlight);
         poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        poolSizes[1].descriptorCount = static_cast<std::uint32_t>(maxFramesInFlight);
+        poolSizes[1].descriptorCount = static_cast<std::uint32_t>(maxFramesInFlight * 2) + 1;
+        poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSizes[2].descriptorCount = static_cast<std::uint32_t>(maxFramesInFlight * 9) + 1;
+        poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        poolSizes[3].descriptorCount = downsampleDestinationCount;
 
 
         VkDescriptorPoolCreateInfo poolInfo{};
         poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
         poolInfo.poolSizeCount = static_cast<std::uint32_t>(std::size(poolSizes));
         poolInfo.pPoolSizes = std::data(poolSizes);
-        poolInfo.maxSets = static_cast<std::uint32_t>(maxFramesInFlight);
+        poolInfo.maxSets = static_cast<std::uint32_t>(maxFramesInFlight) + 1;
 
-        if(vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+        if(vkCreateDescriptorPool(device, &poolInfo, host_allocator(VK_OBJECT_TYPE_DESCRIPTOR_POOL), &descriptorPool) != VK_SUCCESS)
         {
             throw std::runtime_error{"Error: failed to create descriptor pool"};
         }
@@ -1304,7 +2953,45 @@ namespace app
             imageInfo.imageView = textureImageView;
             imageInfo.sampler = textureSampler;
 
-            std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+            std::array<VkDescriptorBufferInfo, 5> storageBufferInfos{};
+            storageBufferInfos[0].buffer = objectBuffers[i];
+            storageBufferInfos[0].offset = 0;
+            storageBufferInfos[0].range = VK_WHOLE_SIZE;
+            storageBufferInfos[1].buffer = drawCommandBuffers[i];
+            storageBufferInfos[1].offset = 0;
+            storageBufferInfos[1].range = VK_WHOLE_SIZE;
+            storageBufferInfos[2].buffer = drawCountBuffers[i];
+            storageBufferInfos[2].offset = 0;
+            storageBufferInfos[2].range = VK_WHOLE_SIZE;
+            storageBufferInfos[3].buffer = clusterBuffer;
+            storageBufferInfos[3].offset = 0;
+            storageBufferInfos[3].range = VK_WHOLE_SIZE;
+            storageBufferInfos[4].buffer = visibilityBuffer;
+            storageBufferInfos[4].offset = 0;
+            storageBufferInfos[4].range = VK_WHOLE_SIZE;
+
+            VkDescriptorImageInfo hiZInfo{};
+            hiZInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            hiZInfo.imageView = hiZImageView;
+            hiZInfo.sampler = hiZSampler;
+
+            VkDescriptorBufferInfo materialInfo{};
+            materialInfo.buffer = materialBuffer;
+            materialInfo.offset = 0;
+            materialInfo.range = VK_WHOLE_SIZE;
+
+            std::array<VkDescriptorBufferInfo, 3> lightInfos{};
+            lightInfos[0].buffer = lightBuffer;
+            lightInfos[0].offset = 0;
+            lightInfos[0].range = VK_WHOLE_SIZE;
+            lightInfos[1].buffer = lightGridBuffers[i];
+            lightInfos[1].offset = 0;
+            lightInfos[1].range = VK_WHOLE_SIZE;
+            lightInfos[2].buffer = lightIndexBuffers[i];
+            lightInfos[2].offset = 0;
+            lightInfos[2].range = VK_WHOLE_SIZE;
+
+            std::array<VkWriteDescriptorSet, 12> descriptorWrites{};
             descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
             descriptorWrites[0].dstSet = descriptorSets[i];
             descriptorWrites[0].dstBinding = 0;
@@ -1321,8 +3008,108 @@ namespace app
             descriptorWrites[1].descriptorCount = 1;
             descriptorWrites[1].pImageInfo = &imageInfo;
 
+            for(const auto [j, storageBufferInfo] : storageBufferInfos | std::views::enumerate)
+            {
+                auto& write{descriptorWrites[j + 2]};
+                write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                write.dstSet = descriptorSets[i];
+                write.dstBinding = static_cast<std::uint32_t>(j + 2);
+                write.dstArrayElement = 0;
+                write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                write.descriptorCount = 1;
+                write.pBufferInfo = &storageBufferInfo;
+            }
+
+            descriptorWrites[7].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[7].dstSet = descriptorSets[i];
+            descriptorWrites[7].dstBinding = 7;
+            descriptorWrites[7].dstArrayElement = 0;
+            descriptorWrites[7].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            descriptorWrites[7].descriptorCount = 1;
+            descriptorWrites[7].pImageInfo = &hiZInfo;
+
+            descriptorWrites[8].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[8].dstSet = descriptorSets[i];
+            descriptorWrites[8].dstBinding = 8;
+            descriptorWrites[8].dstArrayElement = 0;
+            descriptorWrites[8].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[8].descriptorCount = 1;
+            descriptorWrites[8].pBufferInfo = &materialInfo;
+
+            for(const auto [j, lightInfo] : lightInfos | std::views::enumerate)
+            {
+                auto& write{descriptorWrites[j + 9]};
+                write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                write.dstSet = descriptorSets[i];
+                write.dstBinding = static_cast<std::uint32_t>(j + 9);
+                write.dstArrayElement = 0;
+                write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                write.descriptorCount = 1;
+                write.pBufferInfo = &lightInfo;
+            }
+
             vkUpdateDescriptorSets(device, static_cast<std::uint32_t>(std::size(descriptorWrites)), std::data(descriptorWrites), 0, nullptr);
         }
+        textureDescriptorVersions.assign(maxFramesInFlight, textureVersion);
+    }
+
+    void System::create_hi_z_descriptor_sets()
+    {
+        VkDescriptorSetAllocateInfo allocateInfo{};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocateInfo.descriptorPool = descriptorPool;
+        allocateInfo.descriptorSetCount = 1;
+        allocateInfo.pSetLayouts = &hiZDescriptorSetLayout;
+
+        if(vkAllocateDescriptorSets(device, &allocateInfo, &hiZDescriptorSet) != VK_SUCCESS)
+        {
+            throw std::runtime_error{"Error: failed to allocate Hi-Z descriptor set."};
+        }
+
+        VkDescriptorImageInfo sourceInfo{};
+        sourceInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        sourceInfo.imageView = occlusionDepthImageView;
+        sourceInfo.sampler = hiZSampler;
+
+        // Every array element has to be valid, so the ones past the last level repeat it; the shader never writes them.
+        std::array<VkDescriptorImageInfo, downsampleDestinationCount> destinationInfos{};
+        for(std::uint32_t i{0}; i < downsampleDestinationCount; ++i)
+        {
+            destinationInfos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            destinationInfos[i].imageView = hiZMipViews[std::min(i, hiZLevels - 1)];
+        }
+
+        VkDescriptorBufferInfo scratchInfo{};
+        scratchInfo.buffer = hiZScratchBuffer;
+        scratchInfo.offset = 0;
+        scratchInfo.range = VK_WHOLE_SIZE;
+
+        std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
+        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[0].dstSet = hiZDescriptorSet;
+        descriptorWrites[0].dstBinding = 0;
+        descriptorWrites[0].dstArrayElement = 0;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[0].descriptorCount = 1;
+        descriptorWrites[0].pImageInfo = &sourceInfo;
+
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = hiZDescriptorSet;
+        descriptorWrites[1].dstBinding = 1;
+        descriptorWrites[1].dstArrayElement = 0;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        descriptorWrites[1].descriptorCount = downsampleDestinationCount;
+        descriptorWrites[1].pImageInfo = std::data(destinationInfos);
+
+        descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[2].dstSet = hiZDescriptorSet;
+        descriptorWrites[2].dstBinding = 2;
+        descriptorWrites[2].dstArrayElement = 0;
+        descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[2].descriptorCount = 1;
+        descriptorWrites[2].pBufferInfo = &scratchInfo;
+
+        vkUpdateDescriptorSets(device, static_cast<std::uint32_t>(std::size(descriptorWrites)), std::data(descriptorWrites), 0, nullptr);
     }
 
     VkCommandBuffer System::begin_single_time_commands()
@@ -1359,78 +3146,9 @@ namespace app
         vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
     }
 
-    void System::transition_image_layout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, std::uint32_t mipLevels)
+    void System::create_command_buffers()
     {
-        VkCommandBuffer commandBuffer{begin_single_time_commands()};
-
-        VkImageMemoryBarrier barrier{};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.oldLayout = oldLayout;
-        barrier.newLayout = newLayout;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.image = image;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = mipLevels;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = 0;
-
-        VkPipelineStageFlags sourceStage{};
-        VkPipelineStageFlags destinationStage{};
-
-        if(oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-        {
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        }
-        else if(oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-        {
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        }
-        else
-        {
-            throw std::invalid_argument{"Error: unsupported layout transition."};
-        }
-
-        vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 
-                             0, nullptr, 1, &barrier);
-
-        end_single_time_commands(commandBuffer);
-    }
-
-    void System::copy_buffer_to_image(VkBuffer buffer, VkImage image, std::uint32_t width, std::uint32_t height)
-    {
-        VkCommandBuffer commandBuffer{begin_single_time_commands()};
-
-        VkBufferImageCopy region{};
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = 1;
-        region.imageOffset = {0, 0, 0};
-        region.imageExtent = {width, height, 1};
-        
-        vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-        end_single_time_commands(commandBuffer);
-    }
-
-    void System::create_command_buffers()
-    {
-        commandBuffers.resize(maxFramesInFlight);
+        commandBuffers.resize(maxFramesInFlight);
 
         VkCommandBufferAllocateInfo allocateInfo{};
         allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -1456,12 +3174,28 @@ namespace app
             throw std::runtime_error{"Error: failed to begin recordering command buffer."};
         }
 
+        if(timestampQueryPool != VK_NULL_HANDLE)
+        {
+            vkCmdResetQueryPool(commandBuffer, timestampQueryPool, currentFrame * 2, 2);
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, currentFrame * 2);
+            timestampFrames[currentFrame] = frameNumber;
+        }
+
+        record_texture_streaming(commandBuffer);
+        record_culling(commandBuffer, 0);
+        record_depth_pre_pass(commandBuffer);
+        record_hi_z(commandBuffer);
+        record_culling(commandBuffer, 1);
+        record_light_culling(commandBuffer);
+
+        renderExtent = resolution.render_extent(swapChainExtent);
+
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
         renderPassInfo.renderPass = renderPass;
-        renderPassInfo.framebuffer = swapChainFrameBuffers[imageIndex];
+        renderPassInfo.framebuffer = sceneFrameBuffer;
         renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = swapChainExtent;
+        renderPassInfo.renderArea.extent = renderExtent;
 
         std::array<VkClearValue, 3> clearValues{};
         clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
@@ -1471,40 +3205,307 @@ namespace app
         renderPassInfo.pClearValues = std::data(clearValues);
 
         vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline(options.shaderVariant));
 
         VkViewport viewport{};
         viewport.x = 0.0f; 
         viewport.y = 0.0f; 
-        viewport.width = static_cast<float>(swapChainExtent.width); 
-        viewport.height = static_cast<float>(swapChainExtent.height); 
+        viewport.width = static_cast<float>(renderExtent.width); 
+        viewport.height = static_cast<float>(renderExtent.height); 
         viewport.maxDepth = 0.0f; 
         viewport.maxDepth = 1.0f; 
         vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
         VkRect2D scissor{};
         scissor.offset = {0, 0};
-        scissor.extent = swapChainExtent;
+        scissor.extent = renderExtent;
         vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-        std::vector<VkBuffer> vertexBuffers{vertexBuffer};
-        std::vector<VkDeviceSize> offsets{0};
+        std::array<VkBuffer, 1> vertexBuffers{vertexBuffer};
+        std::array<VkDeviceSize, 1> offsets{0};
         vkCmdBindVertexBuffers(commandBuffer, 0, 1, std::data(vertexBuffers), std::data(offsets));
 
         vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 
         vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 
                                 0, 1, &descriptorSets[currentFrame], 0, nullptr);
-        vkCmdDrawIndexed(commandBuffer, static_cast<std::uint32_t>(std::size(indices)), 1, 0, 0, 0);
+
+        record_indirect_draws(commandBuffer, 0);
+        record_indirect_draws(commandBuffer, 1);
 
         vkCmdEndRenderPass(commandBuffer);
 
+        record_cull_statistics(commandBuffer);
+        record_upscale(commandBuffer, imageIndex);
+        record_readback(commandBuffer, imageIndex);
+
+        if(timestampQueryPool != VK_NULL_HANDLE)
+        {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, currentFrame * 2 + 1);
+        }
+
         if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
         {
             throw std::runtime_error{"Error: failed to record a command buffer!"};
         }
     }
 
+    void System::record_culling(VkCommandBuffer commandBuffer, std::uint32_t phase)
+    {
+        if(phase == 0)
+        {
+            vkCmdFillBuffer(commandBuffer, drawCountBuffers[currentFrame], 0, sizeof(CullStatistics), 0);
+
+            VkMemoryBarrier clearBarrier{};
+            clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+        }
+
+        CullConstants constants{};
+        constants.objectCount = static_cast<std::uint32_t>(std::size(objects));
+        constants.drawCapacity = max_draw_count();
+        constants.compact = supportedVulkan12Features.drawIndirectCount;
+        constants.phase = phase;
+        constants.hiZWidth = static_cast<float>(occlusionExtent.width);
+        constants.hiZHeight = static_cast<float>(occlusionExtent.height);
+        constants.hiZLevels = static_cast<float>(hiZLevels);
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 
+                                0, 1, &descriptorSets[currentFrame], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vkCmdDispatch(commandBuffer, (max_draw_count() + 63) / 64, 1, 1);
+
+        VkMemoryBarrier cullBarrier{};
+        cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 
+                             1, &cullBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    void System::record_indirect_draws(VkCommandBuffer commandBuffer, std::uint32_t phase)
+    {
+        const VkDeviceSize commandOffset{sizeof(VkDrawIndexedIndirectCommand) * max_draw_count() * phase};
+        const VkDeviceSize countOffset{sizeof(std::uint32_t) * phase};
+
+        if(supportedVulkan12Features.drawIndirectCount)
+        {
+            vkCmdDrawIndexedIndirectCount(commandBuffer, drawCommandBuffers[currentFrame], commandOffset, drawCountBuffers[currentFrame], 
+                                          countOffset, max_draw_count(), sizeof(VkDrawIndexedIndirectCommand));
+        }
+        else
+        {
+            vkCmdDrawIndexedIndirect(commandBuffer, drawCommandBuffers[currentFrame], commandOffset, max_draw_count(), 
+                                     sizeof(VkDrawIndexedIndirectCommand));
+        }
+    }
+
+    void System::record_depth_pre_pass(VkCommandBuffer commandBuffer)
+    {
+        VkClearValue clearValue{};
+        clearValue.depthStencil = {1.0f, 0};
+
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = depthPrePass;
+        renderPassInfo.framebuffer = depthPrePassFrameBuffer;
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = occlusionExtent;
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues = &clearValue;
+
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrePassPipeline);
+
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(occlusionExtent.width);
+        viewport.height = static_cast<float>(occlusionExtent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+        VkRect2D scissor{};
+        scissor.offset = {0, 0};
+        scissor.extent = occlusionExtent;
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        VkDeviceSize offset{0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 
+                                0, 1, &descriptorSets[currentFrame], 0, nullptr);
+
+        record_indirect_draws(commandBuffer, 0);
+
+        vkCmdEndRenderPass(commandBuffer);
+    }
+
+    void System::record_hi_z(VkCommandBuffer commandBuffer)
+    {
+        // The previous frame's late cull may still be sampling the pyramid that is about to be overwritten, and its
+        // downsample may still be counting workgroups in the scratch buffer.
+        VkMemoryBarrier clearBarrier{};
+        clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        clearBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        clearBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 
+                             1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+        // The last workgroup is the one that brings the counter to the workgroup count, so it starts from zero.
+        vkCmdFillBuffer(commandBuffer, hiZScratchBuffer, 0, sizeof(std::uint32_t), 0);
+
+        VkMemoryBarrier counterBarrier{};
+        counterBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        counterBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        counterBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &counterBarrier, 0, nullptr, 0, nullptr);
+
+        // Level 0 is the occlusion depth copied across, the rest of the pyramid comes out of the same dispatch.
+        auto constants{downsample_constants(occlusionExtent, hiZLevels - 1, true)};
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, hiZPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, hiZPipelineLayout, 
+                                0, 1, &hiZDescriptorSet, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, hiZPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vkCmdDispatch(commandBuffer, constants.workgroupCount, 1, 1);
+
+        VkMemoryBarrier pyramidBarrier{};
+        pyramidBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        pyramidBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        pyramidBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 
+                             1, &pyramidBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    void System::record_light_culling(VkCommandBuffer commandBuffer)
+    {
+        if(std::empty(lights))
+        {
+            return;
+        }
+
+        // Clusters reserve their runs of the index list by counting up from zero.
+        vkCmdFillBuffer(commandBuffer, lightIndexBuffers[currentFrame], 0, sizeof(std::uint32_t), 0);
+
+        VkMemoryBarrier counterBarrier{};
+        counterBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        counterBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        counterBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 
+                             1, &counterBarrier, 0, nullptr, 0, nullptr);
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, lightCullPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, lightCullPipelineLayout, 
+                                0, 1, &descriptorSets[currentFrame], 0, nullptr);
+        vkCmdDispatch(commandBuffer, lightClusterCount, 1, 1);
+
+        VkMemoryBarrier assignmentBarrier{};
+        assignmentBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        assignmentBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        assignmentBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 
+                             1, &assignmentBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    void System::record_cull_statistics(VkCommandBuffer commandBuffer)
+    {
+        VkMemoryBarrier readBarrier{};
+        readBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        readBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        readBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 
+                             1, &readBarrier, 0, nullptr, 0, nullptr);
+
+        VkBufferCopy region{};
+        region.size = sizeof(CullStatistics);
+        vkCmdCopyBuffer(commandBuffer, drawCountBuffers[currentFrame], cullStatisticsBuffers[currentFrame], 1, &region);
+
+        VkMemoryBarrier hostBarrier{};
+        hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 
+                             1, &hostBarrier, 0, nullptr, 0, nullptr);
+
+        cullStatisticsFrames[currentFrame] = frameNumber;
+    }
+
+    void System::record_upscale(VkCommandBuffer commandBuffer, std::uint32_t imageIndex)
+    {
+        std::array<VkImageMemoryBarrier, 2> barriers{};
+        for(auto& barrier : barriers)
+        {
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseMipLevel = 0;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = 1;
+        }
+
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barriers[0].image = sceneColorImage;
+        barriers[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[1].image = swapChainImages[imageIndex];
+        barriers[1].srcAccessMask = 0;
+        barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 
+                             static_cast<std::uint32_t>(std::size(barriers)), std::data(barriers));
+
+        VkImageBlit region{};
+        region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.srcSubresource.mipLevel = 0;
+        region.srcSubresource.baseArrayLayer = 0;
+        region.srcSubresource.layerCount = 1;
+        region.srcOffsets[0] = {0, 0, 0};
+        region.srcOffsets[1] = {static_cast<std::int32_t>(renderExtent.width), static_cast<std::int32_t>(renderExtent.height), 1};
+        region.dstSubresource = region.srcSubresource;
+        region.dstOffsets[0] = {0, 0, 0};
+        region.dstOffsets[1] = {static_cast<std::int32_t>(swapChainExtent.width), static_cast<std::int32_t>(swapChainExtent.height), 1};
+
+        vkCmdBlitImage(commandBuffer, sceneColorImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 
+                       swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, upscaleFilter);
+
+        auto& presentBarrier{barriers[1]};
+        presentBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        presentBarrier.newLayout = options.headless || capturing() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        presentBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        presentBarrier.dstAccessMask = options.headless || capturing() ? VK_ACCESS_TRANSFER_READ_BIT : 0;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, 
+                             options.headless || capturing() ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 
+                             0, 0, nullptr, 0, nullptr, 1, &presentBarrier);
+    }
+
+    void System::read_cull_statistics(std::uint32_t frame)
+    {
+        if(!cullStatisticsFrames[frame])
+        {
+            return;
+        }
+
+        CullStatistics statistics{};
+        memcpy(&statistics, cullStatisticsBuffersMapped[frame], sizeof(statistics));
+        profiler.record_culling(*cullStatisticsFrames[frame], {statistics.earlyDrawCount + statistics.lateDrawCount, 
+                                                               statistics.frustumCulledCount, statistics.occludedCount});
+        cullStatisticsFrames[frame].reset();
+    }
+
     void System::create_sync_objects()
     {
         imageAvailableSemaphores.resize(maxFramesInFlight);
@@ -1520,31 +3521,71 @@ namespace app
 
         for(const auto i : std::views::iota(0, maxFramesInFlight))
         {
-            if(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-               vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-               vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS)
+            if(vkCreateSemaphore(device, &semaphoreInfo, host_allocator(VK_OBJECT_TYPE_SEMAPHORE), &imageAvailableSemaphores[i]) != VK_SUCCESS ||
+               vkCreateSemaphore(device, &semaphoreInfo, host_allocator(VK_OBJECT_TYPE_SEMAPHORE), &renderFinishedSemaphores[i]) != VK_SUCCESS ||
+               vkCreateFence(device, &fenceInfo, host_allocator(VK_OBJECT_TYPE_FENCE), &inFlightFences[i]) != VK_SUCCESS)
             {
                 throw std::runtime_error{"Error: failed to create semaphores!"};
             }
         }
+
+        if(supportedVulkan12Features.timelineSemaphore)
+        {
+            VkSemaphoreTypeCreateInfo timelineInfo{};
+            timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+            timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+            timelineInfo.initialValue = 0;
+
+            VkSemaphoreCreateInfo timelineSemaphoreInfo{};
+            timelineSemaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            timelineSemaphoreInfo.pNext = &timelineInfo;
+
+            if(vkCreateSemaphore(device, &timelineSemaphoreInfo, host_allocator(VK_OBJECT_TYPE_SEMAPHORE), &frameTimeline) != VK_SUCCESS)
+            {
+                throw std::runtime_error{"Error: failed to create frame timeline semaphore."};
+            }
+        }
     }
 
     void System::draw_frame()
     {
+        auto frameStart{Profiler::Clock::now()};
         vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, std::numeric_limits<std::uint64_t>::max());
+        auto workStart{Profiler::Clock::now()};
+        auto heapAllocationsStart{thread_heap_allocations()};
+
+        // The fence covers everything the slot's previous frame handed to the GPU, so its scratch memory is free again.
+        auto& arena{frameArenas[currentFrame]};
+        arena.reset();
 
-        std::uint32_t imageIndex{0};
-        auto result{vkAcquireNextImageKHR(device, swapChain, std::numeric_limits<std::uint64_t>::max(), 
-                                          imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex)};
+        auto gpuMilliseconds{read_gpu_time(currentFrame)};
+        read_cull_statistics(currentFrame);
+        auto completedFrames{completed_frames()};
+        deletionQueue.flush(completedFrames);
+        collect_readbacks(completedFrames);
+        poll_shader_reload();
 
-        if(result == VK_ERROR_OUT_OF_DATE_KHR)
+        if(gpuMilliseconds && resolution.update(*gpuMilliseconds))
         {
-            recreate_swap_chain();
-            return;
+            recreate_render_targets();
         }
-        else if(result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+        update_texture_streaming();
+
+        std::uint32_t imageIndex{currentFrame};
+        if(!options.headless)
         {
-            throw std::runtime_error{"Error: failed to acquire swap chain image."};
+            auto result{vkAcquireNextImageKHR(device, swapChain, std::numeric_limits<std::uint64_t>::max(), 
+                                              imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex)};
+
+            if(result == VK_ERROR_OUT_OF_DATE_KHR)
+            {
+                recreate_swap_chain();
+                return;
+            }
+            else if(result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+            {
+                throw std::runtime_error{"Error: failed to acquire swap chain image."};
+            }
         }
 
         vkResetFences(device, 1, &inFlightFences[currentFrame]); 
@@ -1557,17 +3598,36 @@ namespace app
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-        std::vector<VkSemaphore> waitSemaphore{imageAvailableSemaphores[currentFrame]};
-        std::vector<VkPipelineStageFlags> waitStages{VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+        std::array<VkSemaphore, 1> waitSemaphore{imageAvailableSemaphores[currentFrame]};
+        std::array<VkPipelineStageFlags, 1> waitStages{VK_PIPELINE_STAGE_TRANSFER_BIT};
         
-        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.waitSemaphoreCount = options.headless ? 0 : 1;
         submitInfo.pWaitSemaphores = std::data(waitSemaphore);
         submitInfo.pWaitDstStageMask = std::data(waitStages);
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
 
-        std::vector<VkSemaphore> signalSemaphores{renderFinishedSemaphores[currentFrame]};
-        submitInfo.signalSemaphoreCount = 1;
+        std::pmr::vector<VkSemaphore> signalSemaphores{&arena};
+        std::pmr::vector<std::uint64_t> signalValues{&arena};
+        if(!options.headless)
+        {
+            signalSemaphores.push_back(renderFinishedSemaphores[currentFrame]);
+            signalValues.push_back(0);
+        }
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        if(frameTimeline != VK_NULL_HANDLE)
+        {
+            signalSemaphores.push_back(frameTimeline);
+            signalValues.push_back(frameNumber + 1);
+
+            timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timelineInfo.signalSemaphoreValueCount = static_cast<std::uint32_t>(std::size(signalValues));
+            timelineInfo.pSignalSemaphoreValues = std::data(signalValues);
+            submitInfo.pNext = &timelineInfo;
+        }
+
+        submitInfo.signalSemaphoreCount = static_cast<std::uint32_t>(std::size(signalSemaphores));
         submitInfo.pSignalSemaphores = std::data(signalSemaphores);
 
         if(vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
@@ -1575,48 +3635,90 @@ namespace app
             throw std::runtime_error{"Error: failed to submit to queue."};
         }
 
-        VkPresentInfoKHR presentInfo{};
-        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-        presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = std::data(signalSemaphores);
+        bool swapChainOutdated{false};
+        if(!options.headless)
+        {
+            VkPresentInfoKHR presentInfo{};
+            presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+            presentInfo.waitSemaphoreCount = 1;
+            presentInfo.pWaitSemaphores = std::data(signalSemaphores);
 
-        std::vector<VkSwapchainKHR> swapChains{swapChain};
+            std::array<VkSwapchainKHR, 1> swapChains{swapChain};
 
-        presentInfo.swapchainCount = 1;
-        presentInfo.pSwapchains = std::data(swapChains);
-        presentInfo.pImageIndices = &imageIndex;
-        presentInfo.pResults = nullptr;
+            presentInfo.swapchainCount = 1;
+            presentInfo.pSwapchains = std::data(swapChains);
+            presentInfo.pImageIndices = &imageIndex;
+            presentInfo.pResults = nullptr;
 
-        result = vkQueuePresentKHR(presentQueue, &presentInfo);
-        
-        if(result == VK_ERROR_OUT_OF_DATE_KHR || 
-           result == VK_SUBOPTIMAL_KHR ||
-           framebufferResized)
-        {
-            framebufferResized = false;
-            recreate_swap_chain();
+            auto result{vkQueuePresentKHR(presentQueue, &presentInfo)};
+            
+            if(result == VK_ERROR_OUT_OF_DATE_KHR || 
+               result == VK_SUBOPTIMAL_KHR ||
+               framebufferResized)
+            {
+                framebufferResized = false;
+                swapChainOutdated = true;
+            }
+            else if(result != VK_SUCCESS)
+            {
+                throw std::runtime_error{"Error: failed to present swap chain image."};
+            }
         }
-        else if(result != VK_SUCCESS)
+
+        auto frameEnd{Profiler::Clock::now()};
+        FrameSample sample{};
+        sample.frameMilliseconds = std::chrono::duration<double, std::milli>(frameStart - previousFrameStart).count();
+        sample.cpuMilliseconds = std::chrono::duration<double, std::milli>(frameEnd - workStart).count();
+        sample.renderScale = resolution.scale();
+        sample.msaaSamples = msaaSamples;
+        sample.textureResidentBytes = static_cast<double>(textureStreamer.resident_bytes());
+        sample.heapAllocations = static_cast<double>(thread_heap_allocations() - heapAllocationsStart);
+        sample.frameArenaBytes = static_cast<double>(arena.used());
+        profiler.record_frame(frameNumber, sample);
+        profiler.record_first_frame(frameEnd);
+        previousFrameStart = frameStart;
+
+        ++frameNumber;
+        if(frameNumber == options.warmupFrames)
         {
-            throw std::runtime_error{"Error: failed to present swap chain image."};
+            measurementStart = frameEnd;
         }
-
         currentFrame = (currentFrame + 1) % maxFramesInFlight;
+
+        if(swapChainOutdated)
+        {
+            recreate_swap_chain();
+        }
     }
 
     void System::update_uniform_buffer(std::uint32_t currentImage)
     {
-        static auto startTime{std::chrono::high_resolution_clock::now()};
-
-        auto currentTime{std::chrono::high_resolution_clock::now()};
-        float time{std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count()};
+        float time{static_cast<float>(frameNumber * options.fixedTimestep)};
+        if(options.fixedTimestep == 0.0)
+        {
+            time = std::chrono::duration<float, std::chrono::seconds::period>(Profiler::Clock::now() - startTime).count();
+        }
         
         UniformBufferObject ubo{};
         ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(45.0f), glm::vec3(0.0f, 0.0f, 1.0f));
         ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.projection = glm::perspective(glm::radians(45.0f), swapChainExtent.width / static_cast<float>(swapChainExtent.height), 1.0f, 10.0f);
+        ubo.projection = glm::perspective(glm::radians(45.0f), swapChainExtent.width / static_cast<float>(swapChainExtent.height), nearPlane, farPlane);
         ubo.projection[1][1] *= -1;
+        ubo.positionScale = positionScale;
+        ubo.positionOffset = positionOffset;
+        ubo.viewProjection = ubo.projection * ubo.view * ubo.model;
+        ubo.inverseProjection = glm::inverse(ubo.projection);
+        ubo.clusterViewport = glm::vec4{static_cast<float>(renderExtent.width), static_cast<float>(renderExtent.height), nearPlane, farPlane};
+        ubo.lightCount = static_cast<std::uint32_t>(std::size(lights));
         memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+        frameUniforms = ubo;
+
+        // A slot last received world matrices maxFramesInFlight frames ago; only batches changed since then are copied.
+        transforms.update(frameNumber);
+        transforms.write_models(objects, frameNumber);
+        constexpr auto slots{static_cast<std::uint64_t>(maxFramesInFlight)};
+        auto sinceFrame{frameNumber >= slots ? frameNumber - slots + 1 : 0};
+        transforms.write_models({static_cast<ObjectData*>(objectBuffersMapped[currentImage]), std::size(objects)}, sinceFrame);
     }
 
     void System::framebuffer_resize_callback(GLFWwindow* window, std::int32_t width, std::int32_t height)
@@ -1624,178 +3726,319 @@ namespace app
         auto appliacation{reinterpret_cast<System*>(glfwGetWindowUserPointer(window))};
         appliacation->framebufferResized = true;
     }
+
+    void System::key_callback(GLFWwindow* window, std::int32_t key, std::int32_t, std::int32_t action, std::int32_t)
+    {
+        // F9 dumps the device memory registry to stdout.
+        if(key == GLFW_KEY_F9 && action == GLFW_PRESS)
+        {
+            auto application{reinterpret_cast<System*>(glfwGetWindowUserPointer(window))};
+            application->memoryReportRequested = true;
+        }
+    }
     
-    void System::load_model()
+    void System::load_scene_description()
     {
-        tinyobj::attrib_t attribute{};
-        std::vector<tinyobj::shape_t> shapes{};
-        std::vector<tinyobj::material_t> materials{};
-        std::string warnings{};
-        std::string errors{};
-
-        if(!tinyobj::LoadObj(&attribute, &shapes, &materials, &warnings, &errors, std::data(modelPath))) 
+        scene = options.scenePath.empty() ? single_model_scene(modelPath, texturePath) : app::load_scene(options.scenePath);
+        if(!std::empty(scene.lights) || options.lightCount > 0)
         {
-            throw std::runtime_error(warnings + errors);
+            options.shaderVariant = options.shaderVariant.with(ShaderFeature::lit);
         }
+    }
 
-        std::unordered_map<Vertex, std::uint32_t> uniqueVertices{};
-        for(const auto& shape : shapes) 
+    void System::load_scene()
+    {
+        std::vector<MeshData> meshData(std::size(scene.meshes));
+        jobs.parallel_for(std::size(scene.meshes), 1, [&](std::size_t begin, std::size_t end)
         {
-            for(const auto& index : shape.mesh.indices) 
+            for(auto i{begin}; i < end; ++i)
             {
-                app::Vertex vertex{};
+                meshData[i] = load_obj(scene.meshes[i].modelPath);
+            }
+        });
 
-                vertex.position = {attribute.vertices[3 * index.vertex_index + 0],
-                                   attribute.vertices[3 * index.vertex_index + 1],
-                                   attribute.vertices[3 * index.vertex_index + 2]};
+        SceneGeometry geometry{};
+        for(std::size_t i{0}; i < std::size(meshData); ++i)
+        {
+            geometry.add_mesh(meshData[i], scene.meshes[i].material);
+        }
 
-                vertex.textureCoordinate = {attribute.texcoords[2 * index.texcoord_index + 0],
-                                            1.0f - attribute.texcoords[2 * index.texcoord_index + 1]};
+        vertices = std::move(geometry.vertices);
+        indices = std::move(geometry.indices);
+        meshes = std::move(geometry.meshes);
+    }
 
-                vertex.color = {1.0f, 1.0f, 1.0f};
+    void System::create_color_resources()
+    {
+        VkFormat colorFormat{swapChainImageFormat};
 
-                if(uniqueVertices.find(vertex) == std::end(uniqueVertices))
-                {
-                    uniqueVertices[vertex] = static_cast<std::uint32_t>(std::size(vertices));
-                    vertices.push_back(vertex);
-                }
+        VkFormatProperties formatProperties{};
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, colorFormat, &formatProperties);
 
-                indices.push_back(uniqueVertices[vertex]);
-            }
+        constexpr VkFormatFeatureFlags blitFeatures{VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT};
+        if((formatProperties.optimalTilingFeatures & blitFeatures) != blitFeatures)
+        {
+            throw std::runtime_error{"Error: swap chain image format does not support blitting."};
         }
-    }  
+        upscaleFilter = formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT ? 
+                        VK_FILTER_LINEAR : VK_FILTER_NEAREST;
 
-    void System::generate_mipmaps(VkImage image, VkFormat imageFormat, std::uint32_t width, std::uint32_t height, std::uint32_t mipLevels)
-    {
-        VkFormatProperties formatProperties{};
-        vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat, &formatProperties);
+        // Sized for a render scale of one; lower scales only shrink the viewport, so scale changes never reallocate.
+        create_image(swapChainExtent.width, swapChainExtent.height, 1, VK_SAMPLE_COUNT_1_BIT, colorFormat, VK_IMAGE_TILING_OPTIMAL,
+                     VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
+                     sceneColorImage, sceneColorImageMemory, MemoryCategory::color, "scene color");
+        sceneColorImageView = create_image_view(sceneColorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 
-        if(!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+        if(msaaSamples == VK_SAMPLE_COUNT_1_BIT)
         {
-            throw std::runtime_error{"Error: texture image format does not support linear blitting."};
+            return;
         }
 
-        VkCommandBuffer commandBuffer{begin_single_time_commands()};
+        create_image(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, colorFormat, VK_IMAGE_TILING_OPTIMAL,
+                     VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, colorImage, colorImageMemory, 
+                     MemoryCategory::color, "msaa color");
+        colorImageView = create_image_view(colorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+    }
 
-        VkImageMemoryBarrier barrier{};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.image = image;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-        barrier.subresourceRange.levelCount = 1;
+    void System::report_transient_attachments()
+    {
+        auto bytes{colorImageMemory.size() + depthImageMemory.size()};
+        auto savedBytes{(colorImageMemory.lazily_allocated() ? colorImageMemory.size() : 0) + 
+                        (depthImageMemory.lazily_allocated() ? depthImageMemory.size() : 0)};
+
+        std::println("Transient attachments at {}x{} with {}x MSAA: {:.1f} MiB, {:.1f} MiB lazily allocated.", 
+                     swapChainExtent.width, swapChainExtent.height, static_cast<std::uint32_t>(msaaSamples), 
+                     bytes / (1024.0 * 1024.0), savedBytes / (1024.0 * 1024.0));
+    }
 
-        struct
+    bool System::capturing() const
+    {
+        return !options.outputDirectory.empty();
+    }
+
+    void System::create_readback_buffers()
+    {
+        if(!capturing())
         {
-            std::int32_t width;
-            std::int32_t height;
-        } mip;
-
-        mip.width = width;
-        mip.height = height;
-
-        for(const auto i : std::views::iota(1u, mipLevels))
-        {
-            barrier.subresourceRange.baseMipLevel = i - 1;
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 
-                                 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-            VkImageBlit blit{};
-            blit.srcOffsets[0] = {0, 0, 0};
-            blit.srcOffsets[1] = {mip.width, mip.height, 1};
-            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.srcSubresource.mipLevel = i - 1;
-            blit.srcSubresource.baseArrayLayer = 0;
-            blit.srcSubresource.layerCount = 1;
-            blit.dstOffsets[0] = {0, 0, 0};
-            blit.dstOffsets[1] = {mip.width > 1 ? mip.width / 2 : 1, mip.height > 1 ? mip.height / 2 : 1, 1};
-            blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.dstSubresource.mipLevel = i;
-            blit.dstSubresource.baseArrayLayer = 0;
-            blit.dstSubresource.layerCount = 1;
-
-            vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, 
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
-
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 
-                                 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-            if(mip.width > 1)
-            {
-                mip.width /= 2;
-            }
+            return;
+        }
 
-            if(mip.height > 1)
-            {
-                mip.height /= 2;
-            }
+        std::filesystem::create_directories(options.outputDirectory);
+
+        // Frames rotate through more buffers than there are frames in flight, so by the time a slot comes around
+        // again its copy has long finished and the encoder has normally caught up too.
+        readbackBuffers.resize(readbackRingSize);
+        readbackBuffersMemory.resize(readbackRingSize);
+        readbackBuffersMapped.resize(readbackRingSize, nullptr);
+        readbackExtents.resize(readbackRingSize);
+        readbackFrames.resize(readbackRingSize);
+
+        for(std::size_t slot{0}; slot < readbackRingSize; ++slot)
+        {
+            readbackJobs.emplace_back();
+            create_readback_buffer(slot);
         }
-            
-        barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    }
 
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 
-                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+    void System::create_readback_buffer(std::size_t slot)
+    {
+        // The encoder reads every byte on the CPU, which is painfully slow from uncached memory.
+        VkMemoryPropertyFlags properties{VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+        if(find_memory_type(std::numeric_limits<std::uint32_t>::max(), properties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT))
+        {
+            properties |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        }
 
-        end_single_time_commands(commandBuffer);
+        VkDeviceSize bufferSize{static_cast<VkDeviceSize>(swapChainExtent.width) * swapChainExtent.height * 4};
+        create_buffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, readbackBuffers[slot], readbackBuffersMemory[slot], 
+                      MemoryCategory::readback, std::format("frame readback {}", slot));
+        vkMapMemory(device, readbackBuffersMemory[slot], 0, bufferSize, 0, &readbackBuffersMapped[slot]);
+        readbackExtents[slot] = swapChainExtent;
     }
-    
-    VkSampleCountFlagBits System::max_usable_sample_count()
+
+    void System::record_readback(VkCommandBuffer commandBuffer, std::uint32_t imageIndex)
     {
-        VkPhysicalDeviceProperties physicalDevicePropeties{};
-        vkGetPhysicalDeviceProperties(physicalDevice, &physicalDevicePropeties);
+        if(!capturing())
+        {
+            return;
+        }
 
-        VkSampleCountFlags counts{physicalDevicePropeties.limits.framebufferColorSampleCounts &  
-                                  physicalDevicePropeties.limits.framebufferDepthSampleCounts}; 
-        if(counts & VK_SAMPLE_COUNT_64_BIT)
+        // The slot's last copy is older than every frame in flight, so only its encoder can still be busy. Waiting
+        // for it throttles rendering to the encoding rate instead of dropping frames. The wait blocks rather than
+        // helping, which would run shader compiles or a pipeline rebuild in the middle of recording.
+        auto slot{static_cast<std::size_t>(frameNumber % readbackRingSize)};
+        if(!readbackJobs[slot].done())
         {
-            return VK_SAMPLE_COUNT_64_BIT;
+            ++captureStalls;
         }
-        else if(counts & VK_SAMPLE_COUNT_32_BIT)
+        jobs.wait_blocking(readbackJobs[slot]);
+
+        if(readbackExtents[slot].width != swapChainExtent.width || readbackExtents[slot].height != swapChainExtent.height)
         {
-            return VK_SAMPLE_COUNT_32_BIT;
-        }  
-        else if(counts & VK_SAMPLE_COUNT_16_BIT)
+            create_readback_buffer(slot);
+        }
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = 0;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {swapChainExtent.width, swapChainExtent.height, 1};
+
+        vkCmdCopyImageToBuffer(commandBuffer, swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 
+                               readbackBuffers[slot], 1, &region);
+
+        VkBufferMemoryBarrier hostBarrier{};
+        hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        hostBarrier.buffer = readbackBuffers[slot];
+        hostBarrier.offset = 0;
+        hostBarrier.size = VK_WHOLE_SIZE;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 
+                             0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+
+        if(!options.headless)
+        {
+            VkImageMemoryBarrier presentBarrier{};
+            presentBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            presentBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            presentBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            presentBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            presentBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            presentBarrier.image = swapChainImages[imageIndex];
+            presentBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            presentBarrier.subresourceRange.baseMipLevel = 0;
+            presentBarrier.subresourceRange.levelCount = 1;
+            presentBarrier.subresourceRange.baseArrayLayer = 0;
+            presentBarrier.subresourceRange.layerCount = 1;
+            presentBarrier.srcAccessMask = 0;
+            presentBarrier.dstAccessMask = 0;
+
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 
+                                 0, 0, nullptr, 0, nullptr, 1, &presentBarrier);
+        }
+
+        readbackFrames[slot] = frameNumber;
+    }
+
+    void System::collect_readbacks(std::uint64_t completedFrames)
+    {
+        for(std::size_t slot{0}; slot < std::size(readbackFrames); ++slot)
         {
-            return VK_SAMPLE_COUNT_16_BIT;
+            if(!readbackFrames[slot] || *readbackFrames[slot] >= completedFrames)
+            {
+                continue;
+            }
+
+            auto frame{*readbackFrames[slot]};
+            readbackFrames[slot].reset();
+            ++capturedFrames;
+
+            auto extent{readbackExtents[slot]};
+            auto swizzle{swapChainImageFormat == VK_FORMAT_B8G8R8A8_SRGB || swapChainImageFormat == VK_FORMAT_B8G8R8A8_UNORM};
+            auto format{options.captureFormat};
+            auto filename{options.outputDirectory / (format == CaptureFormat::png ? std::format("frame_{:05}.png", frame) : 
+                                                     std::format("frame_{:05}_{}x{}.rgba", frame, extent.width, extent.height))};
+
+            // The slot stays untouched until this job is waited on, so the encoder works on the mapped memory in place.
+            jobs.submit(readbackJobs[slot], [pixels = static_cast<std::uint8_t*>(readbackBuffersMapped[slot]), extent, swizzle, format, 
+                                             filename = std::move(filename)]
+            {
+                auto size{static_cast<std::size_t>(extent.width) * extent.height * 4};
+                if(swizzle)
+                {
+                    for(std::size_t i{0}; i < size; i += 4)
+                    {
+                        std::swap(pixels[i], pixels[i + 2]);
+                    }
+                }
+
+                if(format == CaptureFormat::png)
+                {
+                    file::write_png(filename, extent.width, extent.height, pixels);
+                }
+                else
+                {
+                    file::write_raw(filename, pixels, size);
+                }
+            });
         }
-        else if(counts & VK_SAMPLE_COUNT_8_BIT)
+    }
+
+    void System::drain_readbacks()
+    {
+        if(!capturing())
         {
-            return VK_SAMPLE_COUNT_8_BIT;
+            return;
         }
-        else if(counts & VK_SAMPLE_COUNT_4_BIT)
+
+        collect_readbacks(std::numeric_limits<std::uint64_t>::max());
+        for(auto& job : readbackJobs)
+        {
+            jobs.wait_blocking(job);
+        }
+        std::println("Captured {} frames to {}, waited on the encoder {} times.", capturedFrames, options.outputDirectory.string(), 
+                     captureStalls);
+    }
+
+    void System::create_timestamp_queries()
+    {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        std::uint32_t queueFamilyCount{0};
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, std::data(queueFamilies));
+
+        auto validBits{queueFamilies[find_queue_families(physicalDevice).graphicsFamily.value()].timestampValidBits};
+        if(validBits == 0 || properties.limits.timestampPeriod == 0.0f)
         {
-            return VK_SAMPLE_COUNT_4_BIT;
+            return;
         }
-        else if(counts & VK_SAMPLE_COUNT_2_BIT)
+
+        timestampPeriod = properties.limits.timestampPeriod;
+        timestampMask = validBits == 64 ? std::numeric_limits<std::uint64_t>::max() : (std::uint64_t{1} << validBits) - 1;
+        timestampFrames.resize(maxFramesInFlight);
+
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = static_cast<std::uint32_t>(maxFramesInFlight * 2);
+
+        if(vkCreateQueryPool(device, &queryPoolInfo, host_allocator(VK_OBJECT_TYPE_QUERY_POOL), &timestampQueryPool) != VK_SUCCESS)
         {
-            return VK_SAMPLE_COUNT_2_BIT;
+            throw std::runtime_error{"Error: failed to create timestamp query pool."};
         }
-        return VK_SAMPLE_COUNT_1_BIT;
     }
 
-    void System::create_color_resources()
+    std::optional<double> System::read_gpu_time(std::uint32_t frame)
     {
-        VkFormat colorFormat{swapChainImageFormat};
+        if(timestampQueryPool == VK_NULL_HANDLE || !timestampFrames[frame].has_value())
+        {
+            return std::nullopt;
+        }
 
-        create_image(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, colorFormat, VK_IMAGE_TILING_OPTIMAL,
-                     VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
-                     colorImage, colorImageMemory);
-        colorImageView = create_image_view(colorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+        std::optional<double> milliseconds{};
+        std::array<std::uint64_t, 2> timestamps{};
+        if(vkGetQueryPoolResults(device, timestampQueryPool, frame * 2, 2, sizeof(timestamps), std::data(timestamps), 
+                                 sizeof(std::uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+        {
+            auto ticks{(timestamps[1] - timestamps[0]) & timestampMask};
+            milliseconds = ticks * timestampPeriod / 1'000'000.0;
+            profiler.record_gpu_time(timestampFrames[frame].value(), *milliseconds);
+        }
+        timestampFrames[frame].reset();
+        return milliseconds;
     }
 }
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include <ranges>
+#include <stdexcept>
+
+#include "task_graph.hpp"
+
+namespace app
+{
+    TaskGraph::TaskId TaskGraph::add(std::string name, std::vector<TaskId> dependencies, std::move_only_function<void()> work,
+                                     Affinity affinity)
+    {
+        TaskId id{std::size(tasks)};
+        for(const auto dependency : dependencies)
+        {
+            if(dependency >= id)
+            {
+                throw std::invalid_argument{"Error: task " + name + " depends on an unknown task."};
+            }
+            tasks[dependency].dependents.push_back(id);
+        }
+
+        tasks.emplace_back(std::move(name), std::move(work), std::vector<TaskId>{}, std::size(dependencies), affinity);
+        return id;
+    }
+
+    void TaskGraph::run(ThreadPool& pool, Profiler& profiler)
+    {
+        this->pool = &pool;
+        this->profiler = &profiler;
+        pendingTasks = std::size(tasks);
+
+        auto roots{std::views::iota(TaskId{0}, std::size(tasks))
+                   | std::views::filter([this](TaskId id) { return tasks[id].remainingDependencies == 0; })
+                   | std::ranges::to<std::vector>()};
+        for(const auto id : roots)
+        {
+            schedule(id);
+        }
+
+        std::unique_lock lock{mutex};
+        while(pendingTasks > 0)
+        {
+            if(!std::empty(mainThreadTasks))
+            {
+                auto id{mainThreadTasks.front()};
+                mainThreadTasks.pop_front();
+
+                lock.unlock();
+                execute(id);
+                lock.lock();
+                continue;
+            }
+            condition.wait(lock);
+        }
+
+        if(error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    void TaskGraph::schedule(TaskId id)
+    {
+        if(tasks[id].affinity == Affinity::main)
+        {
+            {
+                std::lock_guard lock{mutex};
+                mainThreadTasks.push_back(id);
+            }
+            condition.notify_all();
+            return;
+        }
+
+        pool->submit([this, id] { execute(id); });
+    }
+
+    void TaskGraph::execute(TaskId id)
+    {
+        auto& task{tasks[id]};
+
+        bool failed{false};
+        {
+            std::lock_guard lock{mutex};
+            failed = task.skipped;
+        }
+
+        if(!failed)
+        {
+            try
+            {
+                profiler->measure_phase(task.name, task.work);
+            }
+            catch(...)
+            {
+                failed = true;
+                std::lock_guard lock{mutex};
+                if(!error)
+                {
+                    error = std::current_exception();
+                }
+            }
+        }
+
+        std::vector<TaskId> ready{};
+        {
+            std::lock_guard lock{mutex};
+            for(const auto dependent : task.dependents)
+            {
+                tasks[dependent].skipped |= failed;
+                if(--tasks[dependent].remainingDependencies == 0)
+                {
+                    ready.push_back(dependent);
+                }
+            }
+        }
+
+        for(const auto dependent : ready)
+        {
+            schedule(dependent);
+        }
+
+        std::lock_guard lock{mutex};
+        --pendingTasks;
+        condition.notify_all();
+    }
+}
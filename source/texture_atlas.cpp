@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <bit>
+#include <numeric>
+#include <stdexcept>
+
+#include "texture_atlas.hpp"
+
+namespace app
+{
+    namespace
+    {
+        std::uint32_t round_up(std::uint32_t value, std::uint32_t multiple)
+        {
+            return (value + multiple - 1) / multiple * multiple;
+        }
+
+        // Copies texture into layer with its edge texels repeated across the padded rectangle around it.
+        void blit_padded(const TextureData& texture, TextureData& layer, glm::uvec2 origin, glm::uvec2 paddedSize, std::uint32_t padding)
+        {
+            auto width{static_cast<std::int64_t>(texture.width)};
+            auto height{static_cast<std::int64_t>(texture.height)};
+            for(std::uint32_t y{0}; y < paddedSize.y; ++y)
+            {
+                auto sourceY{std::clamp<std::int64_t>(static_cast<std::int64_t>(y) - padding, 0, height - 1)};
+                for(std::uint32_t x{0}; x < paddedSize.x; ++x)
+                {
+                    auto sourceX{std::clamp<std::int64_t>(static_cast<std::int64_t>(x) - padding, 0, width - 1)};
+                    auto source{static_cast<std::size_t>((sourceY * width + sourceX) * 4)};
+                    auto target{(static_cast<std::size_t>(origin.y + y) * static_cast<std::size_t>(layer.width) + origin.x + x) * 4};
+                    std::copy_n(std::data(texture.pixels) + source, 4, std::data(layer.pixels) + target);
+                }
+            }
+        }
+
+        TextureData empty_layer(std::uint32_t extent)
+        {
+            auto side{static_cast<std::int32_t>(extent)};
+            return {side, side, std::vector<std::uint8_t>(static_cast<std::size_t>(extent) * extent * 4, 0)};
+        }
+    }
+
+    SkylinePacker::SkylinePacker(std::uint32_t width, std::uint32_t height)
+        : skyline{{0, 0, width}}, width{width}, height{height}
+    {
+    }
+
+    std::optional<glm::uvec2> SkylinePacker::insert(std::uint32_t rectangleWidth, std::uint32_t rectangleHeight)
+    {
+        std::optional<std::size_t> best{};
+        glm::uvec2 bestPosition{};
+        for(std::size_t i{0}; i < std::size(skyline); ++i)
+        {
+            auto x{skyline[i].x};
+            if(x + rectangleWidth > width)
+            {
+                break;
+            }
+
+            // The rectangle rests on the highest segment it spans.
+            std::uint32_t y{0};
+            std::uint32_t covered{0};
+            for(auto j{i}; covered < rectangleWidth; ++j)
+            {
+                y = std::max(y, skyline[j].y);
+                covered += skyline[j].width;
+            }
+
+            if(y + rectangleHeight <= height && (!best || y < bestPosition.y))
+            {
+                best = i;
+                bestPosition = {x, y};
+            }
+        }
+
+        if(!best)
+        {
+            return std::nullopt;
+        }
+
+        // Segments now under the rectangle are cut back or dropped, then equal neighbours merge.
+        Segment placed{bestPosition.x, bestPosition.y + rectangleHeight, rectangleWidth};
+        auto first{std::begin(skyline) + static_cast<std::ptrdiff_t>(*best)};
+        auto end{placed.x + placed.width};
+        auto last{first};
+        while(last != std::end(skyline) && last->x + last->width <= end)
+        {
+            ++last;
+        }
+        if(last != std::end(skyline) && last->x < end)
+        {
+            last->width -= end - last->x;
+            last->x = end;
+        }
+        skyline.insert(skyline.erase(first, last), placed);
+
+        for(std::size_t i{0}; i + 1 < std::size(skyline); )
+        {
+            if(skyline[i].y == skyline[i + 1].y)
+            {
+                skyline[i].width += skyline[i + 1].width;
+                skyline.erase(std::begin(skyline) + static_cast<std::ptrdiff_t>(i + 1));
+            }
+            else
+            {
+                ++i;
+            }
+        }
+        return bestPosition;
+    }
+
+    TextureAtlas pack_texture_atlas(std::span<const TextureData> textures, std::uint32_t padding)
+    {
+        if(std::empty(textures))
+        {
+            throw std::invalid_argument{"Error: cannot build a texture atlas without textures."};
+        }
+
+        std::uint32_t extent{0};
+        for(const auto& texture : textures)
+        {
+            extent = std::max({extent, static_cast<std::uint32_t>(texture.width), static_cast<std::uint32_t>(texture.height)});
+        }
+
+        TextureAtlas atlas{extent, {}, {}};
+        atlas.placements.resize(std::size(textures));
+
+        // Tallest first keeps the skyline flat.
+        std::vector<std::size_t> order(std::size(textures));
+        std::iota(std::begin(order), std::end(order), std::size_t{0});
+        std::ranges::sort(order, std::ranges::greater{}, [&](std::size_t i) { return textures[i].height; });
+
+        auto extentFloat{static_cast<float>(extent)};
+        auto sharedFootprint{static_cast<float>(std::bit_floor(padding)) / extentFloat};
+        std::vector<std::pair<std::uint32_t, SkylinePacker>> shared{};
+        for(auto i : order)
+        {
+            const auto& texture{textures[i]};
+            auto width{static_cast<std::uint32_t>(texture.width)};
+            auto height{static_cast<std::uint32_t>(texture.height)};
+            glm::vec2 scale{static_cast<float>(width) / extentFloat, static_cast<float>(height) / extentFloat};
+
+            glm::uvec2 paddedSize{round_up(width + 2 * padding, padding), round_up(height + 2 * padding, padding)};
+            if(std::max(paddedSize.x, paddedSize.y) > extent / 2)
+            {
+                auto layer{static_cast<std::uint32_t>(std::size(atlas.layers))};
+                atlas.layers.push_back(empty_layer(extent));
+                blit_padded(texture, atlas.layers.back(), {0, 0}, {extent, extent}, 0);
+                atlas.placements[i] = {{scale, 0.0f, 0.0f}, layer, 1.0f, {}};
+                continue;
+            }
+
+            std::optional<glm::uvec2> origin{};
+            std::uint32_t layer{0};
+            for(auto& [sharedLayer, packer] : shared)
+            {
+                if((origin = packer.insert(paddedSize.x, paddedSize.y)))
+                {
+                    layer = sharedLayer;
+                    break;
+                }
+            }
+            if(!origin)
+            {
+                layer = static_cast<std::uint32_t>(std::size(atlas.layers));
+                atlas.layers.push_back(empty_layer(extent));
+                origin = shared.emplace_back(layer, SkylinePacker{extent, extent}).second.insert(paddedSize.x, paddedSize.y);
+            }
+
+            blit_padded(texture, atlas.layers[layer], *origin, paddedSize, padding);
+            glm::vec2 offset{glm::vec2{*origin + padding} / extentFloat};
+            atlas.placements[i] = {{scale, offset}, layer, sharedFootprint, {}};
+        }
+        return atlas;
+    }
+
+    std::vector<MipLevel> build_atlas_mip_chain(const TextureAtlas& atlas, ThreadPool* pool)
+    {
+        std::vector<MipLevel> levels{};
+        for(const auto& layer : atlas.layers)
+        {
+            auto chain{build_mip_chain(layer, pool)};
+            if(std::empty(levels))
+            {
+                levels = std::move(chain);
+                continue;
+            }
+            for(std::size_t level{0}; level < std::size(levels); ++level)
+            {
+                levels[level].pixels.insert(std::end(levels[level].pixels), std::begin(chain[level].pixels), std::end(chain[level].pixels));
+                ++levels[level].layers;
+            }
+        }
+        return levels;
+    }
+}
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+#include "texture_streaming.hpp"
+#include "culling.hpp"
+
+namespace app
+{
+    namespace
+    {
+        std::array<float, 256> srgb_to_linear_table()
+        {
+            std::array<float, 256> table{};
+            for(std::size_t i{0}; i < std::size(table); ++i)
+            {
+                auto value{static_cast<float>(i) / 255.0f};
+                table[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+            }
+            return table;
+        }
+
+        std::uint8_t linear_to_srgb(float value)
+        {
+            value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+            return static_cast<std::uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+        }
+
+        void downsample_rows(const MipLevel& source, MipLevel& level, const std::array<float, 256>& toLinear, 
+                             std::uint32_t firstRow, std::uint32_t lastRow)
+        {
+            // Each texel averages the source span it covers, so odd edges are folded in rather than dropped.
+            for(auto y{firstRow}; y < lastRow; ++y)
+            {
+                auto top{y * source.height / level.height};
+                auto bottom{(y + 1) * source.height / level.height};
+                for(std::uint32_t x{0}; x < level.width; ++x)
+                {
+                    auto left{x * source.width / level.width};
+                    auto right{(x + 1) * source.width / level.width};
+
+                    std::array<float, 4> sum{};
+                    for(auto sourceY{top}; sourceY < bottom; ++sourceY)
+                    {
+                        for(auto sourceX{left}; sourceX < right; ++sourceX)
+                        {
+                            const auto* texel{&source.pixels[(static_cast<std::size_t>(sourceY) * source.width + sourceX) * 4]};
+                            sum[0] += toLinear[texel[0]];
+                            sum[1] += toLinear[texel[1]];
+                            sum[2] += toLinear[texel[2]];
+                            sum[3] += texel[3];
+                        }
+                    }
+
+                    auto count{static_cast<float>((bottom - top) * (right - left))};
+                    auto* texel{&level.pixels[(static_cast<std::size_t>(y) * level.width + x) * 4]};
+                    texel[0] = linear_to_srgb(sum[0] / count);
+                    texel[1] = linear_to_srgb(sum[1] / count);
+                    texel[2] = linear_to_srgb(sum[2] / count);
+                    texel[3] = static_cast<std::uint8_t>(std::lround(sum[3] / count));
+                }
+            }
+        }
+
+        MipLevel downsample(const MipLevel& source, const std::array<float, 256>& toLinear, ThreadPool* pool)
+        {
+            MipLevel level{std::max(source.width / 2, 1u), std::max(source.height / 2, 1u), {}};
+            level.pixels.resize(static_cast<std::size_t>(level.width) * level.height * 4);
+
+            // Rows are independent; a chunk of roughly 64K texels is enough to pay for handing it to another thread.
+            std::size_t grain{std::max<std::size_t>(65536 / level.width, 1)};
+            if(pool == nullptr || level.height <= grain)
+            {
+                downsample_rows(source, level, toLinear, 0, level.height);
+                return level;
+            }
+
+            pool->parallel_for(level.height, grain, [&](std::size_t begin, std::size_t end)
+            {
+                downsample_rows(source, level, toLinear, static_cast<std::uint32_t>(begin), static_cast<std::uint32_t>(end));
+            });
+            return level;
+        }
+
+        VkDeviceSize level_bytes(const MipLevel& level)
+        {
+            return static_cast<VkDeviceSize>(std::size(level.pixels));
+        }
+    }
+
+    std::vector<MipLevel> build_mip_chain(const TextureData& texture, ThreadPool* pool)
+    {
+        static const auto toLinear{srgb_to_linear_table()};
+
+        std::vector<MipLevel> levels{};
+        levels.push_back({static_cast<std::uint32_t>(texture.width), static_cast<std::uint32_t>(texture.height), texture.pixels});
+        while(levels.back().width > 1 || levels.back().height > 1)
+        {
+            auto next{downsample(levels.back(), toLinear, pool)};
+            levels.push_back(std::move(next));
+        }
+        return levels;
+    }
+
+    VkDeviceSize mip_chain_bytes(std::uint32_t width, std::uint32_t height)
+    {
+        VkDeviceSize bytes{0};
+        while(true)
+        {
+            bytes += static_cast<VkDeviceSize>(width) * height * 4;
+            if(width == 1 && height == 1)
+            {
+                return bytes;
+            }
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+        }
+    }
+
+    float projected_diameter(const glm::mat4& world, const glm::vec4& boundingSphere, const glm::mat4& view,
+                             const glm::mat4& projection, float viewportHeight)
+    {
+        auto center{view * world * glm::vec4{glm::vec3{boundingSphere}, 1.0f}};
+        auto radius{boundingSphere.w * max_scale(world)};
+        auto depth{-center.z};
+
+        // Up close the texture can never be sharp enough.
+        if(depth <= radius)
+        {
+            return std::numeric_limits<float>::infinity();
+        }
+        return radius * std::abs(projection[1][1]) * viewportHeight / depth;
+    }
+
+    std::uint32_t wanted_mip_level(std::uint32_t textureExtent, float projectedPixels, std::uint32_t levelCount)
+    {
+        if(projectedPixels <= 0.0f)
+        {
+            return levelCount - 1;
+        }
+
+        auto level{std::floor(std::log2(static_cast<float>(textureExtent) / projectedPixels))};
+        return static_cast<std::uint32_t>(std::clamp(level, 0.0f, static_cast<float>(levelCount - 1)));
+    }
+
+    TextureStreamer::TextureStreamer(VkDeviceSize budgetBytes)
+        : budgetBytes{budgetBytes}
+    {
+    }
+
+    std::size_t TextureStreamer::add(std::vector<MipLevel> levels, std::uint32_t tailExtent)
+    {
+        if(std::empty(levels))
+        {
+            throw std::invalid_argument{"Error: a streamed texture needs at least one mip level."};
+        }
+
+        auto tail{static_cast<std::uint32_t>(std::size(levels)) - 1};
+        while(tail > 0 && std::max(levels[tail - 1].width, levels[tail - 1].height) <= tailExtent)
+        {
+            --tail;
+        }
+
+        for(auto level{tail}; level < std::size(levels); ++level)
+        {
+            residentTotal += level_bytes(levels[level]);
+        }
+
+        textures.push_back({std::move(levels), tail, tail, tail, 0});
+        return std::size(textures) - 1;
+    }
+
+    void TextureStreamer::set_upload_budget(VkDeviceSize bytes)
+    {
+        uploadBudgetBytes = bytes;
+    }
+
+    void TextureStreamer::request(std::size_t texture, std::uint32_t level, std::uint64_t frame)
+    {
+        auto& streamed{textures.at(texture)};
+        streamed.wantedLevel = std::min(level, static_cast<std::uint32_t>(std::size(streamed.levels)) - 1);
+        streamed.lastRequest = frame;
+    }
+
+    std::span<const StreamingChange> TextureStreamer::update()
+    {
+        updateOrder.resize(std::size(textures));
+        std::iota(std::begin(updateOrder), std::end(updateOrder), std::size_t{0});
+        std::ranges::sort(updateOrder, std::ranges::greater{}, [this](std::size_t i) { return textures[i].lastRequest; });
+
+        // Loading one level per texture and update spreads the upload cost over several frames.
+        auto& changes{updateChanges};
+        changes.clear();
+        VkDeviceSize uploaded{0};
+        for(const auto i : updateOrder)
+        {
+            auto& texture{textures[i]};
+            if(texture.wantedLevel >= texture.firstResident)
+            {
+                continue;
+            }
+
+            auto cost{level_bytes(texture.levels[texture.firstResident - 1])};
+            if(uploaded > 0 && uploaded + cost > uploadBudgetBytes)
+            {
+                continue;
+            }
+
+            while(residentTotal + cost > budgetBytes && evict_one(i, changes))
+            {
+            }
+
+            if(residentTotal + cost > budgetBytes)
+            {
+                continue;
+            }
+
+            --texture.firstResident;
+            residentTotal += cost;
+            uploaded += cost;
+            record_change(changes, i, texture.firstResident);
+        }
+        return changes;
+    }
+
+    bool TextureStreamer::evict_one(std::size_t requester, std::vector<StreamingChange>& changes)
+    {
+        // Levels finer than their texture currently wants go first, then whatever was requested longest ago.
+        auto rank{[this](std::size_t i)
+        {
+            const auto& texture{textures[i]};
+            return std::pair{texture.firstResident >= texture.wantedLevel, texture.lastRequest};
+        }};
+
+        std::optional<std::size_t> victim{};
+        for(std::size_t i{0}; i < std::size(textures); ++i)
+        {
+            const auto& texture{textures[i]};
+            if(i == requester || texture.firstResident >= texture.tailLevel)
+            {
+                continue;
+            }
+
+            bool surplus{texture.firstResident < texture.wantedLevel};
+            if(!surplus && texture.lastRequest >= textures[requester].lastRequest)
+            {
+                continue;
+            }
+
+            if(!victim || rank(i) < rank(*victim))
+            {
+                victim = i;
+            }
+        }
+
+        if(!victim)
+        {
+            return false;
+        }
+
+        auto& texture{textures[*victim]};
+        residentTotal -= level_bytes(texture.levels[texture.firstResident]);
+        ++texture.firstResident;
+        record_change(changes, *victim, texture.firstResident);
+        return true;
+    }
+
+    void TextureStreamer::record_change(std::vector<StreamingChange>& changes, std::size_t texture, std::uint32_t firstLevel)
+    {
+        auto found{std::ranges::find(changes, texture, &StreamingChange::texture)};
+        if(found != std::end(changes))
+        {
+            found->firstLevel = firstLevel;
+            return;
+        }
+        changes.push_back({texture, firstLevel});
+    }
+
+    std::uint32_t TextureStreamer::first_resident_level(std::size_t texture) const
+    {
+        return textures.at(texture).firstResident;
+    }
+
+    std::uint32_t TextureStreamer::level_count(std::size_t texture) const
+    {
+        return static_cast<std::uint32_t>(std::size(textures.at(texture).levels));
+    }
+
+    const MipLevel& TextureStreamer::level(std::size_t texture, std::uint32_t level) const
+    {
+        return textures.at(texture).levels.at(level);
+    }
+
+    VkDeviceSize TextureStreamer::resident_bytes() const
+    {
+        return residentTotal;
+    }
+}
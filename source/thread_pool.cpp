@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <utility>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#elif defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+#include "thread_pool.hpp"
+
+namespace app
+{
+    namespace
+    {
+        thread_local const ThreadPool* workerPool{nullptr};
+        thread_local std::size_t workerQueue{0};
+
+        void pin_current_thread(std::size_t index)
+        {
+            auto cores{std::max(std::thread::hardware_concurrency(), 1u)};
+            #if defined(_WIN32)
+                SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{1} << (index % std::min(cores, 64u)));
+            #elif defined(__linux__)
+                cpu_set_t set{};
+                CPU_ZERO(&set);
+                CPU_SET(index % cores, &set);
+                pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            #else
+                static_cast<void>(index);
+                static_cast<void>(cores);
+            #endif
+        }
+    }
+
+    bool JobCounter::done() const
+    {
+        return pending.load(std::memory_order_acquire) == 0;
+    }
+
+    ThreadPool::ThreadPool(std::size_t threadCount, bool pinThreads)
+    {
+        threadCount = std::max<std::size_t>(threadCount, 1);
+
+        // One deque per worker plus the injection queue at the end for everyone else.
+        for(std::size_t i{0}; i <= threadCount; ++i)
+        {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for(std::size_t i{0}; i < threadCount; ++i)
+        {
+            workers.emplace_back([this, i, pinThreads](std::stop_token stopToken) { worker(stopToken, i, pinThreads); });
+        }
+    }
+
+    void ThreadPool::submit(std::move_only_function<void()> task)
+    {
+        // Counted before it becomes visible so a thief can never take the count below zero.
+        queuedTasks.fetch_add(1, std::memory_order_release);
+        {
+            auto& queue{*queues[current_queue()]};
+            std::lock_guard lock{queue.mutex};
+            queue.tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard lock{sleepMutex};
+        }
+        condition.notify_one();
+    }
+
+    void ThreadPool::submit(JobCounter& counter, std::move_only_function<void()> task)
+    {
+        counter.pending.fetch_add(1, std::memory_order_relaxed);
+        submit([&counter, task = std::move(task)]() mutable
+        {
+            {
+                // The job is destroyed before the count drops, since the waiter may free what it captured.
+                auto work{std::move(task)};
+                try
+                {
+                    work();
+                }
+                catch(...)
+                {
+                    std::lock_guard lock{counter.mutex};
+                    if(!counter.error)
+                    {
+                        counter.error = std::current_exception();
+                    }
+                }
+            }
+            // The last job takes the count to zero under the lock: a waiter that sees zero locks the mutex before it
+            // returns, so the counter cannot be freed while the sleepers are being woken.
+            auto pending{counter.pending.load(std::memory_order_relaxed)};
+            while(pending > 1 && !counter.pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel))
+            {
+            }
+            if(pending <= 1)
+            {
+                std::lock_guard lock{counter.mutex};
+                if(counter.pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    counter.pending.notify_all();
+                }
+            }
+        });
+    }
+
+    void ThreadPool::wait(JobCounter& counter)
+    {
+        auto queue{current_queue()};
+        while(!counter.done())
+        {
+            if(!run_one(queue))
+            {
+                std::this_thread::yield();
+            }
+        }
+        rethrow_error(counter);
+    }
+
+    void ThreadPool::wait_blocking(JobCounter& counter)
+    {
+        for(auto pending{counter.pending.load(std::memory_order_acquire)}; pending > 0; 
+            pending = counter.pending.load(std::memory_order_acquire))
+        {
+            counter.pending.wait(pending, std::memory_order_acquire);
+        }
+        rethrow_error(counter);
+    }
+
+    void ThreadPool::rethrow_error(JobCounter& counter)
+    {
+        std::lock_guard lock{counter.mutex};
+        if(counter.error)
+        {
+            std::rethrow_exception(std::exchange(counter.error, nullptr));
+        }
+    }
+
+    std::size_t ThreadPool::size() const
+    {
+        return std::size(workers);
+    }
+
+    std::size_t ThreadPool::current_queue() const
+    {
+        return workerPool == this ? workerQueue : std::size(queues) - 1;
+    }
+
+    std::optional<std::move_only_function<void()>> ThreadPool::take(std::size_t queue)
+    {
+        {
+            auto& own{*queues[queue]};
+            std::lock_guard lock{own.mutex};
+            if(!std::empty(own.tasks))
+            {
+                auto task{std::move(own.tasks.back())};
+                own.tasks.pop_back();
+                queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+                return task;
+            }
+        }
+
+        // Steal the oldest job, which on a forking workload tends to be the largest remaining piece.
+        for(std::size_t offset{1}; offset < std::size(queues); ++offset)
+        {
+            auto& victim{*queues[(queue + offset) % std::size(queues)]};
+            std::lock_guard lock{victim.mutex};
+            if(!std::empty(victim.tasks))
+            {
+                auto task{std::move(victim.tasks.front())};
+                victim.tasks.pop_front();
+                queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+                return task;
+            }
+        }
+        return std::nullopt;
+    }
+
+    bool ThreadPool::run_one(std::size_t queue)
+    {
+        auto task{take(queue)};
+        if(!task)
+        {
+            return false;
+        }
+        (*task)();
+        return true;
+    }
+
+    void ThreadPool::worker(std::stop_token stopToken, std::size_t index, bool pin)
+    {
+        workerPool = this;
+        workerQueue = index;
+        if(pin)
+        {
+            pin_current_thread(index);
+        }
+
+        while(true)
+        {
+            if(run_one(index))
+            {
+                continue;
+            }
+
+            std::unique_lock lock{sleepMutex};
+            if(!condition.wait(lock, stopToken, [this] { return queuedTasks.load(std::memory_order_acquire) > 0; }))
+            {
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,233 @@
+#include <algorithm>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <xmmintrin.h>
+    #define TRANSFORM_SSE
+#endif
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "transform.hpp"
+
+namespace app
+{
+    namespace
+    {
+        // The batch math is written once against these few operations; the widest instruction set available picks
+        // how many objects share one register.
+        #if defined(__AVX2__)
+            using Lanes = __m256;
+            constexpr std::size_t laneCount{8};
+            Lanes load(const float* values) { return _mm256_loadu_ps(values); }
+            Lanes splat(float value) { return _mm256_set1_ps(value); }
+            Lanes plus(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+            Lanes minus(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+            Lanes times(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+        #elif defined(TRANSFORM_SSE)
+            using Lanes = __m128;
+            constexpr std::size_t laneCount{4};
+            Lanes load(const float* values) { return _mm_loadu_ps(values); }
+            Lanes splat(float value) { return _mm_set1_ps(value); }
+            Lanes plus(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+            Lanes minus(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+            Lanes times(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+        #else
+            using Lanes = float;
+            constexpr std::size_t laneCount{1};
+            Lanes load(const float* values) { return *values; }
+            Lanes splat(float value) { return value; }
+            Lanes plus(Lanes a, Lanes b) { return a + b; }
+            Lanes minus(Lanes a, Lanes b) { return a - b; }
+            Lanes times(Lanes a, Lanes b) { return a * b; }
+        #endif
+
+        static_assert(TransformSystem::batchSize % laneCount == 0, "A batch must split evenly into SIMD registers.");
+
+        // elements[column * 4 + row] holds that matrix element for every lane. Plain arrays, since std::array would
+        // drop the vector types' alignment attributes.
+        using MatrixLanes = Lanes[16];
+
+        #if defined(__AVX2__) || defined(TRANSFORM_SSE)
+            void store_four(const __m128 (&elements)[16], glm::mat4* out)
+            {
+                for(std::size_t column{0}; column < 4; ++column)
+                {
+                    auto r0{elements[column * 4 + 0]};
+                    auto r1{elements[column * 4 + 1]};
+                    auto r2{elements[column * 4 + 2]};
+                    auto r3{elements[column * 4 + 3]};
+                    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                    _mm_storeu_ps(&out[0][column][0], r0);
+                    _mm_storeu_ps(&out[1][column][0], r1);
+                    _mm_storeu_ps(&out[2][column][0], r2);
+                    _mm_storeu_ps(&out[3][column][0], r3);
+                }
+            }
+        #endif
+
+        void store(const MatrixLanes& elements, glm::mat4* out)
+        {
+            #if defined(__AVX2__)
+                __m128 low[16];
+                __m128 high[16];
+                for(std::size_t i{0}; i < 16; ++i)
+                {
+                    low[i] = _mm256_castps256_ps128(elements[i]);
+                    high[i] = _mm256_extractf128_ps(elements[i], 1);
+                }
+                store_four(low, out);
+                store_four(high, out + 4);
+            #elif defined(TRANSFORM_SSE)
+                store_four(elements, out);
+            #else
+                for(std::size_t i{0}; i < 16; ++i)
+                {
+                    (*out)[i / 4][i % 4] = elements[i];
+                }
+            #endif
+        }
+    }
+
+    glm::mat4 to_matrix(const Transform& transform)
+    {
+        return glm::scale(glm::translate(glm::mat4{1.0f}, transform.position) * glm::mat4_cast(transform.rotation), transform.scale);
+    }
+
+    std::uint32_t TransformSystem::add(const Transform& transform)
+    {
+        if(count % batchSize == 0)
+        {
+            // Spare lanes hold the identity so a partly filled batch still computes sane matrices.
+            for(auto* component : {&positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ})
+            {
+                component->resize(count + batchSize, 0.0f);
+            }
+            for(auto* component : {&rotationW, &scaleX, &scaleY, &scaleZ})
+            {
+                component->resize(count + batchSize, 1.0f);
+            }
+            worlds.resize(count + batchSize, glm::mat4{1.0f});
+            dirtyBatches.push_back(1);
+            batchChangedFrames.push_back(0);
+        }
+
+        auto index{static_cast<std::uint32_t>(count++)};
+        set_position(index, transform.position);
+        set_rotation(index, transform.rotation);
+        set_scale(index, transform.scale);
+        return index;
+    }
+
+    void TransformSystem::set_position(std::uint32_t index, const glm::vec3& position)
+    {
+        positionX[index] = position.x;
+        positionY[index] = position.y;
+        positionZ[index] = position.z;
+        mark_dirty(index);
+    }
+
+    void TransformSystem::set_rotation(std::uint32_t index, const glm::quat& rotation)
+    {
+        rotationX[index] = rotation.x;
+        rotationY[index] = rotation.y;
+        rotationZ[index] = rotation.z;
+        rotationW[index] = rotation.w;
+        mark_dirty(index);
+    }
+
+    void TransformSystem::set_scale(std::uint32_t index, const glm::vec3& scale)
+    {
+        scaleX[index] = scale.x;
+        scaleY[index] = scale.y;
+        scaleZ[index] = scale.z;
+        mark_dirty(index);
+    }
+
+    std::size_t TransformSystem::update(std::uint64_t frame)
+    {
+        std::size_t updated{0};
+        for(std::size_t batch{0}; batch < std::size(dirtyBatches); ++batch)
+        {
+            if(dirtyBatches[batch] == 0)
+            {
+                continue;
+            }
+            compute_batch(batch);
+            dirtyBatches[batch] = 0;
+            batchChangedFrames[batch] = frame;
+            ++updated;
+        }
+        return updated;
+    }
+
+    std::size_t TransformSystem::write_models(std::span<ObjectData> objects, std::uint64_t sinceFrame) const
+    {
+        auto limit{std::min(count, std::size(objects))};
+        std::size_t written{0};
+        for(std::size_t batch{0}; batch < std::size(batchChangedFrames); ++batch)
+        {
+            if(batchChangedFrames[batch] < sinceFrame)
+            {
+                continue;
+            }
+            for(auto i{batch * batchSize}; i < std::min((batch + 1) * batchSize, limit); ++i)
+            {
+                objects[i].model = worlds[i];
+                ++written;
+            }
+        }
+        return written;
+    }
+
+    const glm::mat4& TransformSystem::world(std::uint32_t index) const
+    {
+        return worlds[index];
+    }
+
+    std::size_t TransformSystem::size() const
+    {
+        return count;
+    }
+
+    void TransformSystem::mark_dirty(std::uint32_t index)
+    {
+        dirtyBatches[index / batchSize] = 1;
+    }
+
+    void TransformSystem::compute_batch(std::size_t batch)
+    {
+        for(auto first{batch * batchSize}; first < (batch + 1) * batchSize; first += laneCount)
+        {
+            auto x{load(&rotationX[first])};
+            auto y{load(&rotationY[first])};
+            auto z{load(&rotationZ[first])};
+            auto w{load(&rotationW[first])};
+            auto sx{load(&scaleX[first])};
+            auto sy{load(&scaleY[first])};
+            auto sz{load(&scaleZ[first])};
+
+            auto one{splat(1.0f)};
+            auto two{splat(2.0f)};
+            auto zero{splat(0.0f)};
+            auto xx{times(x, x)};
+            auto yy{times(y, y)};
+            auto zz{times(z, z)};
+            auto xy{times(x, y)};
+            auto xz{times(x, z)};
+            auto yz{times(y, z)};
+            auto wx{times(w, x)};
+            auto wy{times(w, y)};
+            auto wz{times(w, z)};
+
+            // Same element order as glm::mat4_cast, each rotation column scaled by its axis.
+            MatrixLanes elements{
+                times(minus(one, times(two, plus(yy, zz))), sx), times(times(two, plus(xy, wz)), sx), times(times(two, minus(xz, wy)), sx), zero,
+                times(times(two, minus(xy, wz)), sy), times(minus(one, times(two, plus(xx, zz))), sy), times(times(two, plus(yz, wx)), sy), zero,
+                times(times(two, plus(xz, wy)), sz), times(times(two, minus(yz, wx)), sz), times(minus(one, times(two, plus(xx, yy))), sz), zero,
+                load(&positionX[first]), load(&positionY[first]), load(&positionZ[first]), one};
+            store(elements, &worlds[first]);
+        }
+    }
+}
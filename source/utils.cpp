@@ -1,5 +1,8 @@
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <limits>
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/hash.hpp>
@@ -46,6 +49,75 @@ namespace app
                textureCoordinate == that.textureCoordinate;
     }
 
+    VkVertexInputBindingDescription QuantizedVertex::binding_description()
+    {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(QuantizedVertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return bindingDescription;
+    }
+
+    std::array<VkVertexInputAttributeDescription, 3> QuantizedVertex::attribute_description()
+    {
+        std::array<VkVertexInputAttributeDescription, 3> attributeDescription{};
+        attributeDescription[0].binding = 0;
+        attributeDescription[0].location = 0;
+        attributeDescription[0].format = VK_FORMAT_R16G16B16A16_SNORM;
+        attributeDescription[0].offset = offsetof(QuantizedVertex, position);
+
+        attributeDescription[1].binding = 0;
+        attributeDescription[1].location = 1;
+        attributeDescription[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+        attributeDescription[1].offset = offsetof(QuantizedVertex, color);
+
+        attributeDescription[2].binding = 0;
+        attributeDescription[2].location = 2;
+        attributeDescription[2].format = VK_FORMAT_R16G16_UNORM;
+        attributeDescription[2].offset = offsetof(QuantizedVertex, textureCoordinate);
+
+        return attributeDescription;
+    }
+
+    QuantizedMesh quantize_vertices(std::span<const Vertex> vertices)
+    {
+        glm::vec3 minimum{std::numeric_limits<float>::max()};
+        glm::vec3 maximum{std::numeric_limits<float>::lowest()};
+        for(const auto& vertex : vertices)
+        {
+            minimum = glm::min(minimum, vertex.position);
+            maximum = glm::max(maximum, vertex.position);
+        }
+
+        QuantizedMesh mesh{};
+        mesh.positionOffset = std::empty(vertices) ? glm::vec3{0.0f} : (minimum + maximum) * 0.5f;
+        mesh.positionScale = std::empty(vertices) ? glm::vec3{1.0f} : glm::max((maximum - minimum) * 0.5f, glm::vec3{1e-6f});
+
+        auto to_snorm{[](float value) 
+        {
+            return static_cast<std::int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+        }};
+        auto to_unorm8{[](float value) 
+        {
+            return static_cast<std::uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+        }};
+        auto to_unorm16{[](float value) 
+        {
+            return static_cast<std::uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+        }};
+
+        mesh.vertices.reserve(std::size(vertices));
+        for(const auto& vertex : vertices)
+        {
+            auto position{(vertex.position - mesh.positionOffset) / mesh.positionScale};
+            mesh.vertices.push_back({{to_snorm(position.x), to_snorm(position.y), to_snorm(position.z), 0},
+                                     {to_unorm8(vertex.color.r), to_unorm8(vertex.color.g), to_unorm8(vertex.color.b), 255},
+                                     {to_unorm16(vertex.textureCoordinate.x), to_unorm16(vertex.textureCoordinate.y)}});
+        }
+        return mesh;
+    }
+
     VkResult create_debug_utils_messanger_ext(VkInstance instance, 
                                               const VkDebugUtilsMessengerCreateInfoEXT* createInfo,
                                               const VkAllocationCallbacks* allocator,
@@ -0,0 +1,47 @@
+#ifndef CHECK_HPP
+#define CHECK_HPP
+
+#include <cstdlib>
+#include <exception>
+#include <format>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <print>
+#include <source_location>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace test
+{
+    inline void check(bool condition, std::string_view what, std::source_location location = std::source_location::current())
+    {
+        if(!condition)
+        {
+            throw std::runtime_error{std::format("Error: {}:{}: {}", location.file_name(), location.line(), what)};
+        }
+    }
+
+    // Runs each case in order and reports the first failure of each, so one broken case does not hide the rest.
+    inline int run(std::initializer_list<std::pair<std::string_view, std::function<void()>>> cases)
+    {
+        auto failures{0};
+        for(const auto& [name, body] : cases)
+        {
+            try
+            {
+                body();
+                std::println("passed {}", name);
+            }
+            catch(const std::exception& e)
+            {
+                std::println(std::cerr, "failed {}: {}", name, e.what());
+                ++failures;
+            }
+        }
+        return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+}
+
+#endif
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "check.hpp"
+#include "culling.hpp"
+#include "meshlet.hpp"
+#include "thread_pool.hpp"
+
+namespace
+{
+    using test::check;
+
+    struct Mesh
+    {
+        std::vector<app::Vertex> vertices;
+        std::vector<std::uint32_t> indices;
+    };
+
+    // A unit square in the z = 0 plane split into side * side quads, wound to face +z.
+    Mesh make_grid(std::uint32_t side)
+    {
+        Mesh mesh{};
+        for(std::uint32_t y{0}; y <= side; ++y)
+        {
+            for(std::uint32_t x{0}; x <= side; ++x)
+            {
+                glm::vec3 position{static_cast<float>(x) / side - 0.5f, static_cast<float>(y) / side - 0.5f, 0.0f};
+                mesh.vertices.push_back({position, glm::vec3{1.0f}, glm::vec2{}});
+            }
+        }
+        for(std::uint32_t y{0}; y < side; ++y)
+        {
+            for(std::uint32_t x{0}; x < side; ++x)
+            {
+                auto corner{y * (side + 1) + x};
+                mesh.indices.insert(std::end(mesh.indices), {corner, corner + 1, corner + side + 2, corner, corner + side + 2, corner + side + 1});
+            }
+        }
+        return mesh;
+    }
+
+    void check_meshlets(const app::MeshletSet& set, std::span<const std::uint32_t> indices, std::size_t maxVertices, std::size_t maxTriangles)
+    {
+        std::uint32_t triangleOffset{0};
+        for(const auto& meshlet : set.meshlets)
+        {
+            check(meshlet.vertexCount <= maxVertices, "meshlet exceeds the vertex limit");
+            check(meshlet.triangleCount <= maxTriangles, "meshlet exceeds the triangle limit");
+            check(meshlet.triangleCount > 0, "meshlet is empty");
+            check(meshlet.triangleOffset == triangleOffset, "meshlet triangles are not contiguous");
+            triangleOffset += meshlet.triangleCount;
+
+            for(const auto local : std::span{set.triangles}.subspan(meshlet.triangleOffset * 3, meshlet.triangleCount * 3))
+            {
+                check(local < meshlet.vertexCount, "local index outside its meshlet");
+            }
+        }
+        check(triangleOffset * 3 == std::size(indices), "meshlets do not cover every triangle");
+
+        // Triangles keep their order and winding, so the rebuilt list must be the input.
+        auto rebuilt{app::meshlet_indices(set)};
+        check(std::ranges::equal(rebuilt, indices), "meshlet indices differ from the input");
+    }
+
+    void meshlet_limits()
+    {
+        auto mesh{make_grid(40)};
+        auto set{app::build_meshlets(mesh.indices, std::size(mesh.vertices))};
+        check(std::size(set.meshlets) > 1, "grid fits in one meshlet");
+        check_meshlets(set, mesh.indices, app::maxMeshletVertices, app::maxMeshletTriangles);
+    }
+
+    void meshlet_small_limits()
+    {
+        auto mesh{make_grid(7)};
+        constexpr std::array<std::pair<std::size_t, std::size_t>, 4> limits{{{3, 1}, {4, 124}, {64, 2}, {255, 1'000}}};
+        for(const auto [maxVertices, maxTriangles] : limits)
+        {
+            auto set{app::build_meshlets(mesh.indices, std::size(mesh.vertices), maxVertices, maxTriangles)};
+            check_meshlets(set, mesh.indices, maxVertices, maxTriangles);
+        }
+    }
+
+    void meshlet_invalid_limits()
+    {
+        auto mesh{make_grid(2)};
+        constexpr std::array<std::pair<std::size_t, std::size_t>, 3> limits{{{2, 124}, {256, 124}, {64, 0}}};
+        for(const auto [maxVertices, maxTriangles] : limits)
+        {
+            auto threw{false};
+            try
+            {
+                app::build_meshlets(mesh.indices, std::size(mesh.vertices), maxVertices, maxTriangles);
+            }
+            catch(const std::invalid_argument&)
+            {
+                threw = true;
+            }
+            check(threw, "invalid limits were accepted");
+        }
+    }
+
+    void meshlet_bounds()
+    {
+        auto mesh{make_grid(40)};
+        auto set{app::build_meshlets(mesh.indices, std::size(mesh.vertices))};
+        for(const auto& meshlet : set.meshlets)
+        {
+            auto bounds{app::compute_meshlet_bounds(set, meshlet, mesh.vertices)};
+            for(const auto vertex : std::span{set.vertices}.subspan(meshlet.vertexOffset, meshlet.vertexCount))
+            {
+                check(glm::length(mesh.vertices[vertex].position - bounds.center) <= bounds.radius * 1.0001f, "vertex outside its sphere");
+            }
+            // A flat patch has every normal on the axis, so the cone has no spread.
+            check(glm::length(bounds.coneAxis - glm::vec3{0.0f, 0.0f, 1.0f}) < 1e-5f, "cone axis is not the face normal");
+            check(bounds.coneCutoff < 1e-3f, "flat patch has a cone spread");
+        }
+    }
+
+    // The camera sits on +z looking at the origin, with the projection flipped for Vulkan the way the renderer does.
+    app::UniformBufferObject make_camera()
+    {
+        app::UniformBufferObject ubo{};
+        ubo.model = glm::mat4{1.0f};
+        ubo.view = glm::lookAt(glm::vec3{0.0f, 0.0f, 5.0f}, glm::vec3{0.0f}, glm::vec3{0.0f, 1.0f, 0.0f});
+        ubo.projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 10.0f);
+        ubo.projection[1][1] *= -1;
+        return ubo;
+    }
+
+    app::ObjectData make_object(const glm::mat4& model, const app::ClusterData& bounds, std::uint32_t firstCluster, std::uint32_t clusterCount)
+    {
+        return {model, bounds.boundingSphere, firstCluster, clusterCount, firstCluster, 0};
+    }
+
+    glm::mat4 translation(const glm::vec3& offset)
+    {
+        glm::mat4 model{1.0f};
+        model[3] = glm::vec4{offset, 1.0f};
+        return model;
+    }
+
+    // Half a turn about x, which turns the grid's +z face away from the camera.
+    glm::mat4 flipped()
+    {
+        glm::mat4 model{1.0f};
+        model[1][1] = -1.0f;
+        model[2][2] = -1.0f;
+        return model;
+    }
+
+    // Each case is what in_view in cull.comp decides for the same object, cluster and camera.
+    void cull_cases()
+    {
+        auto mesh{make_grid(6)};
+        auto set{app::build_meshlets(mesh.indices, std::size(mesh.vertices))};
+        auto clusters{app::build_clusters(set, mesh.vertices)};
+        check(std::size(clusters) == 1, "small grid should be one cluster");
+        auto whole{app::whole_mesh_cluster(mesh.vertices, static_cast<std::uint32_t>(std::size(mesh.indices)))};
+        clusters.push_back(whole);
+        auto ubo{make_camera()};
+
+        auto drawn{[&](const glm::mat4& model, std::uint32_t cluster)
+        {
+            std::array objects{make_object(model, whole, cluster, 1)};
+            return std::size(app::cull_clusters(objects, clusters, ubo)) == 1;
+        }};
+
+        check(drawn(glm::mat4{1.0f}, 0), "front facing cluster was culled");
+        check(!drawn(flipped(), 0), "back facing cluster was drawn");
+        check(drawn(flipped(), 1), "cluster without a cone was backface culled");
+        check(!drawn(translation({100.0f, 0.0f, 0.0f}), 0), "object beside the frustum was drawn");
+        check(!drawn(translation({0.0f, 0.0f, 20.0f}), 1), "object behind the camera was drawn");
+        check(!drawn(translation({0.0f, 0.0f, -20.0f}), 1), "object past the far plane was drawn");
+
+        // The cone is tested from the camera's position, so a back face seen edge on from the side is still drawn.
+        ubo.view = glm::lookAt(glm::vec3{5.0f, 0.0f, 0.0f}, glm::vec3{0.0f}, glm::vec3{0.0f, 1.0f, 0.0f});
+        check(drawn(flipped(), 0), "cluster seen edge on was culled");
+    }
+
+    void cull_draw_commands()
+    {
+        auto mesh{make_grid(40)};
+        auto set{app::build_meshlets(mesh.indices, std::size(mesh.vertices))};
+        auto clusters{app::build_clusters(set, mesh.vertices)};
+        auto whole{app::whole_mesh_cluster(mesh.vertices, static_cast<std::uint32_t>(std::size(mesh.indices)))};
+        auto clusterCount{static_cast<std::uint32_t>(std::size(clusters))};
+
+        std::array objects{make_object(glm::mat4{1.0f}, whole, 0, clusterCount)};
+        auto draws{app::cull_clusters(objects, clusters, make_camera())};
+        check(std::size(draws) == clusterCount, "visible clusters were culled");
+        for(std::uint32_t i{0}; i < clusterCount; ++i)
+        {
+            check(draws[i].indexCount == clusters[i].indexCount && draws[i].firstIndex == clusters[i].firstIndex,
+                  "draw does not cover its cluster");
+            check(draws[i].instanceCount == 1 && draws[i].firstInstance == 0, "draw does not name its object");
+        }
+    }
+
+    // Objects spread past the frustum edges cull the same with and without the pool, and in the same order.
+    void cull_parallel_matches_serial()
+    {
+        auto mesh{make_grid(40)};
+        auto set{app::build_meshlets(mesh.indices, std::size(mesh.vertices))};
+        auto clusters{app::build_clusters(set, mesh.vertices)};
+        auto whole{app::whole_mesh_cluster(mesh.vertices, static_cast<std::uint32_t>(std::size(mesh.indices)))};
+        auto clusterCount{static_cast<std::uint32_t>(std::size(clusters))};
+
+        std::vector<app::ObjectData> objects{};
+        for(const auto& position : app::layout_object_grid(1'000, {glm::vec3{whole.boundingSphere}, whole.boundingSphere.w}))
+        {
+            auto model{translation(position * 0.2f)};
+            objects.push_back(make_object(std::size(objects) % 2 == 0 ? model : model * flipped(), whole, 0, clusterCount));
+        }
+
+        auto ubo{make_camera()};
+        auto serial{app::cull_clusters(objects, clusters, ubo)};
+        app::ThreadPool pool{4};
+        auto parallel{app::cull_clusters(objects, clusters, ubo, &pool)};
+
+        check(!std::empty(serial) && std::size(serial) < std::size(objects) * clusterCount, "camera should cull some clusters");
+        check(std::size(serial) == std::size(parallel), "parallel culling drew a different count");
+        for(std::size_t i{0}; i < std::size(serial); ++i)
+        {
+            check(serial[i].firstIndex == parallel[i].firstIndex && serial[i].firstInstance == parallel[i].firstInstance,
+                  "parallel culling drew in a different order");
+        }
+    }
+}
+
+// Meshlet building and the CPU cull reference, whose decisions cull.comp has to reproduce on the GPU.
+int main()
+{
+    return test::run({
+        {"meshlet_limits", meshlet_limits},
+        {"meshlet_small_limits", meshlet_small_limits},
+        {"meshlet_invalid_limits", meshlet_invalid_limits},
+        {"meshlet_bounds", meshlet_bounds},
+        {"cull_cases", cull_cases},
+        {"cull_draw_commands", cull_draw_commands},
+        {"cull_parallel_matches_serial", cull_parallel_matches_serial},
+    });
+}
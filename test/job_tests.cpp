@@ -0,0 +1,329 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "check.hpp"
+#include "profiler.hpp"
+#include "task_graph.hpp"
+#include "thread_pool.hpp"
+
+namespace
+{
+    using test::check;
+
+    constexpr std::size_t threadCount{4};
+
+    void submit_wait()
+    {
+        app::ThreadPool pool{threadCount};
+        app::JobCounter counter{};
+        std::atomic<std::uint32_t> runs{0};
+        for(std::uint32_t i{0}; i < 1'000; ++i)
+        {
+            pool.submit(counter, [&runs] { runs.fetch_add(1, std::memory_order_relaxed); });
+        }
+        pool.wait(counter);
+        check(counter.done(), "counter still pending after wait");
+        check(runs.load() == 1'000, "not every job ran");
+
+        // A counter is reusable once waited on.
+        pool.submit(counter, [&runs] { runs.fetch_add(1, std::memory_order_relaxed); });
+        pool.wait(counter);
+        check(runs.load() == 1'001, "second round did not run");
+    }
+
+    // Each job splits its range in two and waits for the halves, far deeper than there are workers to block.
+    std::uint64_t sum_range(app::ThreadPool& pool, std::uint64_t begin, std::uint64_t end)
+    {
+        if(end - begin <= 64)
+        {
+            std::uint64_t sum{0};
+            for(auto i{begin}; i < end; ++i)
+            {
+                sum += i;
+            }
+            return sum;
+        }
+
+        auto middle{begin + (end - begin) / 2};
+        std::uint64_t low{0};
+        std::uint64_t high{0};
+        app::JobCounter counter{};
+        pool.submit(counter, [&] { low = sum_range(pool, begin, middle); });
+        pool.submit(counter, [&] { high = sum_range(pool, middle, end); });
+        pool.wait(counter);
+        return low + high;
+    }
+
+    void nested_fork_join()
+    {
+        app::ThreadPool pool{threadCount};
+        constexpr std::uint64_t count{100'000};
+        check(sum_range(pool, 0, count) == count * (count - 1) / 2, "nested sum is wrong");
+
+        // A single worker has to run the whole tree itself while waiting.
+        app::ThreadPool single{1};
+        app::JobCounter counter{};
+        std::uint64_t sum{0};
+        single.submit(counter, [&] { sum = sum_range(single, 0, count); });
+        single.wait(counter);
+        check(sum == count * (count - 1) / 2, "nested sum on one worker is wrong");
+    }
+
+    void exception_propagation()
+    {
+        app::ThreadPool pool{threadCount};
+        app::JobCounter counter{};
+        std::atomic<std::uint32_t> runs{0};
+        for(std::uint32_t i{0}; i < 100; ++i)
+        {
+            pool.submit(counter, [&runs, i]
+            {
+                runs.fetch_add(1, std::memory_order_relaxed);
+                if(i % 10 == 3)
+                {
+                    throw std::runtime_error{"job failed"};
+                }
+            });
+        }
+
+        auto caught{false};
+        try
+        {
+            pool.wait(counter);
+        }
+        catch(const std::runtime_error& e)
+        {
+            caught = std::string_view{e.what()} == "job failed";
+        }
+        check(caught, "job exception was not rethrown by wait");
+        check(counter.done() && runs.load() == 100, "a failing job stopped the others");
+
+        // The error is handed out once, leaving the counter clean for the next round.
+        pool.submit(counter, [] {});
+        pool.wait(counter);
+    }
+
+    void parallel_for_coverage()
+    {
+        app::ThreadPool pool{threadCount};
+        for(const auto [count, grain] : std::array<std::pair<std::size_t, std::size_t>, 5>{{{10'007, 64}, {10'007, 1}, {1'000, 0},
+                                                                                              {5, 100}, {0, 16}}})
+        {
+            std::vector<std::atomic<std::uint32_t>> hits(count);
+            pool.parallel_for(count, grain, [&](std::size_t begin, std::size_t end)
+            {
+                check(begin < end && end <= count, "chunk outside the range");
+                check(end - begin <= std::max<std::size_t>(grain, 1), "chunk larger than the grain");
+                for(auto i{begin}; i < end; ++i)
+                {
+                    hits[i].fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+            check(std::ranges::all_of(hits, [](const auto& hit) { return hit.load() == 1; }), "index not visited exactly once");
+        }
+    }
+
+    // Producers fill their own deque and then block without helping, so every job they made has to be stolen.
+    void stealing_under_contention()
+    {
+        app::ThreadPool pool{threadCount};
+        constexpr std::size_t producerCount{threadCount / 2};
+        constexpr std::uint32_t jobsPerProducer{500};
+
+        std::mutex mutex;
+        std::set<std::thread::id> thieves{};
+        std::atomic<std::uint32_t> ranOnProducer{0};
+        std::atomic<std::uint32_t> runs{0};
+
+        app::JobCounter producers{};
+        for(std::size_t p{0}; p < producerCount; ++p)
+        {
+            pool.submit(producers, [&]
+            {
+                auto producer{std::this_thread::get_id()};
+                app::JobCounter counter{};
+                for(std::uint32_t i{0}; i < jobsPerProducer; ++i)
+                {
+                    pool.submit(counter, [&, producer]
+                    {
+                        auto thread{std::this_thread::get_id()};
+                        if(thread == producer)
+                        {
+                            ranOnProducer.fetch_add(1, std::memory_order_relaxed);
+                        }
+                        {
+                            std::lock_guard lock{mutex};
+                            thieves.insert(thread);
+                        }
+                        runs.fetch_add(1, std::memory_order_relaxed);
+                    });
+                }
+                pool.wait_blocking(counter);
+            });
+        }
+        pool.wait(producers);
+
+        check(runs.load() == producerCount * jobsPerProducer, "stolen jobs were lost");
+        check(ranOnProducer.load() == 0, "a job ran on the thread blocked on it");
+        check(!std::empty(thieves), "no job was stolen");
+    }
+
+    // While the only worker is held up, a blocking wait leaves the queued job alone where wait would run it.
+    void blocking_wait_runs_nothing()
+    {
+        app::ThreadPool pool{1};
+        auto mainThread{std::this_thread::get_id()};
+        std::atomic<bool> started{false};
+        std::atomic<bool> released{false};
+        std::atomic<bool> ranOnMain{false};
+
+        app::JobCounter held{};
+        pool.submit(held, [&]
+        {
+            started.store(true);
+            while(!released.load())
+            {
+                std::this_thread::yield();
+            }
+        });
+        while(!started.load())
+        {
+            std::this_thread::yield();
+        }
+
+        app::JobCounter queued{};
+        pool.submit(queued, [&] { ranOnMain.store(std::this_thread::get_id() == mainThread); });
+        std::jthread releaser{[&]
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds{20});
+            released.store(true);
+        }};
+
+        pool.wait_blocking(held);
+        check(!ranOnMain.load(), "blocking wait ran a queued job");
+        pool.wait_blocking(queued);
+        check(queued.done() && !ranOnMain.load(), "queued job did not run on the worker");
+
+        pool.submit(held, [] { throw std::runtime_error{"job failed"}; });
+        auto caught{false};
+        try
+        {
+            pool.wait_blocking(held);
+        }
+        catch(const std::runtime_error&)
+        {
+            caught = true;
+        }
+        check(caught, "job exception was not rethrown by wait_blocking");
+    }
+
+    void task_graph_order()
+    {
+        app::ThreadPool pool{threadCount};
+        app::Profiler profiler{};
+        app::TaskGraph graph{};
+
+        using TaskId = app::TaskGraph::TaskId;
+        auto mainThread{std::this_thread::get_id()};
+        std::atomic<std::uint32_t> sequence{0};
+        std::vector<std::uint32_t> finished(8);
+        std::vector<std::thread::id> threads(8);
+        auto record{[&](TaskId id)
+        {
+            return [&, id]
+            {
+                threads[id] = std::this_thread::get_id();
+                finished[id] = sequence.fetch_add(1);
+            };
+        }};
+
+        // A diamond feeding a chain, with main thread tasks at a root, in the middle and at the end.
+        std::vector<std::vector<TaskId>> dependencies{{}, {}, {0}, {0, 1}, {2, 3}, {4}, {1, 5}, {6}};
+        std::vector<app::TaskGraph::Affinity> affinities(8, app::TaskGraph::Affinity::any);
+        affinities[1] = affinities[4] = affinities[7] = app::TaskGraph::Affinity::main;
+        for(TaskId id{0}; id < std::size(dependencies); ++id)
+        {
+            check(graph.add("task " + std::to_string(id), dependencies[id], record(id), affinities[id]) == id, "ids are not sequential");
+        }
+        graph.run(pool, profiler);
+
+        for(TaskId id{0}; id < std::size(dependencies); ++id)
+        {
+            for(const auto dependency : dependencies[id])
+            {
+                check(finished[dependency] < finished[id], "task ran before its dependency");
+            }
+            if(affinities[id] == app::TaskGraph::Affinity::main)
+            {
+                check(threads[id] == mainThread, "main thread task ran on a worker");
+            }
+        }
+        check(std::size(profiler.phases()) == std::size(dependencies), "not every task was measured");
+    }
+
+    void task_graph_errors()
+    {
+        app::TaskGraph invalid{};
+        auto rejected{false};
+        try
+        {
+            invalid.add("forward", {0}, [] {});
+        }
+        catch(const std::invalid_argument&)
+        {
+            rejected = true;
+        }
+        check(rejected, "dependency on a later task was accepted");
+
+        // A failure skips what depends on it, directly or not, while unrelated tasks still run and run still returns.
+        app::ThreadPool pool{threadCount};
+        app::Profiler profiler{};
+        app::TaskGraph graph{};
+        std::atomic<bool> dependentRan{false};
+        std::atomic<bool> indirectRan{false};
+        std::atomic<bool> unrelatedRan{false};
+        auto failing{graph.add("failing", {}, [] { throw std::runtime_error{"task failed"}; })};
+        auto unrelated{graph.add("unrelated", {}, [&] { unrelatedRan = true; })};
+        auto dependent{graph.add("dependent", {failing}, [&] { dependentRan = true; }, app::TaskGraph::Affinity::main)};
+        graph.add("indirect", {dependent, unrelated}, [&] { indirectRan = true; });
+
+        auto caught{false};
+        try
+        {
+            graph.run(pool, profiler);
+        }
+        catch(const std::runtime_error&)
+        {
+            caught = true;
+        }
+        check(caught, "task exception was not rethrown by run");
+        check(!dependentRan && !indirectRan, "dependent of a failed task ran");
+        check(unrelatedRan, "a failure skipped an unrelated task");
+    }
+}
+
+// The job system and the startup task graph; also meant to run under -DVULKAN_SANITIZE_THREAD=ON.
+int main()
+{
+    return test::run({
+        {"submit_wait", submit_wait},
+        {"nested_fork_join", nested_fork_join},
+        {"exception_propagation", exception_propagation},
+        {"parallel_for_coverage", parallel_for_coverage},
+        {"stealing_under_contention", stealing_under_contention},
+        {"blocking_wait_runs_nothing", blocking_wait_runs_nothing},
+        {"task_graph_order", task_graph_order},
+        {"task_graph_errors", task_graph_errors},
+    });
+}
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "check.hpp"
+#include "lighting.hpp"
+
+namespace
+{
+    using test::check;
+
+    constexpr float nearPlane{0.1f};
+    constexpr float farPlane{10.0f};
+
+    // The renderer's camera, with the model turned so that lights have to go through view * model as in the shaders.
+    app::UniformBufferObject make_uniforms()
+    {
+        app::UniformBufferObject ubo{};
+        ubo.model = glm::rotate(glm::mat4{1.0f}, glm::radians(30.0f), glm::vec3{0.0f, 0.0f, 1.0f});
+        ubo.view = glm::lookAt(glm::vec3{2.0f, 2.0f, 2.0f}, glm::vec3{0.0f}, glm::vec3{0.0f, 0.0f, 1.0f});
+        ubo.projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, nearPlane, farPlane);
+        ubo.projection[1][1] *= -1;
+        ubo.inverseProjection = glm::inverse(ubo.projection);
+        ubo.clusterViewport = glm::vec4{1'920.0f, 1'080.0f, nearPlane, farPlane};
+        return ubo;
+    }
+
+    // A light placed at a view space position, given in the model space the light buffer holds.
+    app::PointLight light_at(const app::UniformBufferObject& ubo, const glm::vec3& viewPosition, float radius)
+    {
+        auto position{glm::inverse(ubo.view * ubo.model) * glm::vec4{viewPosition, 1.0f}};
+        return {glm::vec4{glm::vec3{position}, radius}, glm::vec4{1.0f}};
+    }
+
+    // View space centre of a cluster, halfway through its slice in log depth.
+    glm::vec3 cluster_centre(const app::UniformBufferObject& ubo, std::uint32_t tileX, std::uint32_t tileY, std::uint32_t slice)
+    {
+        auto depth{nearPlane * std::pow(farPlane / nearPlane, (slice + 0.5f) / app::lightClusterCountZ)};
+        glm::vec2 ndc{(tileX + 0.5f) / app::lightClusterCountX * 2.0f - 1.0f, (tileY + 0.5f) / app::lightClusterCountY * 2.0f - 1.0f};
+        auto point{ubo.inverseProjection * glm::vec4{ndc, 0.5f, 1.0f}};
+        auto ray{glm::vec3{point} / point.w};
+        return ray * (depth / -ray.z);
+    }
+
+    std::uint32_t assigned_count(const app::LightAssignment& assignment)
+    {
+        return std::accumulate(std::begin(assignment.ranges), std::end(assignment.ranges), 0u,
+                               [](std::uint32_t sum, const glm::uvec2& range) { return sum + range.y; });
+    }
+
+    void light_lands_in_its_cluster()
+    {
+        auto ubo{make_uniforms()};
+        constexpr std::uint32_t tileX{5};
+        constexpr std::uint32_t tileY{3};
+        constexpr std::uint32_t slice{10};
+        auto viewPosition{cluster_centre(ubo, tileX, tileY, slice)};
+
+        // The lookup shader.frag does for a fragment at that position.
+        auto clip{ubo.projection * glm::vec4{viewPosition, 1.0f}};
+        auto fragment{glm::vec2{clip.x / clip.w + 1.0f, clip.y / clip.w + 1.0f} * 0.5f};
+        check(static_cast<std::uint32_t>(fragment.x * app::lightClusterCountX) == tileX &&
+              static_cast<std::uint32_t>(fragment.y * app::lightClusterCountY) == tileY, "position is not in the expected tile");
+        check(app::light_cluster_slice(-viewPosition.z, nearPlane, farPlane) == slice, "position is not in the expected slice");
+
+        std::vector lights{light_at(ubo, viewPosition, 1e-3f)};
+        auto assignment{app::assign_lights(lights, ubo)};
+        auto cluster{(slice * app::lightClusterCountY + tileY) * app::lightClusterCountX + tileX};
+        check(assignment.ranges[cluster].y == 1 && assignment.indices[assignment.ranges[cluster].x] == 0, "light missing from its cluster");
+        check(assigned_count(assignment) == 1 && std::size(assignment.indices) == 1, "light assigned to other clusters");
+        check(assignment.droppedLights == 0, "light was dropped");
+    }
+
+    // Lights behind the camera or past the far plane touch no cluster.
+    void lights_outside_the_frustum()
+    {
+        auto ubo{make_uniforms()};
+        std::vector lights{light_at(ubo, {0.0f, 0.0f, 1.0f}, 0.5f), light_at(ubo, {0.0f, 0.0f, -farPlane * 2.0f}, 0.5f)};
+        auto assignment{app::assign_lights(lights, ubo)};
+        check(std::empty(assignment.indices) && assigned_count(assignment) == 0, "light outside the frustum was assigned");
+    }
+
+    // More lights in one cluster than it keeps: the first maxClusterLights stay and the rest are counted as dropped.
+    void cluster_limit()
+    {
+        auto ubo{make_uniforms()};
+        constexpr std::uint32_t count{app::maxClusterLights + 44};
+        std::vector lights(count, light_at(ubo, cluster_centre(ubo, 8, 4, 12), 1e-3f));
+        auto assignment{app::assign_lights(lights, ubo)};
+
+        auto full{std::ranges::find_if(assignment.ranges, [](const glm::uvec2& range) { return range.y > 0; })};
+        check(full != std::end(assignment.ranges) && full->y == app::maxClusterLights, "cluster did not keep its limit");
+        check(std::size(assignment.indices) == app::maxClusterLights, "indices hold more than the limit");
+        check(assignment.droppedLights == count - app::maxClusterLights, "dropped lights miscounted");
+        for(std::uint32_t i{0}; i < app::maxClusterLights; ++i)
+        {
+            check(assignment.indices[full->x + i] == i, "cluster kept the wrong lights");
+        }
+    }
+
+    // Lights covering the whole frustum ask for far more than the index list holds. Clusters fill in order until it is
+    // full, runs stay contiguous, and every light that did not fit is counted once.
+    void index_capacity()
+    {
+        auto ubo{make_uniforms()};
+        constexpr std::uint32_t count{300};
+        std::vector lights(count, light_at(ubo, {0.0f, 0.0f, -5.0f}, 100.0f));
+        auto assignment{app::assign_lights(lights, ubo)};
+
+        check(std::size(assignment.indices) == app::lightIndexCapacity, "index list not filled to capacity");
+        check(assigned_count(assignment) == app::lightIndexCapacity, "ranges do not add up to the index list");
+        check(assignment.droppedLights == count * app::lightClusterCount - app::lightIndexCapacity, "dropped lights miscounted");
+
+        std::uint32_t offset{0};
+        for(std::uint32_t cluster{0}; cluster < app::lightClusterCount; ++cluster)
+        {
+            const auto& range{assignment.ranges[cluster]};
+            check(range.x == offset, "cluster run is not contiguous");
+            auto expected{std::min(app::maxClusterLights, app::lightIndexCapacity - offset)};
+            check(range.y == expected, "cluster kept the wrong number of lights");
+            offset += range.y;
+        }
+        check(std::ranges::all_of(assignment.indices, [](std::uint32_t index) { return index < count; }), "index names no light");
+    }
+}
+
+// The CPU light assignment, which has to agree with light_cull.comp and the cluster lookup in shader.frag.
+int main()
+{
+    return test::run({
+        {"light_lands_in_its_cluster", light_lands_in_its_cluster},
+        {"lights_outside_the_frustum", lights_outside_the_frustum},
+        {"cluster_limit", cluster_limit},
+        {"index_capacity", index_capacity},
+    });
+}
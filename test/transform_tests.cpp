@@ -0,0 +1,109 @@
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "check.hpp"
+#include "transform.hpp"
+
+namespace
+{
+    using test::check;
+
+    app::Transform random_transform(std::mt19937& random)
+    {
+        std::uniform_real_distribution<float> position{-100.0f, 100.0f};
+        std::uniform_real_distribution<float> angle{-3.14159265f, 3.14159265f};
+        std::uniform_real_distribution<float> axis{-1.0f, 1.0f};
+        std::uniform_real_distribution<float> scale{0.1f, 4.0f};
+
+        glm::vec3 direction{axis(random), axis(random), axis(random) + 2.0f};
+        return {glm::vec3{position(random), position(random), position(random)}, glm::angleAxis(angle(random), glm::normalize(direction)),
+                glm::vec3{scale(random), scale(random), scale(random)}};
+    }
+
+    bool matches(const glm::mat4& batched, const glm::mat4& reference)
+    {
+        for(int column{0}; column < 4; ++column)
+        {
+            for(int row{0}; row < 4; ++row)
+            {
+                if(std::abs(batched[column][row] - reference[column][row]) > 1e-5f * (1.0f + std::abs(reference[column][row])))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Counts that leave the last batch, and the last SIMD register in it, partly filled.
+    void batches_match_to_matrix()
+    {
+        std::mt19937 random{7};
+        for(const std::uint32_t count : {1u, 3u, 5u, 8u, 13u, 21u, 64u, 100u})
+        {
+            app::TransformSystem transforms{};
+            std::vector<app::Transform> reference{};
+            for(std::uint32_t i{0}; i < count; ++i)
+            {
+                reference.push_back(random_transform(random));
+                check(transforms.add(reference.back()) == i, "indices are not sequential");
+            }
+            check(transforms.update(1) == (count + app::TransformSystem::batchSize - 1) / app::TransformSystem::batchSize,
+                  "not every batch was computed");
+
+            for(std::uint32_t i{0}; i < count; ++i)
+            {
+                check(matches(transforms.world(i), app::to_matrix(reference[i])), "batched matrix differs from to_matrix");
+            }
+        }
+    }
+
+    // Only the batches touched since the last update are recomputed and copied out.
+    void dirty_batches()
+    {
+        std::mt19937 random{11};
+        constexpr std::uint32_t count{21};
+        app::TransformSystem transforms{};
+        std::vector<app::Transform> reference{};
+        for(std::uint32_t i{0}; i < count; ++i)
+        {
+            reference.push_back(random_transform(random));
+            transforms.add(reference.back());
+        }
+        transforms.update(1);
+        check(transforms.update(2) == 0, "clean batches were recomputed");
+
+        auto moved{random_transform(random)};
+        reference[20] = moved;
+        transforms.set_position(20, moved.position);
+        transforms.set_rotation(20, moved.rotation);
+        transforms.set_scale(20, moved.scale);
+        check(transforms.update(3) == 1, "only the batch with the moved object should be recomputed");
+
+        std::vector<app::ObjectData> objects(count);
+        for(auto& object : objects)
+        {
+            object.model = glm::mat4{0.0f};
+        }
+        check(transforms.write_models(objects, 3) == count - 2 * app::TransformSystem::batchSize, "wrong number of matrices written");
+        check(matches(objects[20].model, app::to_matrix(reference[20])), "moved object has a stale matrix");
+        check(objects[0].model[3][3] == 0.0f, "an unchanged batch was written");
+
+        check(transforms.write_models(objects, 1) == count, "a full write missed objects");
+        for(std::uint32_t i{0}; i < count; ++i)
+        {
+            check(matches(objects[i].model, app::to_matrix(reference[i])), "written matrix differs from to_matrix");
+        }
+    }
+}
+
+// The SIMD transform batches against to_matrix, whichever instruction set they were built for.
+int main()
+{
+    return test::run({
+        {"batches_match_to_matrix", batches_match_to_matrix},
+        {"dirty_batches", dirty_batches},
+    });
+}